@@ -0,0 +1,113 @@
+/*
+ * Benchmark of the route searches on the layout of examples/dom.
+ * Prints, for each search, the time per query over all the pairs of
+ * tracks in both directions.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "SwitchMan.h"
+#include "Specifs.h"
+
+#ifndef BENCH_ROUNDS
+#define BENCH_ROUNDS 20
+#endif
+
+static uint64_t nanoseconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void report(const char *inName, const uint64_t inElapsed, const uint32_t inQueries, const uint32_t inRoutes)
+{
+  printf("%s,%lu,%lu,%.1f\n", inName, (unsigned long)inQueries,
+         (unsigned long)inRoutes, (double)inElapsed / inQueries);
+}
+
+static void benchPathsTo()
+{
+  uint32_t queries = 0;
+  uint32_t routes = 0;
+  uint64_t start = nanoseconds();
+  for (uint8_t round = 0; round < BENCH_ROUNDS; round++) {
+    for (uint8_t dir = FORWARD_DIRECTION; dir <= BACKWARD_DIRECTION; dir++) {
+      for (uint16_t from = 0; from < Track::count(); from++) {
+        for (uint16_t to = 0; to < Track::count(); to++) {
+          PathSet paths;
+          if (Track::trackForId(from).pathsTo(to, (Direction)dir, paths)) {
+            routes += paths.count();
+          }
+          queries++;
+        }
+      }
+    }
+  }
+  report("pathsTo", nanoseconds() - start, queries, routes);
+}
+
+static void benchPathSearch()
+{
+  uint32_t queries = 0;
+  uint32_t routes = 0;
+  PathSearch search;
+  uint64_t start = nanoseconds();
+  for (uint8_t round = 0; round < BENCH_ROUNDS; round++) {
+    for (uint8_t dir = FORWARD_DIRECTION; dir <= BACKWARD_DIRECTION; dir++) {
+      for (uint16_t from = 0; from < Track::count(); from++) {
+        for (uint16_t to = 0; to < Track::count(); to++) {
+          PathSet paths;
+          search.start(Track::trackForId(from), to, (Direction)dir, paths);
+          while (! search.step(0xFFFF));
+          routes += paths.count();
+          queries++;
+        }
+      }
+    }
+  }
+  report("PathSearch", nanoseconds() - start, queries, routes);
+}
+
+static void benchBatchSearch()
+{
+  uint32_t queries = 0;
+  uint32_t routes = 0;
+  TrackSet all;
+  for (uint16_t id = 0; id < Track::count(); id++) all.addTrack(id);
+  BatchSearch search;
+  uint64_t start = nanoseconds();
+  for (uint8_t round = 0; round < BENCH_ROUNDS; round++) {
+    for (uint8_t dir = FORWARD_DIRECTION; dir <= BACKWARD_DIRECTION; dir++) {
+      for (uint16_t from = 0; from < Track::count(); from++) {
+        PathSetMap paths;
+        search.pathsToAll(Track::trackForId(from), all, (Direction)dir, paths);
+        for (uint16_t i = 0; i < paths.count(); i++) routes += paths.pathsAt(i).count();
+        queries += Track::count();
+      }
+    }
+  }
+  report("BatchSearch", nanoseconds() - start, queries, routes);
+}
+
+void setup()
+{
+  export_setup();
+  Track::finalize();
+  if (! Track::trackNetIsOk()) exit(1);
+
+  /* Without the index built by finalize() first */
+  ReachabilityIndex::clear();
+  printf("search,queries,routes,ns_per_query\n");
+  benchPathsTo();
+  benchPathSearch();
+  benchBatchSearch();
+  ReachabilityIndex::build();
+  benchPathsTo();
+  exit(0);
+}
+
+void loop()
+{
+}
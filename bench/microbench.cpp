@@ -0,0 +1,302 @@
+/*
+ * Microbenchmarks of the sets used by the searches: TrackSet,
+ * HeadedTrackSet, PathSet and Path::fitWith, for nets of 8 to 1024
+ * tracks and sets of 1 to 256 paths.
+ *
+ * Prints a CSV line per operation and size:
+ *   benchmark,tracks,paths,ops,ns_per_op,allocs_per_op,bytes_per_op,footprint_bytes
+ * bytes_per_op are the bytes allocated per operation and footprint_bytes
+ * the bytes allocated to make one set. paths is the number of paths of
+ * the PathSet, fewer than asked when the net has not as many different
+ * paths, and 0 for the other sets.
+ *
+ * The tracks are made at run time, the net growing from a size to the
+ * next one, so the program is not built with SWITCHMAN_STATIC_TRACK_TABLE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <functional>
+#include <new>
+#include <vector>
+
+#include "SwitchMan.h"
+
+/* Minimum time measured per operation and size */
+#ifndef MICROBENCH_MIN_NS
+#define MICROBENCH_MIN_NS 10000000ULL
+#endif
+
+/* Number of tracks of the longest paths */
+#define PATH_LENGTH 12
+
+static const uint16_t trackCounts[] = { 8, 16, 32, 64, 128, 256, 512, 1024 };
+static const uint16_t pathCounts[] = { 1, 4, 16, 64, 256 };
+
+/*
+ * Allocations counted by the global new and delete
+ */
+static uint64_t allocations = 0;
+static uint64_t allocatedBytes = 0;
+
+void *operator new(size_t inSize)
+{
+  allocations++;
+  allocatedBytes += inSize;
+  void *block = malloc(inSize == 0 ? 1 : inSize);
+  if (block == NULL) throw std::bad_alloc();
+  return block;
+}
+
+void *operator new[](size_t inSize)
+{
+  return operator new(inSize);
+}
+
+void operator delete(void *inBlock) noexcept
+{
+  free(inBlock);
+}
+
+void operator delete[](void *inBlock) noexcept
+{
+  free(inBlock);
+}
+
+void operator delete(void *inBlock, size_t) noexcept
+{
+  free(inBlock);
+}
+
+void operator delete[](void *inBlock, size_t) noexcept
+{
+  free(inBlock);
+}
+
+static uint64_t nanoseconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/*
+ * xorshift32, the same sets on every host
+ */
+static uint32_t sRandom = 1;
+
+static uint32_t randomNumber(const uint32_t inBound)
+{
+  sRandom ^= sRandom << 13;
+  sRandom ^= sRandom >> 17;
+  sRandom ^= sRandom << 5;
+  return sRandom % inBound;
+}
+
+/*
+ * Run inOps operations per batch until MICROBENCH_MIN_NS is reached.
+ * inPrepare and inCleanup, out of the measure, make and drop what the
+ * operations consume. inFootprint is the bytes of the set measured.
+ */
+typedef std::function<void(uint32_t)> BatchFunction;
+
+static void measure(
+  const char *inName,
+  const uint16_t inPaths,
+  const uint32_t inOps,
+  const uint64_t inFootprint,
+  const BatchFunction & inRun,
+  const BatchFunction & inPrepare = BatchFunction(),
+  const BatchFunction & inCleanup = BatchFunction())
+{
+  uint64_t elapsed = 0;
+  uint64_t ops = 0;
+  uint64_t allocs = 0;
+  uint64_t bytes = 0;
+  while (elapsed < MICROBENCH_MIN_NS) {
+    if (inPrepare) inPrepare(inOps);
+    const uint64_t allocsBefore = allocations;
+    const uint64_t bytesBefore = allocatedBytes;
+    const uint64_t start = nanoseconds();
+    inRun(inOps);
+    elapsed += nanoseconds() - start;
+    allocs += allocations - allocsBefore;
+    bytes += allocatedBytes - bytesBefore;
+    ops += inOps;
+    if (inCleanup) inCleanup(inOps);
+  }
+  printf("%s,%u,%u,%llu,%.2f,%.2f,%.1f,%llu\n", inName, Track::count(), inPaths,
+         (unsigned long long)ops, (double)elapsed / ops, (double)allocs / ops,
+         (double)bytes / ops, (unsigned long long)inFootprint);
+}
+
+/* Bytes allocated to make a set, the set itself included */
+template <typename Set, typename Make> static uint64_t footprint(Make inMake)
+{
+  const uint64_t bytesBefore = allocatedBytes;
+  Set *set = inMake();
+  const uint64_t bytes = allocatedBytes - bytesBefore;
+  delete set;
+  return bytes;
+}
+
+/* Keeps the compiler from dropping the results */
+static volatile uint32_t sink;
+
+static void benchTrackSet()
+{
+  const uint16_t count = Track::count();
+  const uint64_t bytes = footprint<TrackSet>([] { return new TrackSet(); });
+  TrackSet set;
+  TrackSet other;
+  for (uint16_t id = 0; id < count; id += 3) other.addTrack(id);
+
+  measure("TrackSet::addTrack", 0, 1024, bytes, [&](uint32_t inOps) {
+    for (uint32_t i = 0; i < inOps; i++) set.addTrack(i % count);
+  });
+  measure("TrackSet::containsTrack", 0, 1024, bytes, [&](uint32_t inOps) {
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < inOps; i++) found += other.containsTrack(i % count);
+    sink = found;
+  });
+  measure("TrackSet::clear", 0, 1024, bytes, [&](uint32_t inOps) {
+    for (uint32_t i = 0; i < inOps; i++) set.clear();
+  });
+  set = other;
+  measure("TrackSet::operator==", 0, 1024, bytes, [&](uint32_t inOps) {
+    uint32_t equal = 0;
+    for (uint32_t i = 0; i < inOps; i++) equal += (set == other);
+    sink = equal;
+  });
+  measure("TrackSet::TrackSet", 0, 1024, bytes, [&](uint32_t inOps) {
+    for (uint32_t i = 0; i < inOps; i++) {
+      TrackSet made;
+      sink = made.byteAt(0);
+    }
+  });
+}
+
+static void benchHeadedTrackSet()
+{
+  const uint16_t count = Track::count();
+  const uint64_t bytes = footprint<HeadedTrackSet>([] { return new HeadedTrackSet(); });
+  HeadedTrackSet set;
+
+  measure("HeadedTrackSet::addTrack", 0, 1024, bytes, [&](uint32_t inOps) {
+    for (uint32_t i = 0; i < inOps; i++) set.addTrack(i % count, i & 1);
+  });
+  measure("HeadedTrackSet::containsTrack", 0, 1024, bytes, [&](uint32_t inOps) {
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < inOps; i++) found += set.containsTrack(i % count, (i >> 1) & 1);
+    sink = found;
+  });
+  measure("HeadedTrackSet::removeTrack", 0, 1024, bytes, [&](uint32_t inOps) {
+    for (uint32_t i = 0; i < inOps; i++) set.removeTrack(i % count, i & 1);
+  });
+  measure("HeadedTrackSet::clear", 0, 1024, bytes, [&](uint32_t inOps) {
+    for (uint32_t i = 0; i < inOps; i++) set.clear();
+  });
+  measure("HeadedTrackSet::acquire", 0, 1024, bytes, [&](uint32_t inOps) {
+    for (uint32_t i = 0; i < inOps; i++) {
+      PooledHeadedTrackSet marking;
+      marking->addTrack(i % count, FORWARD_DIRECTION);
+    }
+  });
+}
+
+/* Random path of PATH_LENGTH tracks at most */
+static void randomPath(TrackSet & outPath)
+{
+  const uint16_t count = Track::count();
+  const uint16_t length = (count / 2 < PATH_LENGTH) ? count / 2 : PATH_LENGTH;
+  outPath.clear();
+  for (uint16_t i = 0; i < length; i++) outPath.addTrack(randomNumber(count));
+}
+
+static void fillPathSet(PathSet & ioPaths, const uint16_t inPaths)
+{
+  TrackSet path;
+  for (uint16_t i = 0; i < inPaths; i++) {
+    randomPath(path);
+    ioPaths.addPath(path);
+  }
+}
+
+static void benchPathSet(const uint16_t inPaths)
+{
+  PathSet base;
+  PathSet other;
+  fillPathSet(base, inPaths);
+  fillPathSet(other, inPaths);
+  const uint16_t paths = base.count();
+  const uint64_t bytes = footprint<PathSet>([&] { return new PathSet(base); });
+  const uint32_t batch = 16;
+  std::vector<PathSet *> sets;
+
+  measure("PathSet::PathSet(PathSet&)", paths, batch, bytes, [&](uint32_t inOps) {
+    for (uint32_t i = 0; i < inOps; i++) sets.push_back(new PathSet(base));
+  }, [&](uint32_t inOps) {
+    sets.reserve(inOps);
+  }, [&](uint32_t) {
+    for (size_t i = 0; i < sets.size(); i++) delete sets[i];
+    sets.clear();
+  });
+
+  measure("PathSet::operator+=", paths, batch, bytes, [&](uint32_t inOps) {
+    for (uint32_t i = 0; i < inOps; i++) *sets[i] += other;
+  }, [&](uint32_t inOps) {
+    for (uint32_t i = 0; i < inOps; i++) sets.push_back(new PathSet(base));
+  }, [&](uint32_t) {
+    for (size_t i = 0; i < sets.size(); i++) delete sets[i];
+    sets.clear();
+  });
+
+  measure("PathSet::count", paths, 256, bytes, [&](uint32_t inOps) {
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < inOps; i++) total += base.count();
+    sink = total;
+  });
+
+  const uint16_t count = Track::count();
+  measure("PathSet::addTrack", paths, 256, bytes, [&](uint32_t inOps) {
+    for (uint32_t i = 0; i < inOps; i++) base.addTrack(i % count);
+  });
+}
+
+static void benchFitWith()
+{
+  Path first;
+  Path second;
+  randomPath(first);
+  randomPath(second);
+  const uint64_t bytes = footprint<Path>([] { return new Path(); });
+  measure("Path::fitWith", 1, 1024, bytes, [&](uint32_t inOps) {
+    uint32_t fit = 0;
+    for (uint32_t i = 0; i < inOps; i++) fit += first.fitWith(second);
+    sink = fit;
+  });
+}
+
+static const char PROGMEM benchTrackName[] = "bench";
+
+void setup()
+{
+  printf("benchmark,tracks,paths,ops,ns_per_op,allocs_per_op,bytes_per_op,footprint_bytes\n");
+  for (uint8_t s = 0; s < sizeof(trackCounts) / sizeof(trackCounts[0]); s++) {
+    /* The sets are sized by the number of tracks */
+    while (Track::count() < trackCounts[s]) {
+      new BlockTrack(NAME_ARG_FIRST(benchTrackName) Track::count());
+    }
+    benchTrackSet();
+    benchHeadedTrackSet();
+    for (uint8_t p = 0; p < sizeof(pathCounts) / sizeof(pathCounts[0]); p++) {
+      benchPathSet(pathCounts[p]);
+    }
+    benchFitWith();
+  }
+  exit(0);
+}
+
+void loop()
+{
+}
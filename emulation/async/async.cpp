@@ -0,0 +1,67 @@
+/*
+ * Asynchronous route queries on the host.
+ * A coroutine writes queries in a pipe, another one reads them and
+ * searches the routes while the event loop keeps running.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "SwitchMan.h"
+#include "Specifs.h"
+#include "AsyncRoutes.h"
+
+static EventLoop boucle;
+static AsyncRouter aiguilleur(boucle, 32);
+
+static const uint16_t requetes[][2] = {
+  { voie23_id, voie1_id },
+  { voie1_id, voie23_id },
+  { voie29_id, voie5_id }
+};
+static const uint8_t nombreDeRequetes = sizeof(requetes) / sizeof(requetes[0]);
+
+AsyncTask client(int fd)
+{
+  for (uint8_t i = 0; i < nombreDeRequetes; i++) {
+    co_await boucle.writable(fd);
+    if (write(fd, requetes[i], sizeof(requetes[i])) != sizeof(requetes[i])) break;
+  }
+  close(fd);
+}
+
+AsyncTask serveur(int fd)
+{
+  uint8_t memoire[4096];
+  RouteArena routes(memoire, sizeof(memoire));
+  uint16_t requete[2];
+
+  while (true) {
+    co_await boucle.readable(fd);
+    if (read(fd, requete, sizeof(requete)) != sizeof(requete)) break;
+    bool trouve = co_await aiguilleur.pathsTo(
+      Track::trackForId(requete[0]), requete[1], FORWARD_DIRECTION, routes
+    );
+    fprintf(stderr, "%u -> %u : %u itineraire(s)%s\n",
+            requete[0], requete[1], routes.count(),
+            trouve ? (routes.overflow() ? ", memoire pleine" : "") : "");
+  }
+  close(fd);
+}
+
+void setup()
+{
+  export_setup();
+  Track::finalize();
+
+  int tube[2];
+  if (pipe(tube) != 0) exit(1);
+  serveur(tube[0]);
+  client(tube[1]);
+  boucle.run();
+  exit(0);
+}
+
+void loop()
+{
+}
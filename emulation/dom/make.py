@@ -21,10 +21,24 @@ sourceList = [
     "dom.cpp",
     "../../src/TrackSet.cpp",
     "../../src/Track.cpp",
+    "../../src/TrackNames.cpp",
     "../../src/PathSet.cpp",
     "../../src/HeadedTrackSet.cpp",
+    "../../src/BlockChain.cpp",
+    "../../src/ReachabilityIndex.cpp",
+    "../../src/ReversingSearch.cpp",
+    "../../src/RouteProtocol.cpp",
+    "../../src/PathSearch.cpp",
+    "../../src/BatchSearch.cpp",
+    "../../src/Profile.cpp",
+    "../../src/HeapStats.cpp",
+    "../../src/LayoutReport.cpp",
+    "../../src/DirectionSolver.cpp",
+    "../../src/RouteCache.cpp",
     "../../unix/Arduino.cpp",
-    "../../unix/HardwareSerial.cpp"
+    "../../unix/HardwareSerial.cpp",
+    "../../unix/ProfileClock.cpp",
+    "../../unix/HeapInfo.cpp"
 ]
 objectList = []
 for source in sourceList:
@@ -0,0 +1,44 @@
+/*
+ * Export the layout of examples/dom as DOT and JSON with the heatmap of
+ * the query from voie23 to voie1.
+ *
+ *   dot -Tsvg switchman.dot > switchman.svg
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SwitchMan.h"
+#include "Specifs.h"
+#include "LayoutExport.h"
+
+#ifndef EXPORT_DOT_PATH
+#define EXPORT_DOT_PATH "switchman.dot"
+#endif
+
+#ifndef EXPORT_JSON_PATH
+#define EXPORT_JSON_PATH "switchman.json"
+#endif
+
+void setup()
+{
+  export_setup();
+  Track::finalize();
+
+  LayoutExport carte;
+  if (! carte.explore(voie23_id, voie1_id, FORWARD_DIRECTION)) {
+    fprintf(stderr, "Le reseau n'est pas correct\n");
+    exit(1);
+  }
+  if (! carte.exportTo(EXPORT_DOT_PATH) || ! carte.exportTo(EXPORT_JSON_PATH)) {
+    fprintf(stderr, "Impossible d'ecrire %s ou %s\n", EXPORT_DOT_PATH, EXPORT_JSON_PATH);
+    exit(1);
+  }
+  fprintf(stderr, "%s, %s : %u voies, %lu itineraires, %lu voies visitees\n",
+          EXPORT_DOT_PATH, EXPORT_JSON_PATH, Track::count(),
+          (unsigned long)carte.routeCount(), (unsigned long)carte.visitCount());
+  exit(0);
+}
+
+void loop()
+{
+}
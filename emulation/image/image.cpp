@@ -0,0 +1,57 @@
+/*
+ * Export the route image of the layout of examples/dom, then map it as
+ * another process would and read a route from it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SwitchMan.h"
+#include "Specifs.h"
+#include "RouteImage.h"
+
+#ifndef IMAGE_PATH
+#define IMAGE_PATH "/dev/shm/switchman.img"
+#endif
+
+void setup()
+{
+  export_setup();
+  Track::finalize();
+
+  if (! RouteImage::exportTo(IMAGE_PATH)) {
+    fprintf(stderr, "Impossible d'ecrire %s\n", IMAGE_PATH);
+    exit(1);
+  }
+
+  RouteImage image;
+  if (! image.map(IMAGE_PATH)) {
+    fprintf(stderr, "Image %s incorrecte\n", IMAGE_PATH);
+    exit(1);
+  }
+  uint32_t total = 0;
+  for (uint16_t origine = 0; origine < image.trackCount(); origine++) {
+    for (uint16_t cible = 0; cible < image.trackCount(); cible++) {
+      total += image.routeCount(origine, cible, FORWARD_DIRECTION);
+    }
+  }
+  fprintf(stderr, "%s : %u voies, %u itineraires en avant\n",
+          IMAGE_PATH, image.trackCount(), total);
+
+  const uint8_t *itineraire = image.route(voie23_id, voie1_id, FORWARD_DIRECTION, 0);
+  if (itineraire != NULL) {
+    fprintf(stderr, "voie23 -> voie1 :");
+    for (uint16_t id = 0; id < image.trackCount(); id++) {
+      if (image.routeContainsTrack(itineraire, id)) {
+        const char *nom = image.trackName(id);
+        if (nom != NULL) fprintf(stderr, " %s", nom);
+        else fprintf(stderr, " %u", id);
+      }
+    }
+    fprintf(stderr, "\n");
+  }
+  exit(0);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,66 @@
+/*
+ * Route server daemon for the layout of examples/dom.
+ * The net is finalized and indexed once, then the routes are served to
+ * the local processes on a Unix domain socket until SIGINT or SIGTERM.
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SwitchMan.h"
+#include "Specifs.h"
+#include "RouteServer.h"
+
+#ifndef SERVER_SOCKET_PATH
+#define SERVER_SOCKET_PATH "/tmp/switchman.sock"
+#endif
+
+#ifndef SERVER_RING_NAME
+#define SERVER_RING_NAME "/switchman-routes"
+#endif
+
+#ifndef SERVER_RING_CAPACITY
+#define SERVER_RING_CAPACITY (1024 * 1024)
+#endif
+
+static volatile sig_atomic_t arret = 0;
+
+static void demandeArret(int)
+{
+  arret = 1;
+}
+
+void setup()
+{
+  export_setup();
+  Track::finalize();
+  if (! Track::trackNetIsOk()) {
+    fprintf(stderr, "Reseau incorrect\n");
+    exit(1);
+  }
+  ReachabilityIndex::build();
+
+  /* Without SA_RESTART, poll() is interrupted by the signals */
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = demandeArret;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  EventLoop boucle;
+  RouteServer serveur(boucle);
+  if (! serveur.open(SERVER_SOCKET_PATH, SERVER_RING_NAME, SERVER_RING_CAPACITY)) {
+    perror("serveur");
+    exit(1);
+  }
+  fprintf(stderr, "%u voies, en attente sur %s\n", Track::count(), SERVER_SOCKET_PATH);
+  while (! arret && boucle.runOnce());
+  serveur.close();
+  exit(0);
+}
+
+void loop()
+{
+}
@@ -63,6 +63,7 @@ TRACK(TurnoutTrack, aiguille17);
 TRACK(TurnoutTrack, aiguille18);
 TRACK(TurnoutTrack, aiguille19);
 TRACK(TurnoutTrack, aiguille20);
+TRACK_TABLE();
 
 void export_setup() {
     /*
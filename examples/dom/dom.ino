@@ -57,7 +57,17 @@ void setup() {
   Serial.println((unsigned long)Track::count());
 #endif
 
+#ifdef SWITCHMAN_PROFILE
+  Profile::begin();
+#endif
   testItineraireManu(voie23_id, voie1_id);
+#ifdef SWITCHMAN_PROFILE
+  /* Durees en ticks de l horloge de profil, voir Profile.h */
+  Profile::dump();
+#endif
+#ifdef SWITCHMAN_HEAP_STATS
+  HeapStats::dump();
+#endif
 }    // fin setup
 
 
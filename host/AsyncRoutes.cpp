@@ -0,0 +1,256 @@
+/*
+ * AsyncRoutes : asynchronous route queries for the Linux host build.
+ */
+#include <string.h>
+
+#include "AsyncRoutes.h"
+
+/*---------------------------------------------------------------------------*/
+RouteArena::RouteArena(uint8_t *inBuffer, const size_t inCapacity) :
+  mBuffer(inBuffer),
+  mCapacity(inCapacity),
+  mUsed(0),
+  mCount(0),
+  mOverflow(false)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteArena::reset()
+{
+  mUsed = 0;
+  mCount = 0;
+  mOverflow = false;
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteArena::append(const TrackSet & inRoute)
+{
+  const uint8_t size = Track::sizeForSet();
+  if (mUsed + size > mCapacity) {
+    mOverflow = true;
+    return false;
+  }
+  for (uint8_t i = 0; i < size; i++) mBuffer[mUsed + i] = inRoute.byteAt(i);
+  mUsed += size;
+  mCount++;
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+const uint8_t *RouteArena::route(const uint16_t inIndex) const
+{
+  if (inIndex >= mCount) return NULL;
+  return mBuffer + (size_t)inIndex * Track::sizeForSet();
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteArena::routeContainsTrack(const uint16_t inIndex, const uint16_t inId) const
+{
+  const uint8_t *bits = route(inIndex);
+  if (bits == NULL || inId >= Track::count()) return false;
+  return (bits[inId >> 3] & (1 << (inId & 7))) != 0;
+}
+
+/*---------------------------------------------------------------------------*/
+bool PooledSearch::startInto(
+  Track & inFrom,
+  const uint16_t inId,
+  const Direction inDir,
+  RouteArena & ioArena)
+{
+  mArena = &ioArena;
+  return startSearch(inFrom, inId, inDir);
+}
+
+/*---------------------------------------------------------------------------*/
+void PooledSearch::pathFound(const TrackSet & inPath)
+{
+  /* Routes beyond the capacity of the arena are dropped */
+  mArena->append(inPath);
+}
+
+/*---------------------------------------------------------------------------*/
+PathsAwaitable::PathsAwaitable(
+  AsyncRouter & inRouter,
+  Track & inFrom,
+  const uint16_t inId,
+  const Direction inDir,
+  RouteArena & ioArena,
+  const uint16_t inBudget) :
+  mRouter(inRouter),
+  mFrom(inFrom),
+  mTarget(inId),
+  mDirection(inDir),
+  mArena(ioArena),
+  mBudget(inBudget == 0 ? 1 : inBudget),
+  mSearch(NULL),
+  mNext(NULL)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+void PathsAwaitable::releaseSearch()
+{
+  if (mSearch == NULL) return;
+  /* Given back by the destructor when the await was not resumed */
+  mSearch->abort();
+  mRouter.release(mSearch);
+  mSearch = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+bool PathsAwaitable::await_ready()
+{
+  mArena.reset();
+  mSearch = mRouter.acquire();
+  /* A bad track net gives no route at once */
+  if (! mSearch->startInto(mFrom, mTarget, mDirection, mArena)) return true;
+  /* Small searches end without suspending the coroutine */
+  return mSearch->step(mBudget);
+}
+
+/*---------------------------------------------------------------------------*/
+void PathsAwaitable::await_suspend(std::coroutine_handle<> inHandle)
+{
+  mHandle = inHandle;
+  mRouter.mLoop.addSearch(this);
+}
+
+/*---------------------------------------------------------------------------*/
+bool PathsAwaitable::await_resume()
+{
+  releaseSearch();
+  return mArena.count() > 0;
+}
+
+/*---------------------------------------------------------------------------*/
+void FdAwaitable::await_suspend(std::coroutine_handle<> inHandle)
+{
+  mHandle = inHandle;
+  mLoop.addFdWaiter(this);
+}
+
+/*---------------------------------------------------------------------------*/
+EventLoop::EventLoop() :
+  mSearches(NULL),
+  mFdWaiters(NULL),
+  mSearchCount(0),
+  mFdWaiterCount(0)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+void EventLoop::addSearch(PathsAwaitable *inSearch)
+{
+  inSearch->mNext = mSearches;
+  mSearches = inSearch;
+  mSearchCount++;
+}
+
+/*---------------------------------------------------------------------------*/
+void EventLoop::addFdWaiter(FdAwaitable *inWaiter)
+{
+  inWaiter->mNext = mFdWaiters;
+  mFdWaiters = inWaiter;
+  mFdWaiterCount++;
+}
+
+/*---------------------------------------------------------------------------*/
+bool EventLoop::runOnce()
+{
+  if (mSearches == NULL && mFdWaiters == NULL) return false;
+
+  /*
+   * Step each search. The finished ones are moved to a local list and
+   * resumed after the walk since resuming a coroutine may start other
+   * searches and destroys the awaitable.
+   */
+  PathsAwaitable *done = NULL;
+  PathsAwaitable **link = &mSearches;
+  while (*link != NULL) {
+    PathsAwaitable *search = *link;
+    if (search->mSearch->step(search->mBudget)) {
+      *link = search->mNext;
+      search->mNext = done;
+      done = search;
+      mSearchCount--;
+    }
+    else link = &search->mNext;
+  }
+  while (done != NULL) {
+    PathsAwaitable *search = done;
+    done = search->mNext;
+    search->mHandle.resume();
+  }
+
+  if (mFdWaiters != NULL) {
+    /* Do not block while searches are running */
+    const int timeout = (mSearches == NULL) ? -1 : 0;
+    mPollFds.clear();
+    mPolled.clear();
+    for (FdAwaitable *waiter = mFdWaiters; waiter != NULL; waiter = waiter->mNext) {
+      struct pollfd fd;
+      fd.fd = waiter->mFd;
+      fd.events = waiter->mEvents;
+      fd.revents = 0;
+      mPollFds.push_back(fd);
+      mPolled.push_back(waiter);
+    }
+    if (poll(mPollFds.data(), mPollFds.size(), timeout) > 0) {
+      /* Keep the waiters that are not ready, then resume the others */
+      mFdWaiters = NULL;
+      mFdWaiterCount = 0;
+      for (size_t i = 0; i < mPolled.size(); i++) {
+        mPolled[i]->mReturnedEvents = mPollFds[i].revents;
+        if (mPollFds[i].revents == 0) addFdWaiter(mPolled[i]);
+      }
+      for (size_t i = 0; i < mPolled.size(); i++) {
+        if (mPollFds[i].revents != 0) mPolled[i]->mHandle.resume();
+      }
+    }
+  }
+  return mSearches != NULL || mFdWaiters != NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+AsyncRouter::~AsyncRouter()
+{
+  while (mFree != NULL) {
+    PooledSearch *search = mFree;
+    mFree = search->mNext;
+    delete search;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+PooledSearch *AsyncRouter::acquire()
+{
+  if (mFree == NULL) {
+    mSearchCount++;
+    return new PooledSearch();
+  }
+  PooledSearch *search = mFree;
+  mFree = search->mNext;
+  search->mNext = NULL;
+  return search;
+}
+
+/*---------------------------------------------------------------------------*/
+void AsyncRouter::release(PooledSearch *inSearch)
+{
+  inSearch->mArena = NULL;
+  inSearch->mNext = mFree;
+  mFree = inSearch;
+}
+
+/*---------------------------------------------------------------------------*/
+void AsyncRouter::reserve(const uint16_t inCount)
+{
+  while (mSearchCount < inCount) {
+    PooledSearch *search = new PooledSearch();
+    search->reserve();
+    release(search);
+    mSearchCount++;
+  }
+}
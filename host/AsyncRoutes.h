@@ -0,0 +1,227 @@
+/*
+ * AsyncRoutes : asynchronous route queries for the Linux host build.
+ * C++20 is needed for the coroutines.
+ *
+ * An EventLoop runs on a single thread. It steps the searches that are
+ * in progress, a visit budget at a time, and waits on file descriptors
+ * (pipes, Unix domain sockets) with poll(). A coroutine awaits the
+ * routes with
+ *
+ *   bool found = co_await router.pathsTo(voie23, voie1_id, FORWARD_DIRECTION, arena);
+ *
+ * and a file descriptor with co_await loop.readable(fd). The awaitables
+ * live in the coroutine frame and are linked in the lists of the loop,
+ * the routes are written in a RouteArena given by the caller. A search
+ * is taken from a pool of the AsyncRouter for the time of the await and
+ * keeps its stack and marking from an await to the next one: there is
+ * no allocation per await once the pool holds as many searches as there
+ * are awaits at once, or after AsyncRouter::reserve().
+ */
+#ifndef __ASYNCROUTES_H__
+#define __ASYNCROUTES_H__
+
+#include <coroutine>
+#include <exception>
+#include <vector>
+#include <poll.h>
+
+#include "PathSearch.h"
+
+/*
+ * Buffer given by the caller where the routes are stored as TrackSet
+ * bit vectors of Track::sizeForSet() bytes.
+ */
+class RouteArena
+{
+  private:
+    uint8_t *mBuffer;
+    size_t mCapacity;
+    size_t mUsed;
+    uint16_t mCount;
+    bool mOverflow;
+
+  public:
+    RouteArena(uint8_t *inBuffer, const size_t inCapacity);
+    void reset();
+    /* Append a route. Return false if the arena is full */
+    bool append(const TrackSet & inRoute);
+    uint16_t count() const { return mCount; }
+    /* true if some routes did not fit */
+    bool overflow() const { return mOverflow; }
+    const uint8_t *route(const uint16_t inIndex) const;
+    bool routeContainsTrack(const uint16_t inIndex, const uint16_t inId) const;
+};
+
+class EventLoop;
+class AsyncRouter;
+
+/*
+ * Something the event loop waits for
+ */
+class LoopWaiter
+{
+  protected:
+    std::coroutine_handle<> mHandle;  /* Coroutine to resume */
+    friend class EventLoop;
+
+  public:
+    LoopWaiter() : mHandle() {}
+};
+
+/*
+ * Search of the pool of an AsyncRouter, writing the routes in the arena
+ * of the await it is used by
+ */
+class PooledSearch : public PathSearch
+{
+  private:
+    RouteArena *mArena;
+    PooledSearch *mNext;    /* Next free search of the pool */
+    friend class AsyncRouter;
+
+  protected:
+    virtual void pathFound(const TrackSet & inPath);
+
+  public:
+    PooledSearch() : mArena(NULL), mNext(NULL) {}
+    bool startInto(Track & inFrom, const uint16_t inId, const Direction inDir, RouteArena & ioArena);
+};
+
+/*
+ * Awaitable search. It is stepped by the event loop and resumes the
+ * awaiting coroutine when done. The search is held from await_ready()
+ * to await_resume() only.
+ */
+class PathsAwaitable : public LoopWaiter
+{
+  private:
+    AsyncRouter & mRouter;
+    Track & mFrom;
+    uint16_t mTarget;
+    Direction mDirection;
+    RouteArena & mArena;
+    uint16_t mBudget;
+    PooledSearch *mSearch;  /* NULL when not awaited */
+    PathsAwaitable *mNext;  /* Next search of the event loop */
+    friend class EventLoop;
+
+    void releaseSearch();
+
+  public:
+    PathsAwaitable(
+      AsyncRouter & inRouter,
+      Track & inFrom,
+      const uint16_t inId,
+      const Direction inDir,
+      RouteArena & ioArena,
+      const uint16_t inBudget
+    );
+    PathsAwaitable(const PathsAwaitable &) = delete;
+    PathsAwaitable & operator=(const PathsAwaitable &) = delete;
+    ~PathsAwaitable() { releaseSearch(); }
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> inHandle);
+    bool await_resume();
+};
+
+/*
+ * Awaitable file descriptor
+ */
+class FdAwaitable : public LoopWaiter
+{
+  private:
+    EventLoop & mLoop;
+    int mFd;
+    short mEvents;
+    short mReturnedEvents;
+    FdAwaitable *mNext;     /* Next waiter of the event loop */
+    friend class EventLoop;
+
+  public:
+    FdAwaitable(EventLoop & inLoop, const int inFd, const short inEvents) :
+      mLoop(inLoop), mFd(inFd), mEvents(inEvents), mReturnedEvents(0), mNext(NULL) {}
+    bool await_ready() { return false; }
+    void await_suspend(std::coroutine_handle<> inHandle);
+    /* Return the poll() events, POLLHUP or POLLERR included */
+    short await_resume() { return mReturnedEvents; }
+};
+
+class EventLoop
+{
+  private:
+    PathsAwaitable *mSearches;     /* Searches in progress          */
+    FdAwaitable *mFdWaiters;       /* Waited file descriptors       */
+    std::vector<struct pollfd> mPollFds;
+    std::vector<FdAwaitable *> mPolled;
+    uint16_t mSearchCount;
+    uint16_t mFdWaiterCount;
+
+    friend class PathsAwaitable;
+    friend class FdAwaitable;
+    void addSearch(PathsAwaitable *inSearch);
+    void addFdWaiter(FdAwaitable *inWaiter);
+
+  public:
+    EventLoop();
+    FdAwaitable readable(const int inFd) { return FdAwaitable(*this, inFd, POLLIN); }
+    FdAwaitable writable(const int inFd) { return FdAwaitable(*this, inFd, POLLOUT); }
+    /* Do one round. Return false when there is nothing left to wait for */
+    bool runOnce();
+    void run() { while (runOnce()); }
+    uint16_t searchCount() const { return mSearchCount; }
+};
+
+/*
+ * Query route service of an event loop. It owns the searches of the
+ * awaits and must outlive them.
+ */
+class AsyncRouter
+{
+  private:
+    EventLoop & mLoop;
+    uint16_t mBudget;       /* Tracks visited by a search per loop round */
+    PooledSearch *mFree;    /* Searches not in use                       */
+    uint16_t mSearchCount;  /* Searches made, in use or not              */
+
+    friend class PathsAwaitable;
+    PooledSearch *acquire();
+    void release(PooledSearch *inSearch);
+
+  public:
+    AsyncRouter(EventLoop & inLoop, const uint16_t inBudget = 64) :
+      mLoop(inLoop), mBudget(inBudget), mFree(NULL), mSearchCount(0) {}
+    ~AsyncRouter();
+    void setBudget(const uint16_t inBudget) { mBudget = inBudget; }
+    /*
+     * Make the searches, and their working memory for the current track
+     * net, of inCount awaits at once
+     */
+    void reserve(const uint16_t inCount);
+    uint16_t searchCount() const { return mSearchCount; }
+    PathsAwaitable pathsTo(
+      Track & inFrom,
+      const uint16_t inId,
+      const Direction inDir,
+      RouteArena & ioArena
+    )
+    {
+      return PathsAwaitable(*this, inFrom, inId, inDir, ioArena, mBudget);
+    }
+};
+
+/*
+ * Coroutine started at once and destroyed when it ends
+ */
+struct AsyncTask
+{
+  struct promise_type
+  {
+    AsyncTask get_return_object() { return AsyncTask(); }
+    std::suspend_never initial_suspend() { return std::suspend_never(); }
+    std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+#endif /* __ASYNCROUTES_H__ */
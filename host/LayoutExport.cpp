@@ -0,0 +1,342 @@
+/*
+ * LayoutExport : the finalized track net as a Graphviz DOT graph or as
+ * JSON, with the exploration of a query as a heatmap.
+ */
+#include <string.h>
+
+#include "LayoutExport.h"
+#include "DirectionSolver.h"
+
+/*
+ * Search counting the routes going through each track and keeping the
+ * first ones
+ */
+class ExportSearch : public PathSearch
+{
+  private:
+    std::vector<uint32_t> & mRouteCount;
+    std::vector<uint8_t> & mRoutes;
+    uint32_t mMaxRoutes;
+    uint32_t mCount;
+
+  protected:
+    virtual void pathFound(const TrackSet & inPath)
+    {
+      for (uint8_t i = 0; i < Track::sizeForSet(); i++) {
+        uint8_t tracks = inPath.byteAt(i);
+        for (uint8_t bit = 0; tracks != 0; bit++, tracks >>= 1) {
+          if (tracks & 1) mRouteCount[(i << 3) + bit]++;
+        }
+      }
+      if (mCount < mMaxRoutes) {
+        for (uint8_t i = 0; i < Track::sizeForSet(); i++) mRoutes.push_back(inPath.byteAt(i));
+      }
+      mCount++;
+    }
+
+  public:
+    ExportSearch(std::vector<uint32_t> & ioRouteCount, std::vector<uint8_t> & ioRoutes, const uint32_t inMaxRoutes) :
+      mRouteCount(ioRouteCount), mRoutes(ioRoutes), mMaxRoutes(inMaxRoutes), mCount(0) {}
+    uint32_t count() const { return mCount; }
+    bool run(Track & inFrom, const uint16_t inId, TrackSet * inTargets, const Direction inDir)
+    {
+      if (inTargets == NULL) {
+        if (! startSearch(inFrom, inId, inDir)) return false;
+      }
+      else if (! startSearch(inFrom, *inTargets, inDir)) return false;
+      while (! step(1024));
+      return true;
+    }
+};
+
+static const char *directionName(const Direction inDir)
+{
+  switch (inDir) {
+    case FORWARD_DIRECTION:  return "forward";
+    case BACKWARD_DIRECTION: return "backward";
+    default:                 return "none";
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+LayoutExport::LayoutExport() :
+  mTotalRoutes(0),
+  mTotalVisits(0),
+  mOrigin(0),
+  mDirection(NO_DIRECTION),
+  mHasQuery(false)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+bool LayoutExport::explore(
+  const uint16_t inOrigin,
+  const uint16_t inTarget,
+  const Direction inDir,
+  const uint32_t inMaxRoutes)
+{
+  if (inTarget >= Track::count()) {
+    clearQuery();
+    return false;
+  }
+  return run(inOrigin, inTarget, NULL, inDir, inMaxRoutes);
+}
+
+/*---------------------------------------------------------------------------*/
+bool LayoutExport::explore(
+  const uint16_t inOrigin,
+  TrackSet & inTargets,
+  const Direction inDir,
+  const uint32_t inMaxRoutes)
+{
+  return run(inOrigin, 0, &inTargets, inDir, inMaxRoutes);
+}
+
+/*---------------------------------------------------------------------------*/
+bool LayoutExport::run(
+  const uint16_t inOrigin,
+  const uint16_t inTarget,
+  TrackSet * inTargets,
+  const Direction inDir,
+  const uint32_t inMaxRoutes)
+{
+  clearQuery();
+  if (! Track::trackNetIsOk() || inOrigin >= Track::count()) return false;
+
+  mExploration.assign(Track::count(), TrackExploration());
+  mRouteCount.assign(Track::count(), 0);
+  ExportSearch search(mRouteCount, mRoutes, inMaxRoutes);
+  search.setExploration(mExploration.data());
+  if (! search.run(Track::trackForId(inOrigin), inTarget, inTargets, inDir)) {
+    clearQuery();
+    return false;
+  }
+  mIsTarget.assign(Track::count(), false);
+  for (uint16_t id = 0; id < Track::count(); id++) {
+    mIsTarget[id] = (inTargets == NULL) ? (id == inTarget) : inTargets->containsTrack(id);
+  }
+  mTotalRoutes = search.count();
+  mTotalVisits = search.visitCount();
+  mOrigin = inOrigin;
+  mDirection = inDir;
+  mHasQuery = true;
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+void LayoutExport::clearQuery()
+{
+  mExploration.clear();
+  mRouteCount.clear();
+  mRoutes.clear();
+  mIsTarget.clear();
+  mTotalRoutes = 0;
+  mTotalVisits = 0;
+  mHasQuery = false;
+}
+
+/*---------------------------------------------------------------------------*/
+const char *LayoutExport::kindName(const TrackKind inKind)
+{
+  switch (inKind) {
+    case DEADEND_TRACK:    return "deadend";
+    case BLOCK_TRACK:      return "block";
+    case TURNOUT_TRACK:    return "turnout";
+    case THREEWAY_TRACK:   return "threeway";
+    case CROSSING_TRACK:   return "crossing";
+    case DOUBLESLIP_TRACK: return "doubleslip";
+    case SCISSORS_TRACK:   return "scissors";
+    default:               return "unknown";
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+const char *LayoutExport::connectorName(const Connector inConnector)
+{
+  switch (inConnector) {
+    case INLET:        return "inlet";
+    case LEFT_INLET:   return "left_inlet";
+    case RIGHT_INLET:  return "right_inlet";
+    case OUTLET:       return "outlet";
+    case LEFT_OUTLET:  return "left_outlet";
+    case RIGHT_OUTLET: return "right_outlet";
+    default:           return "unknown";
+  }
+}
+
+/*
+ * Connections are written once, by the track of lower identifier, or by
+ * the only one linked when the other is not connected back.
+ */
+static bool writesConnection(Track & inFrom, const Connector inConnector, Track & inTrack, const int8_t inBack)
+{
+  if (inBack < 0) return true;
+  if (&inFrom == &inTrack) return inConnector < inBack;
+  return inFrom.identifier() < inTrack.identifier();
+}
+
+/*---------------------------------------------------------------------------*/
+void LayoutExport::writeTrackName(FILE *outFile, const uint16_t inId) const
+{
+#ifdef SWITCHMAN_TRACK_NAMES
+  fputs(Track::trackForId(inId).name(), outFile);
+#else
+  fprintf(outFile, "%u", inId);
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+bool LayoutExport::writeDot(FILE *outFile) const
+{
+  uint32_t maxVisits = 0;
+  if (mHasQuery) {
+    for (uint16_t id = 0; id < Track::count(); id++) {
+      if (mExploration[id].visits > maxVisits) maxVisits = mExploration[id].visits;
+    }
+  }
+
+  fprintf(outFile, "graph switchman {\n");
+  fprintf(outFile, "  node [style=filled, fillcolor=white, fontsize=10];\n");
+  fprintf(outFile, "  edge [fontsize=8];\n");
+  if (mHasQuery) {
+    fprintf(outFile, "  label=\"");
+    writeTrackName(outFile, mOrigin);
+    fprintf(outFile, " ->");
+    for (uint16_t id = 0; id < Track::count(); id++) {
+      if (mIsTarget[id]) {
+        fprintf(outFile, " ");
+        writeTrackName(outFile, id);
+      }
+    }
+    fprintf(outFile, " %s: %lu routes, %lu visits\";\n", directionName(mDirection),
+            (unsigned long)mTotalRoutes, (unsigned long)mTotalVisits);
+  }
+
+  for (uint16_t id = 0; id < Track::tableSize(); id++) {
+    if (Track::findTrack(id) == NULL) continue;
+    Track & track = Track::trackForId(id);
+    static const char *shapes[] = {
+      "invhouse", "box", "triangle", "trapezium", "diamond", "Mdiamond", "Msquare"
+    };
+    fprintf(outFile, "  t%u [shape=%s, label=\"", id, shapes[track.kind()]);
+    writeTrackName(outFile, id);
+    if (mHasQuery) {
+      const TrackExploration & exploration = mExploration[id];
+      fprintf(outFile, "\\nv%lu m%lu p%lu r%lu\"",
+              (unsigned long)exploration.visits, (unsigned long)exploration.marked,
+              (unsigned long)exploration.pruned, (unsigned long)mRouteCount[id]);
+      if (exploration.visits > 0) {
+        /* White to red with the visits */
+        fprintf(outFile, ", fillcolor=\"0.000 %.3f 1.000\"", (double)exploration.visits / maxVisits);
+      }
+      if (mRouteCount[id] > 0) fprintf(outFile, ", color=blue, penwidth=3");
+      if (id == mOrigin || mIsTarget[id]) fprintf(outFile, ", peripheries=2");
+    }
+    else fprintf(outFile, "\"");
+    fprintf(outFile, "];\n");
+  }
+
+  for (uint16_t id = 0; id < Track::tableSize(); id++) {
+    if (Track::findTrack(id) == NULL) continue;
+    Track & track = Track::trackForId(id);
+    for (uint8_t c = 0; c < CONNECTOR_COUNT; c++) {
+      Track * other = track.connectedTrack((Connector)c);
+      if (other == NULL) continue;
+      const int8_t back = other->connectorBack(track, (Connector)c);
+      if (! writesConnection(track, (Connector)c, *other, back)) continue;
+      fprintf(outFile, "  t%u -- t%u [taillabel=\"%s\", headlabel=\"%s\"%s];\n",
+              id, other->identifier(), connectorName((Connector)c),
+              back < 0 ? "?" : connectorName((Connector)back),
+              DirectionSolver::isJoint(track, c) ? ", style=dashed" : "");
+    }
+  }
+  fprintf(outFile, "}\n");
+  return ferror(outFile) == 0;
+}
+
+/*---------------------------------------------------------------------------*/
+bool LayoutExport::writeJson(FILE *outFile) const
+{
+  fprintf(outFile, "{\n  \"tracks\": [");
+  bool firstTrack = true;
+  for (uint16_t id = 0; id < Track::tableSize(); id++) {
+    if (Track::findTrack(id) == NULL) continue;
+    Track & track = Track::trackForId(id);
+    fprintf(outFile, "%s\n    {\"id\": %u, \"name\": \"", firstTrack ? "" : ",", id);
+    firstTrack = false;
+    writeTrackName(outFile, id);
+    fprintf(outFile, "\", \"kind\": \"%s\", \"direction\": \"%s\"",
+            kindName(track.kind()), directionName(track.direction()));
+    if (mHasQuery) {
+      const TrackExploration & exploration = mExploration[id];
+      fprintf(outFile, ", \"visits\": %lu, \"marked\": %lu, \"pruned\": %lu, \"routes\": %lu",
+              (unsigned long)exploration.visits, (unsigned long)exploration.marked,
+              (unsigned long)exploration.pruned, (unsigned long)mRouteCount[id]);
+    }
+    fprintf(outFile, "}");
+  }
+  fprintf(outFile, "\n  ],\n  \"connections\": [");
+
+  bool first = true;
+  for (uint16_t id = 0; id < Track::tableSize(); id++) {
+    if (Track::findTrack(id) == NULL) continue;
+    Track & track = Track::trackForId(id);
+    for (uint8_t c = 0; c < CONNECTOR_COUNT; c++) {
+      Track * other = track.connectedTrack((Connector)c);
+      if (other == NULL) continue;
+      const int8_t back = other->connectorBack(track, (Connector)c);
+      if (! writesConnection(track, (Connector)c, *other, back)) continue;
+      fprintf(outFile, "%s\n    {\"from\": %u, \"fromConnector\": \"%s\", \"to\": %u, \"toConnector\": ",
+              first ? "" : ",", id, connectorName((Connector)c), other->identifier());
+      if (back < 0) fprintf(outFile, "null");
+      else fprintf(outFile, "\"%s\"", connectorName((Connector)back));
+      if (DirectionSolver::isJoint(track, c)) fprintf(outFile, ", \"joint\": true");
+      fprintf(outFile, "}");
+      first = false;
+    }
+  }
+  fprintf(outFile, "\n  ]");
+
+  if (mHasQuery) {
+    const uint32_t listed = mRoutes.size() / Track::sizeForSet();
+    fprintf(outFile, ",\n  \"query\": {\"origin\": %u, \"targets\": [", mOrigin);
+    bool firstTarget = true;
+    for (uint16_t id = 0; id < Track::count(); id++) {
+      if (mIsTarget[id]) {
+        fprintf(outFile, firstTarget ? "%u" : ", %u", id);
+        firstTarget = false;
+      }
+    }
+    fprintf(outFile, "], \"direction\": \"%s\", \"routeCount\": %lu, \"visits\": %lu, "
+            "\"truncated\": %s, \"routes\": [",
+            directionName(mDirection), (unsigned long)mTotalRoutes,
+            (unsigned long)mTotalVisits, listed < mTotalRoutes ? "true" : "false");
+    for (uint32_t r = 0; r < listed; r++) {
+      const uint8_t *route = mRoutes.data() + r * Track::sizeForSet();
+      fprintf(outFile, "%s\n    [", r == 0 ? "" : ",");
+      bool firstId = true;
+      for (uint16_t id = 0; id < Track::count(); id++) {
+        if (route[id >> 3] & (1 << (id & 7))) {
+          fprintf(outFile, firstId ? "%u" : ", %u", id);
+          firstId = false;
+        }
+      }
+      fprintf(outFile, "]");
+    }
+    fprintf(outFile, "%s]}", listed > 0 ? "\n  " : "");
+  }
+  fprintf(outFile, "\n}\n");
+  return ferror(outFile) == 0;
+}
+
+/*---------------------------------------------------------------------------*/
+bool LayoutExport::exportTo(const char *inPath) const
+{
+  FILE *file = fopen(inPath, "w");
+  if (file == NULL) return false;
+  const size_t length = strlen(inPath);
+  const bool json = length >= 5 && strcmp(inPath + length - 5, ".json") == 0;
+  bool ok = json ? writeJson(file) : writeDot(file);
+  if (fclose(file) != 0) ok = false;
+  return ok;
+}
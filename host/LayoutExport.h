@@ -0,0 +1,104 @@
+/*
+ * LayoutExport : the finalized track net as a Graphviz DOT graph or as
+ * JSON, with the exploration of a query as a heatmap.
+ *
+ * The tracks are given with their kind and direction, the connections
+ * once each with the connectors at both ends, dashed or marked "joint"
+ * when they are a reversing joint of DirectionSolver. When a query has been run
+ * by explore(), each track also gets:
+ * - visits, the times the search put it on the path;
+ * - marked, the times it was refused because already on the path;
+ * - pruned, the times it was not explored because no target remains
+ *   reachable from it, in a query to several targets when the
+ *   ReachabilityIndex is built;
+ * - routes, the number of routes found going through it.
+ * The DOT graph fills the tracks from white to red with their visits and
+ * draws in blue the ones on a route. The JSON lists the routes too, up
+ * to the limit given to explore().
+ *
+ * Everything is done in a time linear in the size of the net, of the
+ * exploration and of the routes listed, so large nets may be exported.
+ * A net that is not ok may be written, to be looked at with its
+ * LayoutReport, but not explored.
+ *
+ *   LayoutExport carte;
+ *   carte.explore(voie23_id, voie1_id, FORWARD_DIRECTION);
+ *   carte.exportTo("dom.dot");
+ *   dot -Tsvg dom.dot > dom.svg
+ */
+#ifndef __LAYOUTEXPORT_H__
+#define __LAYOUTEXPORT_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "PathSearch.h"
+
+class LayoutExport
+{
+  private:
+    std::vector<TrackExploration> mExploration;
+    std::vector<uint32_t> mRouteCount;  /* Routes going through each track */
+    std::vector<uint8_t> mRoutes;       /* Routes listed, TrackSet bytes    */
+    uint32_t mTotalRoutes;
+    uint32_t mTotalVisits;
+    std::vector<bool> mIsTarget;
+    uint16_t mOrigin;
+    Direction mDirection;
+    bool mHasQuery;
+
+    bool run(
+      const uint16_t inOrigin,
+      const uint16_t inTarget,
+      TrackSet * inTargets,
+      const Direction inDir,
+      const uint32_t inMaxRoutes
+    );
+    void writeTrackName(FILE *outFile, const uint16_t inId) const;
+
+  public:
+    LayoutExport();
+
+    /*
+     * Run the query from track inOrigin to track inTarget and keep its
+     * exploration for the heatmap. At most inMaxRoutes routes are kept
+     * to be listed, all are counted. Return false if the track net is
+     * not ok or a track does not exist.
+     */
+    bool explore(
+      const uint16_t inOrigin,
+      const uint16_t inTarget,
+      const Direction inDir,
+      const uint32_t inMaxRoutes = 64
+    );
+    /*
+     * Run the batch query from track inOrigin to the tracks of inTargets,
+     * as BatchSearch::pathsToAll does. The tracks leading to no target
+     * are pruned when the ReachabilityIndex is built.
+     */
+    bool explore(
+      const uint16_t inOrigin,
+      TrackSet & inTargets,
+      const Direction inDir,
+      const uint32_t inMaxRoutes = 64
+    );
+    /* Forget the query */
+    void clearQuery();
+    bool hasQuery() const { return mHasQuery; }
+    uint32_t routeCount() const { return mTotalRoutes; }
+    uint32_t visitCount() const { return mTotalVisits; }
+    /* Exploration of a track by the query */
+    const TrackExploration & exploration(const uint16_t inId) const { return mExploration[inId]; }
+
+    /* Write the net, return false on a write error */
+    bool writeDot(FILE *outFile) const;
+    bool writeJson(FILE *outFile) const;
+    /* Write the net in a file, JSON if its name ends with .json, DOT otherwise */
+    bool exportTo(const char *inPath) const;
+
+    static const char *kindName(const TrackKind inKind);
+    static const char *connectorName(const Connector inConnector);
+};
+
+#endif /* __LAYOUTEXPORT_H__ */
@@ -0,0 +1,336 @@
+/*
+ * RouteImage : read-only image of the finalized track net and of its
+ * routes, to be shared by the processes of a machine.
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "RouteImage.h"
+#include "PathSearch.h"
+#include "ReachabilityIndex.h"
+
+/*
+ * Search storing the routes in the image being built. A route found
+ * again by another path through the same tracks is stored once, as
+ * PathSet::addPath does.
+ */
+class ImageSearch : public PathSearch
+{
+  private:
+    std::vector<uint8_t> & mRoutes;
+    uint32_t mCount;
+    uint32_t mFirst;    /* First route of the pair being searched */
+
+    bool isStored(const TrackSet & inPath) const
+    {
+      const uint8_t size = Track::sizeForSet();
+      for (uint32_t r = mFirst; r < mCount; r++) {
+        const uint8_t *route = &mRoutes[(size_t)r * size];
+        uint8_t i = 0;
+        while (i < size && route[i] == inPath.byteAt(i)) i++;
+        if (i == size) return true;
+      }
+      return false;
+    }
+
+  protected:
+    virtual void pathFound(const TrackSet & inPath)
+    {
+      if (isStored(inPath)) return;
+      for (uint8_t i = 0; i < Track::sizeForSet(); i++) mRoutes.push_back(inPath.byteAt(i));
+      mCount++;
+    }
+
+  public:
+    ImageSearch(std::vector<uint8_t> & ioRoutes) : mRoutes(ioRoutes), mCount(0), mFirst(0) {}
+    uint32_t count() const { return mCount; }
+    void run(Track & inFrom, const uint16_t inId, const Direction inDir)
+    {
+      mFirst = mCount;
+      if (startSearch(inFrom, inId, inDir)) while (! step(1024));
+    }
+};
+
+/*---------------------------------------------------------------------------*/
+RouteImage::RouteImage() :
+  mImage(NULL),
+  mSize(0),
+  mMapped(false)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+RouteImage::~RouteImage()
+{
+  close();
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteImage::build(std::vector<uint8_t> & outImage)
+{
+  if (! Track::trackNetIsOk()) return false;
+
+  const uint16_t trackCount = Track::count();
+  const uint64_t pairCount = (uint64_t)trackCount * trackCount * 2;
+  /* The offsets of the header are 32 bits */
+  if (pairCount * sizeof(PairEntry) > UINT32_MAX) return false;
+  std::vector<uint8_t> routes;
+  std::vector<PairEntry> pairs(pairCount);
+  ImageSearch search(routes);
+
+  /* Crossings are not start tracks of the index, they are always searched */
+  const bool indexed = ReachabilityIndex::isBuilt();
+  for (uint16_t origin = 0; origin < trackCount; origin++) {
+    Track & from = Track::trackForId(origin);
+    for (uint16_t target = 0; target < trackCount; target++) {
+      for (uint8_t dir = FORWARD_DIRECTION; dir <= BACKWARD_DIRECTION; dir++) {
+        PairEntry & entry = pairs[((size_t)origin * trackCount + target) * 2 + dir];
+        entry.firstRoute = search.count();
+        if (indexed && origin != target && from.entryCount() == 1 &&
+            ! ReachabilityIndex::reaches(origin, target, (Direction)dir)) continue;
+        search.run(from, target, (Direction)dir);
+        entry.routeCount = search.count() - entry.firstRoute;
+      }
+    }
+  }
+
+  std::vector<TrackEntry> tracks(trackCount);
+  std::vector<char> names;
+  for (uint16_t id = 0; id < trackCount; id++) {
+    TrackEntry & entry = tracks[id];
+    memset(&entry, 0, sizeof(TrackEntry));
+    Track & track = Track::trackForId(id);
+    entry.isBlock = track.isBlock();
+    entry.kind = track.kind();
+    entry.direction = track.direction();
+    for (uint8_t c = 0; c < CONNECTOR_COUNT; c++) {
+      Track *connected = track.connectedTrack((Connector)c);
+      entry.connected[c] = (connected == NULL) ? ROUTE_IMAGE_NO_TRACK : connected->identifier();
+    }
+#ifdef SWITCHMAN_TRACK_NAMES
+    const char *name = track.name();
+    /* Offset in names for now, made absolute below */
+    entry.nameOffset = names.size() + 1;
+    names.insert(names.end(), name, name + strlen(name) + 1);
+#endif
+  }
+
+  Header head;
+  memset(&head, 0, sizeof(Header));
+  head.magic = ROUTE_IMAGE_MAGIC;
+  head.version = ROUTE_IMAGE_VERSION;
+  head.trackCount = trackCount;
+  head.setSize = Track::sizeForSet();
+  const uint64_t pairsOffset = sizeof(Header) + (uint64_t)trackCount * sizeof(TrackEntry);
+  const uint64_t routesOffset = pairsOffset + pairCount * sizeof(PairEntry);
+  const uint64_t namesOffset = routesOffset + routes.size();
+  const uint64_t size = namesOffset + names.size();
+  if (size > UINT32_MAX) return false;
+  head.tracksOffset = sizeof(Header);
+  head.pairsOffset = pairsOffset;
+  head.routesOffset = routesOffset;
+  head.routeCount = search.count();
+  head.namesOffset = namesOffset;
+  head.size = size;
+  for (uint16_t id = 0; id < trackCount; id++) {
+    if (tracks[id].nameOffset != 0) tracks[id].nameOffset += head.namesOffset - 1;
+  }
+
+  outImage.resize(head.size);
+  uint8_t *image = outImage.data();
+  memcpy(image, &head, sizeof(Header));
+  memcpy(image + head.tracksOffset, tracks.data(), trackCount * sizeof(TrackEntry));
+  memcpy(image + head.pairsOffset, pairs.data(), pairCount * sizeof(PairEntry));
+  memcpy(image + head.routesOffset, routes.data(), routes.size());
+  memcpy(image + head.namesOffset, names.data(), names.size());
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteImage::exportTo(const char *inPath)
+{
+  std::vector<uint8_t> image;
+  if (! build(image)) return false;
+
+  /* Written aside then renamed so that a reader never sees half an image */
+  std::vector<char> temporary(strlen(inPath) + 5);
+  snprintf(temporary.data(), temporary.size(), "%s.tmp", inPath);
+  int fd = open(temporary.data(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+  size_t written = 0;
+  while (written < image.size()) {
+    ssize_t size = write(fd, image.data() + written, image.size() - written);
+    if (size <= 0) break;
+    written += size;
+  }
+  bool ok = (::close(fd) == 0) && written == image.size();
+  if (ok) ok = (rename(temporary.data(), inPath) == 0);
+  if (! ok) unlink(temporary.data());
+  return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteImage::map(const char *inPath)
+{
+  close();
+  int fd = open(inPath, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat status;
+  void *memory = MAP_FAILED;
+  if (fstat(fd, &status) == 0 && status.st_size > 0) {
+    memory = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (memory == MAP_FAILED) return false;
+  if (! attach(memory, status.st_size)) {
+    munmap(memory, status.st_size);
+    return false;
+  }
+  mMapped = true;
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteImage::attach(const void *inImage, const size_t inSize)
+{
+  close();
+  const Header *head = (const Header *)inImage;
+  if (inSize < sizeof(Header) ||
+      head->magic != ROUTE_IMAGE_MAGIC ||
+      head->version != ROUTE_IMAGE_VERSION ||
+      head->size > inSize) return false;
+
+  const uint64_t pairCount = (uint64_t)head->trackCount * head->trackCount * 2;
+  if (head->tracksOffset + (uint64_t)head->trackCount * sizeof(TrackEntry) > head->pairsOffset ||
+      head->pairsOffset + pairCount * sizeof(PairEntry) > head->routesOffset ||
+      head->routesOffset + (uint64_t)head->routeCount * head->setSize > head->namesOffset ||
+      head->namesOffset > head->size) return false;
+
+  mImage = (const uint8_t *)inImage;
+  mSize = inSize;
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteImage::close()
+{
+  if (mMapped) munmap((void *)mImage, mSize);
+  mImage = NULL;
+  mSize = 0;
+  mMapped = false;
+}
+
+/*---------------------------------------------------------------------------*/
+const RouteImage::PairEntry *RouteImage::pair(
+  const uint16_t inOrigin,
+  const uint16_t inTarget,
+  const Direction inDir) const
+{
+  if (mImage == NULL) return NULL;
+  const uint16_t trackCount = header()->trackCount;
+  if (inOrigin >= trackCount || inTarget >= trackCount || inDir > BACKWARD_DIRECTION) {
+    return NULL;
+  }
+  const PairEntry *pairs = (const PairEntry *)(mImage + header()->pairsOffset);
+  const PairEntry *entry = &pairs[((uint32_t)inOrigin * trackCount + inTarget) * 2 + inDir];
+  /* A corrupted entry gives no route */
+  if ((uint64_t)entry->firstRoute + entry->routeCount > header()->routeCount) return NULL;
+  return entry;
+}
+
+/*---------------------------------------------------------------------------*/
+const RouteImage::TrackEntry *RouteImage::track(const uint16_t inId) const
+{
+  if (mImage == NULL || inId >= header()->trackCount) return NULL;
+  const TrackEntry *tracks = (const TrackEntry *)(mImage + header()->tracksOffset);
+  return &tracks[inId];
+}
+
+/*---------------------------------------------------------------------------*/
+const char *RouteImage::trackName(const uint16_t inId) const
+{
+  const TrackEntry *entry = track(inId);
+  if (entry == NULL) return NULL;
+  const uint32_t offset = entry->nameOffset;
+  if (offset < header()->namesOffset || offset >= header()->size) return NULL;
+  if (memchr(mImage + offset, 0, header()->size - offset) == NULL) return NULL;
+  return (const char *)(mImage + offset);
+}
+
+/*---------------------------------------------------------------------------*/
+uint16_t RouteImage::trackId(const char *inName) const
+{
+  uint16_t id = 0;
+  while (id < trackCount()) {
+    const char *name = trackName(id);
+    if (name != NULL && strcmp(name, inName) == 0) break;
+    id++;
+  }
+  return id;
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteImage::isBlock(const uint16_t inId) const
+{
+  const TrackEntry *entry = track(inId);
+  return entry != NULL && entry->isBlock != 0;
+}
+
+/*---------------------------------------------------------------------------*/
+TrackKind RouteImage::kind(const uint16_t inId) const
+{
+  const TrackEntry *entry = track(inId);
+  return (entry == NULL) ? DEADEND_TRACK : (TrackKind)entry->kind;
+}
+
+/*---------------------------------------------------------------------------*/
+Direction RouteImage::direction(const uint16_t inId) const
+{
+  const TrackEntry *entry = track(inId);
+  return (entry == NULL) ? NO_DIRECTION : (Direction)entry->direction;
+}
+
+/*---------------------------------------------------------------------------*/
+uint16_t RouteImage::connectedTrack(const uint16_t inId, const Connector inConnector) const
+{
+  const TrackEntry *entry = track(inId);
+  if (entry == NULL || inConnector >= CONNECTOR_COUNT) return trackCount();
+  const uint16_t connected = entry->connected[inConnector];
+  /* A corrupted entry gives no track */
+  return (connected >= trackCount()) ? trackCount() : connected;
+}
+
+/*---------------------------------------------------------------------------*/
+uint32_t RouteImage::routeCount(
+  const uint16_t inOrigin,
+  const uint16_t inTarget,
+  const Direction inDir) const
+{
+  const PairEntry *entry = pair(inOrigin, inTarget, inDir);
+  return entry ? entry->routeCount : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+const uint8_t *RouteImage::route(
+  const uint16_t inOrigin,
+  const uint16_t inTarget,
+  const Direction inDir,
+  const uint32_t inIndex) const
+{
+  const PairEntry *entry = pair(inOrigin, inTarget, inDir);
+  if (entry == NULL || inIndex >= entry->routeCount) return NULL;
+  return mImage + header()->routesOffset +
+         (size_t)(entry->firstRoute + inIndex) * header()->setSize;
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteImage::routeContainsTrack(const uint8_t *inRoute, const uint16_t inId) const
+{
+  if (inRoute == NULL || inId >= trackCount()) return false;
+  return (inRoute[inId >> 3] & (1 << (inId & 7))) != 0;
+}
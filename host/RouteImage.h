@@ -0,0 +1,116 @@
+/*
+ * RouteImage : read-only image of the finalized track net and of its
+ * routes, to be shared by the processes of a machine.
+ *
+ * One process exports the image once the net is finalized. The others
+ * map the file read-only, /dev/shm is a good place for it, and query the
+ * routes in place without linking the tracks nor searching. The image
+ * holds no pointer: everything is given by an offset from the start of
+ * the image, so it may be mapped at any address.
+ *
+ * The tracks keep their kind, the direction given by finalize and the
+ * track on each connector, so that a reader may draw the net or follow
+ * it, but not search it: the routes of every pair are in the image.
+ *
+ * Layout, all values in the byte order of the host:
+ *   Header
+ *   TrackEntry[trackCount]
+ *   PairEntry[trackCount * trackCount * 2], by origin, target, direction
+ *   routes, TrackSet bit vectors of setSize bytes
+ *   names, NUL terminated, when the tracks have names (TrackNames.h)
+ */
+#ifndef __ROUTEIMAGE_H__
+#define __ROUTEIMAGE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "Track.h"
+
+#define ROUTE_IMAGE_MAGIC    0x494D5753 /* SWMI */
+#define ROUTE_IMAGE_VERSION  2
+#define ROUTE_IMAGE_NO_TRACK 0xFFFF
+
+class RouteImage
+{
+  private:
+    typedef struct {
+      uint32_t magic;
+      uint16_t version;
+      uint16_t trackCount;
+      uint32_t setSize;
+      uint32_t size;          /* Size of the whole image */
+      uint32_t tracksOffset;
+      uint32_t pairsOffset;
+      uint32_t routesOffset;
+      uint32_t routeCount;
+      uint32_t namesOffset;
+    } Header;
+
+    typedef struct {
+      uint32_t nameOffset;    /* 0 if the track has no name */
+      uint8_t isBlock;
+      uint8_t kind;           /* TrackKind                          */
+      uint8_t direction;      /* Direction given by finalize        */
+      uint8_t padding;
+      uint16_t connected[CONNECTOR_COUNT]; /* By Connector, or ROUTE_IMAGE_NO_TRACK */
+    } TrackEntry;
+
+    typedef struct {
+      uint32_t firstRoute;    /* Index of the first route of the pair */
+      uint32_t routeCount;
+    } PairEntry;
+
+    const uint8_t *mImage;
+    size_t mSize;
+    bool mMapped;
+
+    const Header *header() const { return (const Header *)mImage; }
+    const PairEntry *pair(const uint16_t inOrigin, const uint16_t inTarget, const Direction inDir) const;
+    const TrackEntry *track(const uint16_t inId) const;
+
+  public:
+    RouteImage();
+    ~RouteImage();
+
+    /*
+     * Build the image of the finalized track net. False if the net is
+     * not ok or the image does not fit the 32 bits offsets.
+     */
+    static bool build(std::vector<uint8_t> & outImage);
+    /* Build the image and write it in a file, replaced atomically */
+    static bool exportTo(const char *inPath);
+
+    /* Map an image file read-only */
+    bool map(const char *inPath);
+    /* Use an image already in memory. It must stay there */
+    bool attach(const void *inImage, const size_t inSize);
+    void close();
+    bool isOpen() const { return mImage != NULL; }
+
+    uint16_t trackCount() const { return mImage ? header()->trackCount : 0; }
+    uint8_t routeSize() const { return mImage ? header()->setSize : 0; }
+    /* Name of a track or NULL */
+    const char *trackName(const uint16_t inId) const;
+    /* Id of a named track or trackCount() */
+    uint16_t trackId(const char *inName) const;
+    bool isBlock(const uint16_t inId) const;
+    /* Kind of a track, DEADEND_TRACK for an unknown id */
+    TrackKind kind(const uint16_t inId) const;
+    /* Direction of a track or NO_DIRECTION */
+    Direction direction(const uint16_t inId) const;
+    /* Id of the track connected to inConnector or trackCount() */
+    uint16_t connectedTrack(const uint16_t inId, const Connector inConnector) const;
+    uint32_t routeCount(const uint16_t inOrigin, const uint16_t inTarget, const Direction inDir) const;
+    /* Bit vector of a route or NULL */
+    const uint8_t *route(
+      const uint16_t inOrigin,
+      const uint16_t inTarget,
+      const Direction inDir,
+      const uint32_t inIndex
+    ) const;
+    bool routeContainsTrack(const uint8_t *inRoute, const uint16_t inId) const;
+};
+
+#endif /* __ROUTEIMAGE_H__ */
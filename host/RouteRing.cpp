@@ -0,0 +1,123 @@
+/*
+ * RouteRing : ring of route answers in POSIX shared memory.
+ */
+#include <new>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "RouteRing.h"
+
+/*---------------------------------------------------------------------------*/
+RouteRing::RouteRing() :
+  mHeader(NULL),
+  mData(NULL),
+  mMappedSize(0),
+  mName(NULL)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+RouteRing::~RouteRing()
+{
+  close();
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteRing::create(const char *inName, const uint32_t inCapacity)
+{
+  close();
+  if (inCapacity == 0) return false;
+  int fd = shm_open(inName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+  mMappedSize = sizeof(Header) + inCapacity;
+  if (ftruncate(fd, mMappedSize) != 0) {
+    ::close(fd);
+    shm_unlink(inName);
+    return false;
+  }
+  void *memory = mmap(NULL, mMappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (memory == MAP_FAILED) {
+    shm_unlink(inName);
+    return false;
+  }
+  mHeader = new (memory) Header;
+  mHeader->capacity = inCapacity;
+  mHeader->head.store(0, std::memory_order_relaxed);
+  mData = (uint8_t *)memory + sizeof(Header);
+  mName = strdup(inName);
+  /* Clients check the magic, write it last */
+  std::atomic_thread_fence(std::memory_order_release);
+  mHeader->magic = ROUTE_RING_MAGIC;
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteRing::attach(const char *inName)
+{
+  close();
+  int fd = shm_open(inName, O_RDONLY, 0);
+  if (fd < 0) return false;
+  Header header;
+  bool ok = (pread(fd, &header, sizeof(Header), 0) == sizeof(Header)) &&
+            header.magic == ROUTE_RING_MAGIC;
+  if (ok) {
+    mMappedSize = sizeof(Header) + header.capacity;
+    void *memory = mmap(NULL, mMappedSize, PROT_READ, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) ok = false;
+    else {
+      mHeader = (Header *)memory;
+      mData = (uint8_t *)memory + sizeof(Header);
+    }
+  }
+  ::close(fd);
+  return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteRing::close()
+{
+  if (mHeader != NULL) munmap(mHeader, mMappedSize);
+  if (mName != NULL) {
+    shm_unlink(mName);
+    free(mName);
+  }
+  mHeader = NULL;
+  mData = NULL;
+  mMappedSize = 0;
+  mName = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteRing::write(const uint8_t *inData, const uint32_t inLength, uint64_t & outPosition)
+{
+  if (mHeader == NULL || mName == NULL || inLength > mHeader->capacity) return false;
+  const uint64_t capacity = mHeader->capacity;
+  uint64_t position = mHeader->head.load(std::memory_order_relaxed);
+  /* An answer is not split, go to the next turn if it does not fit */
+  if ((position % capacity) + inLength > capacity) {
+    position += capacity - (position % capacity);
+  }
+  mHeader->head.store(position + inLength, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(mData + (position % capacity), inData, inLength);
+  std::atomic_thread_fence(std::memory_order_release);
+  outPosition = position;
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteRing::read(const uint64_t inPosition, const uint32_t inLength, uint8_t *outData) const
+{
+  if (mHeader == NULL) return false;
+  const uint64_t capacity = mHeader->capacity;
+  uint64_t head = mHeader->head.load(std::memory_order_acquire);
+  if (inPosition + inLength > head || head - inPosition > capacity) return false;
+  memcpy(outData, mData + (inPosition % capacity), inLength);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  head = mHeader->head.load(std::memory_order_relaxed);
+  return head - inPosition <= capacity;
+}
@@ -0,0 +1,51 @@
+/*
+ * RouteRing : ring of route answers in POSIX shared memory.
+ *
+ * The route server writes the answers too large for a socket message in
+ * the ring and sends their position and length instead. Clients map the
+ * ring read-only and copy the answer out. Positions grow without wrapping,
+ * the offset in the ring is position % capacity, and an answer is never
+ * split at the end of the ring. The head is moved before the data are
+ * written so a reader knows that its copy is good if, after copying,
+ * head - position is not above the capacity.
+ */
+#ifndef __ROUTERING_H__
+#define __ROUTERING_H__
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ROUTE_RING_MAGIC 0x53574D52 /* SWMR */
+
+class RouteRing
+{
+  private:
+    typedef struct {
+      uint32_t magic;
+      uint32_t capacity;
+      std::atomic<uint64_t> head;
+    } Header;
+
+    Header *mHeader;
+    uint8_t *mData;
+    size_t mMappedSize;
+    char *mName;        /* Name to unlink, server side only */
+
+  public:
+    RouteRing();
+    ~RouteRing();
+    /* Create the ring, server side */
+    bool create(const char *inName, const uint32_t inCapacity);
+    /* Map an existing ring read-only, client side */
+    bool attach(const char *inName);
+    void close();
+    bool isOpen() const { return mHeader != NULL; }
+    uint32_t capacity() const { return mHeader ? mHeader->capacity : 0; }
+    /* Write an answer. Return false if it is larger than the ring */
+    bool write(const uint8_t *inData, const uint32_t inLength, uint64_t & outPosition);
+    /* Copy an answer. Return false if it has been overwritten */
+    bool read(const uint64_t inPosition, const uint32_t inLength, uint8_t *outData) const;
+};
+
+#endif /* __ROUTERING_H__ */
@@ -0,0 +1,375 @@
+/*
+ * RouteServer : route daemon serving the local processes over a Unix
+ * domain socket.
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "RouteServer.h"
+#include "ReachabilityIndex.h"
+
+#define FRAME_HEADER_LENGTH  5
+#define FRAME_CRC_LENGTH     2
+#define QUERY_ITEM_LENGTH    6
+#define MAX_PAYLOAD_LENGTH   0xFFFF
+/* status | route count (2) | route size | place */
+#define ROUTES_HEADER_LENGTH 5
+/* ring position (8) | length (4) */
+#define RING_PLACE_LENGTH    12
+
+/*---------------------------------------------------------------------------*/
+RouteServer::RouteServer(EventLoop & inLoop, const uint16_t inBudget) :
+  mLoop(inLoop),
+  mRouter(inLoop, inBudget),
+  mListenFd(-1),
+  mSocketPath(NULL),
+  mGeneration(0),
+  mNextReservation(1)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+RouteServer::~RouteServer()
+{
+  close();
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteServer::open(
+  const char *inSocketPath,
+  const char *inRingName,
+  const uint32_t inRingCapacity)
+{
+  close();
+  struct sockaddr_un address;
+  if (strlen(inSocketPath) >= sizeof(address.sun_path)) return false;
+  if (! mRing.create(inRingName, inRingCapacity)) return false;
+
+  mListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (mListenFd < 0) {
+    close();
+    return false;
+  }
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, inSocketPath);
+  unlink(inSocketPath);
+  if (bind(mListenFd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(mListenFd, 16) != 0) {
+    close();
+    return false;
+  }
+  mSocketPath = strdup(inSocketPath);
+  mReserved.assign(Track::sizeForSet(), 0);
+  acceptClients();
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteServer::close()
+{
+  /* The coroutines see another generation when resumed and end */
+  mGeneration++;
+  if (mListenFd >= 0) ::close(mListenFd);
+  mListenFd = -1;
+  for (size_t i = 0; i < mClientFds.size(); i++) ::close(mClientFds[i]);
+  mClientFds.clear();
+  mReservations.clear();
+  mReserved.assign(mReserved.size(), 0);
+  if (mSocketPath != NULL) {
+    unlink(mSocketPath);
+    free(mSocketPath);
+    mSocketPath = NULL;
+  }
+  mRing.close();
+}
+
+/*---------------------------------------------------------------------------*/
+AsyncTask RouteServer::acceptClients()
+{
+  const uint32_t generation = mGeneration;
+  while (true) {
+    co_await mLoop.readable(mListenFd);
+    if (generation != mGeneration) co_return;
+    int fd = accept4(mListenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd >= 0) serveClient(fd);
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+uint16_t RouteServer::completeFrame(std::vector<uint8_t> & ioInput)
+{
+  while (! ioInput.empty()) {
+    size_t sync = 0;
+    while (sync < ioInput.size() && ioInput[sync] != ROUTE_PROTOCOL_SYNC) sync++;
+    ioInput.erase(ioInput.begin(), ioInput.begin() + sync);
+    if (ioInput.size() < FRAME_HEADER_LENGTH) return 0;
+
+    const uint16_t length = ioInput[3] | (ioInput[4] << 8);
+    const uint16_t frameLength = FRAME_HEADER_LENGTH + length + FRAME_CRC_LENGTH;
+    if (ioInput[1] != ROUTE_BATCH_FRAME || frameLength > ROUTE_SERVER_MAX_FRAME) {
+      ioInput.erase(ioInput.begin());
+      continue;
+    }
+    if (ioInput.size() < frameLength) return 0;
+
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 1; i < FRAME_HEADER_LENGTH + length; i++) {
+      crc = RouteProtocol::crc(crc, ioInput[i]);
+    }
+    const uint16_t received = ioInput[frameLength - 2] | (ioInput[frameLength - 1] << 8);
+    if (crc == received) return frameLength;
+    ioInput.erase(ioInput.begin());
+  }
+  return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteServer::beginFrame(std::vector<uint8_t> & ioOutput, const uint8_t inSeq)
+{
+  ioOutput.push_back(ROUTE_PROTOCOL_SYNC);
+  ioOutput.push_back(ROUTE_BATCH_ANSWER_FRAME);
+  ioOutput.push_back(inSeq);
+  putWord(ioOutput, 0); /* Length, set by endFrame */
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteServer::endFrame(std::vector<uint8_t> & ioOutput, const size_t inStart)
+{
+  const uint16_t length = ioOutput.size() - inStart - FRAME_HEADER_LENGTH;
+  ioOutput[inStart + 3] = length & 0xFF;
+  ioOutput[inStart + 4] = length >> 8;
+  uint16_t crc = 0xFFFF;
+  for (size_t i = inStart + 1; i < ioOutput.size(); i++) {
+    crc = RouteProtocol::crc(crc, ioOutput[i]);
+  }
+  putWord(ioOutput, crc);
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteServer::putWord(std::vector<uint8_t> & ioOutput, const uint16_t inWord)
+{
+  ioOutput.push_back(inWord & 0xFF);
+  ioOutput.push_back(inWord >> 8);
+}
+
+/*---------------------------------------------------------------------------*/
+uint32_t RouteServer::answerRoom(const std::vector<uint8_t> & inOutput, const uint8_t inItemsAfter)
+{
+  /* Room is kept for each following answer to give its routes in the ring */
+  const uint32_t used = inOutput.size() - FRAME_HEADER_LENGTH +
+                        (uint32_t)inItemsAfter * (ROUTES_HEADER_LENGTH + RING_PLACE_LENGTH);
+  return used >= MAX_PAYLOAD_LENGTH ? 0 : MAX_PAYLOAD_LENGTH - used;
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteServer::putRoutes(
+  std::vector<uint8_t> & ioOutput,
+  const RouteArena & inRoutes,
+  const uint32_t inRoom)
+{
+  const uint8_t size = Track::sizeForSet();
+  const uint32_t length = (uint32_t)inRoutes.count() * size;
+  const uint8_t *bytes = inRoutes.route(0);
+  uint64_t position = 0;
+  /* Routes that do not fit in the frame go in the ring too */
+  const bool inlined =
+    length <= ROUTE_SERVER_INLINE_BYTES && ROUTES_HEADER_LENGTH + length <= inRoom;
+  const bool inRing = ! inlined &&
+    ROUTES_HEADER_LENGTH + RING_PLACE_LENGTH <= inRoom && mRing.write(bytes, length, position);
+
+  if (inRoutes.overflow() || (! inlined && ! inRing)) {
+    ioOutput.push_back(ROUTE_TOO_MANY);
+    return;
+  }
+  ioOutput.push_back(ROUTE_OK);
+  putWord(ioOutput, inRoutes.count());
+  ioOutput.push_back(size);
+  if (inRing) {
+    ioOutput.push_back(ROUTES_IN_RING);
+    for (uint8_t i = 0; i < 8; i++) ioOutput.push_back(position >> (i * 8));
+    for (uint8_t i = 0; i < 4; i++) ioOutput.push_back(length >> (i * 8));
+  }
+  else {
+    ioOutput.push_back(ROUTES_INLINE);
+    ioOutput.insert(ioOutput.end(), bytes, bytes + length);
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteServer::isReservable(const uint8_t *inRoute) const
+{
+  for (uint8_t i = 0; i < mReserved.size(); i++) {
+    if (inRoute[i] & mReserved[i]) return false;
+  }
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteServer::reserve(const uint8_t *inRoute, const bool inReserve)
+{
+  for (uint8_t i = 0; i < mReserved.size(); i++) {
+    if (inReserve) mReserved[i] |= inRoute[i];
+    else           mReserved[i] &= ~inRoute[i];
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteServer::release(const uint16_t inId, const int inOwner)
+{
+  for (size_t i = 0; i < mReservations.size(); i++) {
+    if (mReservations[i].id == inId && mReservations[i].owner == inOwner) {
+      reserve(mReservations[i].route.data(), false);
+      mReservations.erase(mReservations.begin() + i);
+      return true;
+    }
+  }
+  return false;
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteServer::releaseAll(const int inOwner)
+{
+  size_t i = 0;
+  while (i < mReservations.size()) {
+    if (mReservations[i].owner == inOwner) {
+      reserve(mReservations[i].route.data(), false);
+      mReservations.erase(mReservations.begin() + i);
+    }
+    else i++;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+AsyncTask RouteServer::serveClient(int inFd)
+{
+  std::vector<uint8_t> input;
+  std::vector<uint8_t> output;
+  std::vector<uint8_t> memory(ROUTE_SERVER_ARENA_BYTES);
+  RouteArena routes(memory.data(), memory.size());
+  uint8_t buffer[1024];
+  bool connected = true;
+  /* Once closed, the fd and the reservations are not the client's any more */
+  const uint32_t generation = mGeneration;
+
+  mClientFds.push_back(inFd);
+  while (connected) {
+    co_await mLoop.readable(inFd);
+    if (generation != mGeneration) co_return;
+    ssize_t received = read(inFd, buffer, sizeof(buffer));
+    if (received < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+    if (received <= 0) break;
+    input.insert(input.end(), buffer, buffer + received);
+
+    uint16_t frameLength;
+    while (connected && (frameLength = completeFrame(input)) > 0) {
+      const uint16_t length = frameLength - FRAME_HEADER_LENGTH - FRAME_CRC_LENGTH;
+      const uint8_t count = (length > 0) ? input[FRAME_HEADER_LENGTH] : 0;
+      if (length == 0 || length != 1 + count * QUERY_ITEM_LENGTH) {
+        /* Malformed batch, dropped */
+        input.erase(input.begin(), input.begin() + frameLength);
+        continue;
+      }
+
+      output.clear();
+      beginFrame(output, input[2]);
+      output.push_back(count);
+      for (uint8_t i = 0; i < count; i++) {
+        const uint8_t *item = &input[FRAME_HEADER_LENGTH + 1 + i * QUERY_ITEM_LENGTH];
+        const uint8_t op = item[0];
+        const uint16_t origin = item[1] | (item[2] << 8);
+        const uint16_t target = item[3] | (item[4] << 8);
+        const Direction dir = (Direction)item[5];
+
+        if (op == SERVER_RELEASE) {
+          output.push_back(release(origin, inFd) ? ROUTE_OK : ROUTE_BAD_QUERY);
+          continue;
+        }
+        if (op < SERVER_ROUTES || op > SERVER_RESERVE || dir > BACKWARD_DIRECTION) {
+          output.push_back(ROUTE_BAD_QUERY);
+          continue;
+        }
+        if (origin >= Track::count() || target >= Track::count()) {
+          output.push_back(ROUTE_BAD_TRACK);
+          continue;
+        }
+        if (! Track::trackNetIsOk()) {
+          output.push_back(ROUTE_BAD_NET);
+          continue;
+        }
+        const uint32_t room = answerRoom(output, count - 1 - i);
+        if (op == SERVER_REACHES && room < 2) {
+          output.push_back(ROUTE_TOO_MANY);
+          continue;
+        }
+        if (op == SERVER_REACHES && ReachabilityIndex::isBuilt()) {
+          output.push_back(ROUTE_OK);
+          output.push_back(ReachabilityIndex::reaches(origin, target, dir));
+          continue;
+        }
+
+        /* The other clients are served while the search runs */
+        co_await mRouter.pathsTo(Track::trackForId(origin), target, dir, routes);
+        if (generation != mGeneration) co_return;
+
+        if (op == SERVER_ROUTES) putRoutes(output, routes, room);
+        else if (op == SERVER_REACHES) {
+          output.push_back(ROUTE_OK);
+          output.push_back(routes.count() > 0);
+        }
+        else if (4 + (uint32_t)Track::sizeForSet() > room) {
+          /* The route would not fit in the frame, nothing is reserved */
+          output.push_back(ROUTE_TOO_MANY);
+        }
+        else {
+          uint16_t free = 0;
+          while (free < routes.count() && ! isReservable(routes.route(free))) free++;
+          if (free == routes.count()) {
+            output.push_back(routes.count() == 0 ? ROUTE_BAD_QUERY : ROUTE_BUSY);
+            continue;
+          }
+          const uint8_t *route = routes.route(free);
+          Reservation reservation;
+          reservation.id = mNextReservation++;
+          if (mNextReservation == 0) mNextReservation = 1;
+          reservation.owner = inFd;
+          reservation.route.assign(route, route + Track::sizeForSet());
+          reserve(route, true);
+          mReservations.push_back(reservation);
+          output.push_back(ROUTE_OK);
+          putWord(output, reservation.id);
+          output.push_back(Track::sizeForSet());
+          output.insert(output.end(), route, route + Track::sizeForSet());
+        }
+      }
+      endFrame(output, 0);
+      input.erase(input.begin(), input.begin() + frameLength);
+
+      size_t sent = 0;
+      while (sent < output.size()) {
+        ssize_t written = write(inFd, output.data() + sent, output.size() - sent);
+        if (written > 0) sent += written;
+        else if (written < 0 && (errno == EAGAIN || errno == EINTR)) {
+          co_await mLoop.writable(inFd);
+          if (generation != mGeneration) co_return;
+        }
+        else {
+          connected = false;
+          break;
+        }
+      }
+    }
+  }
+  releaseAll(inFd);
+  for (size_t i = 0; i < mClientFds.size(); i++) {
+    if (mClientFds[i] == inFd) {
+      mClientFds.erase(mClientFds.begin() + i);
+      break;
+    }
+  }
+  ::close(inFd);
+}
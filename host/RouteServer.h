@@ -0,0 +1,119 @@
+/*
+ * RouteServer : route daemon serving the local processes over a Unix
+ * domain socket. C++20 is needed.
+ *
+ * The frames are those of RouteProtocol:
+ *   0x7E | type | seq | len (2) | payload (len) | crc (2)
+ * A batch request (type 0x02) holds several queries:
+ *   count (1) | count * (op (1) | origin (2) | target (2) | direction (1))
+ * The batch answer (type 0x82, same seq) holds an answer per query:
+ *   count (1) | answers
+ * Answers, according to the op:
+ *   SERVER_ROUTES  status (1) | route count (2) | route size (1) |
+ *                  place (1) | routes, or ring position (8) | length (4)
+ *   SERVER_REACHES status (1) | reachable (1)
+ *   SERVER_RESERVE status (1) | reservation (2) | route size (1) | route
+ *   SERVER_RELEASE status (1), the reservation is given as origin
+ * When the status is not ROUTE_OK, the answer is the status alone.
+ * Routes are TrackSet bit vectors. When the routes of a query are more
+ * than ROUTE_SERVER_INLINE_BYTES, they are written in the RouteRing and
+ * the answer gives where they are. They go in the ring as well when they
+ * would leave no room in the 65535 bytes of the batch answer for the
+ * answers that follow, and a reservation that does not fit is answered
+ * ROUTE_TOO_MANY. A reservation
+ * takes the first route whose tracks are not reserved and is released
+ * when the client that made it disconnects. ROUTE_BUSY is answered when every route is taken
+ * and ROUTE_BAD_QUERY when there is no route at all.
+ *
+ * Each client is served by a coroutine of an EventLoop, the searches of
+ * all the clients are stepped in turn so that a long search does not
+ * hold the others. The coroutines check the generation of the server
+ * after each co_await and end once it has been closed.
+ */
+#ifndef __ROUTESERVER_H__
+#define __ROUTESERVER_H__
+
+#include <vector>
+
+#include "AsyncRoutes.h"
+#include "RouteProtocol.h"
+#include "RouteRing.h"
+
+#define ROUTE_BATCH_FRAME          0x02
+#define ROUTE_BATCH_ANSWER_FRAME   0x82
+
+#ifndef ROUTE_SERVER_INLINE_BYTES
+#define ROUTE_SERVER_INLINE_BYTES  512
+#endif
+
+#ifndef ROUTE_SERVER_ARENA_BYTES
+#define ROUTE_SERVER_ARENA_BYTES   65536
+#endif
+
+/* Largest request frame accepted */
+#define ROUTE_SERVER_MAX_FRAME     (7 + 1 + 255 * 6)
+
+typedef enum {
+  SERVER_ROUTES  = 1,
+  SERVER_REACHES = 2,
+  SERVER_RESERVE = 3,
+  SERVER_RELEASE = 4
+} ServerOp;
+
+typedef enum {
+  ROUTES_INLINE  = 0,
+  ROUTES_IN_RING = 1
+} RoutesPlace;
+
+class RouteServer
+{
+  private:
+    typedef struct {
+      uint16_t id;
+      int owner;                    /* Socket of the client */
+      std::vector<uint8_t> route;
+    } Reservation;
+
+    EventLoop & mLoop;
+    AsyncRouter mRouter;
+    RouteRing mRing;
+    int mListenFd;
+    char *mSocketPath;
+    uint32_t mGeneration;            /* Changed by close()      */
+    std::vector<int> mClientFds;
+    uint16_t mNextReservation;
+    std::vector<Reservation> mReservations;
+    std::vector<uint8_t> mReserved;  /* Tracks reserved by anyone */
+
+    AsyncTask acceptClients();
+    AsyncTask serveClient(int inFd);
+    /* Drop bytes up to a frame. Return its length once fully received */
+    static uint16_t completeFrame(std::vector<uint8_t> & ioInput);
+    static void beginFrame(std::vector<uint8_t> & ioOutput, const uint8_t inSeq);
+    static void endFrame(std::vector<uint8_t> & ioOutput, const size_t inStart);
+    static void putWord(std::vector<uint8_t> & ioOutput, const uint16_t inWord);
+    /* Payload bytes left in the answer frame for the answer of an item */
+    static uint32_t answerRoom(const std::vector<uint8_t> & inOutput, const uint8_t inItemsAfter);
+    void putRoutes(std::vector<uint8_t> & ioOutput, const RouteArena & inRoutes, const uint32_t inRoom);
+    bool isReservable(const uint8_t *inRoute) const;
+    void reserve(const uint8_t *inRoute, const bool inReserve);
+    bool release(const uint16_t inId, const int inOwner);
+    void releaseAll(const int inOwner);
+
+  public:
+    RouteServer(EventLoop & inLoop, const uint16_t inBudget = 64);
+    ~RouteServer();
+    /*
+     * Listen on the socket and create the ring. The track net must be
+     * finalized and ReachabilityIndex built before.
+     */
+    bool open(const char *inSocketPath, const char *inRingName, const uint32_t inRingCapacity);
+    /*
+     * Close the socket and the clients. Their coroutines end when the
+     * event loop resumes them, the server must live until then.
+     */
+    void close();
+    uint16_t clientCount() const { return mClientFds.size(); }
+};
+
+#endif /* __ROUTESERVER_H__ */
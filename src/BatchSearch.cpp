@@ -0,0 +1,144 @@
+/*
+ * BatchSearch : routes from a track to several tracks, or from several
+ * tracks to a track, in one traversal.
+ */
+#include "BatchSearch.h"
+#include "ReachabilityIndex.h"
+#include "DirectionSolver.h"
+#include "Profile.h"
+#include "HeapStats.h"
+
+/*---------------------------------------------------------------------------*/
+PathSetMap::PathSetMap() :
+  mCount(0),
+  mKeys(NULL),
+  mPaths(NULL)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+PathSetMap::~PathSetMap()
+{
+  HEAP_FREED(HEAP_SEARCH, mCount * (sizeof(uint16_t) + sizeof(PathSet)));
+  if (mKeys != NULL) delete [] mKeys;
+  if (mPaths != NULL) delete [] mPaths;
+}
+
+/*---------------------------------------------------------------------------*/
+void PathSetMap::setKeys(TrackSet & inKeys)
+{
+  HEAP_FREED(HEAP_SEARCH, mCount * (sizeof(uint16_t) + sizeof(PathSet)));
+  if (mKeys != NULL) delete [] mKeys;
+  if (mPaths != NULL) delete [] mPaths;
+  mCount = 0;
+  for (uint16_t id = 0; id < Track::count(); id++) {
+    if (inKeys.containsTrack(id)) mCount++;
+  }
+  mKeys = new uint16_t[mCount];
+  mPaths = new PathSet[mCount];
+  HEAP_ALLOCATED(HEAP_SEARCH, mCount * (sizeof(uint16_t) + sizeof(PathSet)));
+  uint16_t index = 0;
+  for (uint16_t id = 0; id < Track::count(); id++) {
+    if (inKeys.containsTrack(id)) mKeys[index++] = id;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+PathSet * PathSetMap::pathsFor(const uint16_t inId)
+{
+  uint16_t low = 0;
+  uint16_t high = mCount;
+  while (low < high) {
+    uint16_t middle = (low + high) >> 1;
+    if (mKeys[middle] < inId) low = middle + 1;
+    else high = middle;
+  }
+  return (low < mCount && mKeys[low] == inId) ? &mPaths[low] : NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+BatchSearch::BatchSearch() :
+  mMap(NULL),
+  mOriginPaths(NULL),
+  mFromOrigins(false)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+void BatchSearch::pathFound(const TrackSet & inPath)
+{
+  if (mOriginPaths != NULL) {
+    mOriginPaths->addPath(inPath);
+    return;
+  }
+  /* From several origins, the track reached is the origin */
+  Track * track = lastTrack();
+  /* A search starting on a crossing has no way to take, see pathsFromAll */
+  if (mFromOrigins && track->entryCount() > 1) return;
+  PathSet * paths = mMap->pathsFor(track->identifier());
+  if (paths != NULL) paths->addPath(inPath);
+}
+
+/*---------------------------------------------------------------------------*/
+bool BatchSearch::pathsToAll(
+  Track & inFrom,
+  TrackSet & inTargets,
+  const Direction inDir,
+  PathSetMap & outPaths)
+{
+  PROFILE_SCOPE(PROFILE_QUERY);
+  HEAP_QUERY_SCOPE();
+  outPaths.setKeys(inTargets);
+  mMap = &outPaths;
+  mFromOrigins = false;
+  if (! startSearch(inFrom, inTargets, inDir)) return false;
+  while (! step(0xFFFF));
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+bool BatchSearch::pathsFromAll(
+  TrackSet & inOrigins,
+  const uint16_t inId,
+  const Direction inDir,
+  PathSetMap & outPaths)
+{
+  PROFILE_SCOPE(PROFILE_QUERY);
+  HEAP_QUERY_SCOPE();
+  outPaths.setKeys(inOrigins);
+  mMap = &outPaths;
+  if (inId >= Track::count()) return false;
+  Track & target = Track::trackForId(inId);
+
+  /*
+   * A search starting on a crossing has no way to take: there is no route
+   * from a crossing to another track, and the routes to a crossing are
+   * searched from each origin. So are the routes of a net with reversing
+   * joints, since the target may then be reached in both directions.
+   * The origins from which the index tells the target cannot be reached
+   * are not searched.
+   */
+  if (target.entryCount() > 1 || DirectionSolver::jointCount() > 0) {
+    bool result = true;
+    for (uint16_t i = 0; i < outPaths.count() && result; i++) {
+      const uint16_t origin = outPaths.keyAt(i);
+      if (ReachabilityIndex::isBuilt() &&
+          ! ReachabilityIndex::reaches(origin, inId, inDir)) {
+        continue;
+      }
+      mOriginPaths = &outPaths.pathsAt(i);
+      result = startSearch(Track::trackForId(origin), inId, inDir);
+      if (result) while (! step(0xFFFF));
+    }
+    mOriginPaths = NULL;
+    return result;
+  }
+
+  const Direction back =
+    (inDir == FORWARD_DIRECTION) ? BACKWARD_DIRECTION : FORWARD_DIRECTION;
+  mFromOrigins = true;
+  bool result = startSearch(target, inOrigins, back);
+  if (result) while (! step(0xFFFF));
+  mFromOrigins = false;
+  return result;
+}
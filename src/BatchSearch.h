@@ -0,0 +1,72 @@
+/*
+ * BatchSearch : routes from a track to several tracks, or from several
+ * tracks to a track, in one traversal.
+ *
+ * A search to several targets goes on beyond the targets and records
+ * each path reaching one of them, so the tracks near the departure are
+ * walked once for all the targets instead of once per target. When the
+ * ReachabilityIndex is built, the search does not go where no target
+ * remains reachable. A search from several origins is a search from the
+ * target to the origins in the opposite direction, or a search from each
+ * origin when the target is a crossing.
+ *
+ *   TrackSet quais;
+ *   quais.addTrack(voie1_id);
+ *   quais.addTrack(voie2_id);
+ *   PathSetMap itineraires;
+ *   BatchSearch recherche;
+ *   recherche.pathsToAll(voie23, quais, FORWARD_DIRECTION, itineraires);
+ *   PathSet * versVoie1 = itineraires.pathsFor(voie1_id);
+ */
+#ifndef __BATCHSEARCH_H__
+#define __BATCHSEARCH_H__
+
+#include "PathSearch.h"
+
+/*
+ * PathSets indexed by track identifier, one per track of a TrackSet
+ */
+class PathSetMap
+{
+  private:
+    uint16_t mCount;
+    uint16_t *mKeys;    /* Identifiers in increasing order */
+    PathSet *mPaths;
+
+  public:
+    PathSetMap();
+    ~PathSetMap();
+    /* Make an empty PathSet for each track of inKeys */
+    void setKeys(TrackSet & inKeys);
+    uint16_t count() const { return mCount; }
+    uint16_t keyAt(const uint16_t inIndex) const { return mKeys[inIndex]; }
+    PathSet & pathsAt(const uint16_t inIndex) { return mPaths[inIndex]; }
+    /* PathSet of a track or NULL if the track is not a key */
+    PathSet * pathsFor(const uint16_t inId);
+};
+
+class BatchSearch : public PathSearch
+{
+  private:
+    PathSetMap * mMap;
+    PathSet * mOriginPaths; /* Routes of the origin searched alone        */
+    bool mFromOrigins;      /* Searching from the target to the origins   */
+
+  protected:
+    virtual void pathFound(const TrackSet & inPath);
+
+  public:
+    BatchSearch();
+    /*
+     * Routes from inFrom to each track of inTargets, travelling in inDir,
+     * stored in outPaths by target. Return false if the net is not ok.
+     */
+    bool pathsToAll(Track & inFrom, TrackSet & inTargets, const Direction inDir, PathSetMap & outPaths);
+    /*
+     * Routes from each track of inOrigins to track inId, travelling in
+     * inDir, stored in outPaths by origin.
+     */
+    bool pathsFromAll(TrackSet & inOrigins, const uint16_t inId, const Direction inDir, PathSetMap & outPaths);
+};
+
+#endif /* __BATCHSEARCH_H__ */
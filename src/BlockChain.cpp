@@ -0,0 +1,172 @@
+/*
+ * BlockChain : a run of blocks connected to each other without any
+ * branching.
+ */
+#include "BlockChain.h"
+
+BlockChain * BlockChain::sChains = NULL;
+uint16_t BlockChain::sCount = 0;
+
+/*
+ * Get the neighbour of a block which is not inFrom
+ */
+Track * BlockChain::otherSide(BlockTrack * inBlock, const Track * inFrom)
+{
+  return (inBlock->mInTrack == inFrom) ? inBlock->mOutTrack : inBlock->mInTrack;
+}
+
+/*
+ * Get the track following a block when travelling in inDir.
+ * Same rule as BlockTrack::allPathsTo
+ */
+Track * BlockChain::nextTrack(BlockTrack * inBlock, const Direction inDir)
+{
+  return (inBlock->direction() == inDir) ? inBlock->mOutTrack : inBlock->mInTrack;
+}
+
+/*---------------------------------------------------------------------------*/
+BlockChain::BlockChain(BlockTrack * inFirst, Track * inBeforeFirst) :
+  mFirst(inFirst),
+  mLast(inFirst),
+  mBeforeFirst(inBeforeFirst),
+  mAfterLast(NULL),
+  mDirection(NO_DIRECTION),
+  mMembers(),
+  mNext(NULL)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+void BlockChain::build()
+{
+  clear();
+
+  TrackSet done;
+  for (uint16_t t = 0; t < Track::count(); t++) {
+    Track & track = Track::trackForId(t);
+    if (! track.isBlock() || done.containsTrack(t)) continue;
+
+    /* Walk back to the first block of the run */
+    BlockTrack * first = (BlockTrack *)&track;
+    Track * before = first->mInTrack;
+    Track * came = first->mOutTrack;
+    uint16_t steps = 0;
+    while (before->isBlock() && steps < Track::count()) {
+      came = first;
+      first = (BlockTrack *)before;
+      before = otherSide(first, came);
+      steps++;
+    }
+    if (steps >= Track::count()) {
+      /* Closed loop of blocks, no end to enter by */
+      done.addTrack(t);
+      continue;
+    }
+
+    /* Walk forward to collect the blocks */
+    BlockChain * chain = new BlockChain(first, before);
+    chain->mMembers.addTrack(first);
+    Track * after = otherSide(first, before);
+    while (after->isBlock()) {
+      came = chain->mLast;
+      chain->mLast = (BlockTrack *)after;
+      chain->mMembers.addTrack(after);
+      after = otherSide(chain->mLast, came);
+    }
+    chain->mAfterLast = after;
+    done.addTrackSet(chain->mMembers);
+
+    if (chain->mFirst == chain->mLast) {
+      /* A lone block gains nothing */
+      delete chain;
+      continue;
+    }
+
+    /*
+     * Check the chain is crossed from end to end by the search.
+     * It is not the case if a direction conflict occured
+     */
+    Direction dir = (nextTrack(first, FORWARD_DIRECTION) == before) ?
+      BACKWARD_DIRECTION : FORWARD_DIRECTION;
+    came = before;
+    Track * current = first;
+    while (current->isBlock()) {
+      Track * next = nextTrack((BlockTrack *)current, dir);
+      if (next != otherSide((BlockTrack *)current, came)) break;
+      came = current;
+      current = next;
+    }
+    if (current != after) {
+      delete chain;
+      continue;
+    }
+
+    chain->mDirection = dir;
+    for (uint16_t b = 0; b < Track::count(); b++) {
+      if (chain->mMembers.containsTrack(b)) {
+        ((BlockTrack &)Track::trackForId(b)).mChain = chain;
+      }
+    }
+    chain->mNext = sChains;
+    sChains = chain;
+    sCount++;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+void BlockChain::clear()
+{
+  while (sChains != NULL) {
+    BlockChain * chain = sChains;
+    sChains = chain->mNext;
+    for (uint16_t b = 0; b < Track::count(); b++) {
+      if (chain->mMembers.containsTrack(b)) {
+        ((BlockTrack &)Track::trackForId(b)).mChain = NULL;
+      }
+    }
+    delete chain;
+  }
+  sCount = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+BlockTrack * BlockChain::farEnd(
+  const BlockTrack * inEntry,
+  const Direction inDir) const
+{
+  if (inEntry == mFirst && inDir == mDirection) return mLast;
+  if (inEntry == mLast && inDir != mDirection) return mFirst;
+  return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+Track * BlockChain::exitFrom(const BlockTrack * inEntry) const
+{
+  return (inEntry == mFirst) ? mAfterLast : mBeforeFirst;
+}
+
+#ifdef DEBUG
+void BlockChain::print()
+{
+  mFirst->print();
+  Serial.print(F(" -> "));
+  mLast->print();
+  Serial.print(F(" : "));
+  mMembers.print();
+}
+
+void BlockChain::println()
+{
+  print();
+  Serial.println();
+}
+
+void BlockChain::printAll()
+{
+  BlockChain * chain = sChains;
+  while (chain != NULL) {
+    chain->println();
+    chain = chain->mNext;
+  }
+}
+#endif
@@ -0,0 +1,56 @@
+/*
+ * BlockChain : a run of blocks connected to each other without any
+ * branching, like a main line cut in several blocks.
+ * Chains are built by Track::finalize(). A search entering a chain
+ * by one of its ends crosses it in a single step and adds all the
+ * blocks of the chain to the paths at once.
+ */
+#ifndef __BLOCKCHAIN_H__
+#define __BLOCKCHAIN_H__
+
+#include "TrackSet.h"
+
+class BlockChain
+{
+  private:
+    BlockTrack * mFirst;    /* Block at one end of the chain            */
+    BlockTrack * mLast;     /* Block at the other end                   */
+    Track * mBeforeFirst;   /* Track connected to mFirst out the chain  */
+    Track * mAfterLast;     /* Track connected to mLast out the chain   */
+    Direction mDirection;   /* Travel direction from mFirst to mLast    */
+    TrackSet mMembers;      /* Blocks of the chain                      */
+    BlockChain * mNext;     /* To chain                                 */
+
+    static BlockChain * sChains; /* List of the chains */
+    static uint16_t sCount;      /* Number of chains   */
+
+    BlockChain(BlockTrack * inFirst, Track * inBeforeFirst);
+    static Track * otherSide(BlockTrack * inBlock, const Track * inFrom);
+    static Track * nextTrack(BlockTrack * inBlock, const Direction inDir);
+
+  public:
+    /* Build the chains of the track net */
+    static void build();
+    /* Destroy the chains */
+    static void clear();
+    static uint16_t count() { return sCount; }
+
+    /*
+     * Get the block at the opposite end when entering the chain by
+     * inEntry and travelling in inDir. NULL if the chain is not crossed
+     * from end to end.
+     */
+    BlockTrack * farEnd(const BlockTrack * inEntry, const Direction inDir) const;
+    /* Get the track out of the chain beyond the far end */
+    Track * exitFrom(const BlockTrack * inEntry) const;
+    bool containsTrack(const uint16_t inId) { return mMembers.containsTrack(inId); }
+    const TrackSet & members() const { return mMembers; }
+
+#ifdef DEBUG
+    void print();
+    void println();
+    static void printAll();
+#endif
+};
+
+#endif /* __BLOCKCHAIN_H__ */
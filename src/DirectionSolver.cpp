@@ -0,0 +1,152 @@
+/*
+ * DirectionSolver : orientation of the tracks so that the directions of
+ * connected tracks agree, and reversing joints where they cannot.
+ */
+#include "DirectionSolver.h"
+
+uint8_t *DirectionSolver::sAtJoint = NULL;
+JointEnd *DirectionSolver::sEnds = NULL;
+uint16_t DirectionSolver::sJointCount = 0;
+uint16_t DirectionSolver::sChangedCount = 0;
+
+/*
+ * Exits of a track on each side, in the order of nextTracks()
+ */
+static const uint8_t sOutletOrder[] = { LEFT_OUTLET, OUTLET, RIGHT_OUTLET };
+static const uint8_t sInletOrder[] = { LEFT_INLET, INLET, RIGHT_INLET };
+
+static Direction opposite(const Direction inDir)
+{
+  return (inDir == FORWARD_DIRECTION) ? BACKWARD_DIRECTION : FORWARD_DIRECTION;
+}
+
+/*---------------------------------------------------------------------------*/
+void DirectionSolver::clear()
+{
+  if (sAtJoint != NULL) free(sAtJoint);
+  if (sEnds != NULL) free(sEnds);
+  sAtJoint = NULL;
+  sEnds = NULL;
+  sJointCount = 0;
+  sChangedCount = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+bool DirectionSolver::addJoint(
+  Track & inTrack,
+  const uint8_t inConnector,
+  Track & inOther,
+  const uint8_t inBack)
+{
+  if (sAtJoint == NULL) {
+    const uint16_t bytes = (Track::tableSize() >> 3) + 1;
+    sAtJoint = (uint8_t *)malloc(bytes);
+    if (sAtJoint == NULL) return false;
+    memset(sAtJoint, 0, bytes);
+  }
+  JointEnd *ends = (JointEnd *)realloc(sEnds, (sJointCount + 1) * 2 * sizeof(JointEnd));
+  if (ends == NULL) return false;
+  sEnds = ends;
+  sEnds[sJointCount * 2].track = inTrack.identifier();
+  sEnds[sJointCount * 2].connector = inConnector;
+  sEnds[sJointCount * 2 + 1].track = inOther.identifier();
+  sEnds[sJointCount * 2 + 1].connector = inBack;
+  sJointCount++;
+  sAtJoint[inTrack.identifier() >> 3] |= 1 << (inTrack.identifier() & 7);
+  sAtJoint[inOther.identifier() >> 3] |= 1 << (inOther.identifier() & 7);
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+bool DirectionSolver::solve()
+{
+  clear();
+  const uint16_t size = Track::tableSize();
+  if (size == 0) return true;
+
+  const uint16_t bytes = (size >> 3) + 1;
+  uint16_t *queue = (uint16_t *)malloc(size * sizeof(uint16_t));
+  uint8_t *colored = (uint8_t *)malloc(bytes);
+  if (queue == NULL || colored == NULL) {
+    if (queue != NULL) free(queue);
+    if (colored != NULL) free(colored);
+    return false;
+  }
+  memset(colored, 0, bytes);
+
+  /* A joint that cannot be kept makes the net wrong, it is still oriented */
+  bool ok = true;
+  for (uint16_t root = 0; root < size; root++) {
+    Track * track = Track::findTrack(root);
+    if (track == NULL || (colored[root >> 3] & (1 << (root & 7)))) continue;
+    /* The lowest track of the part keeps its direction */
+    if (track->mDirection == NO_DIRECTION) track->mDirection = FORWARD_DIRECTION;
+    colored[root >> 3] |= 1 << (root & 7);
+    uint16_t head = 0;
+    uint16_t tail = 0;
+    queue[tail++] = root;
+
+    while (head < tail) {
+      Track & current = *Track::findTrack(queue[head++]);
+      for (uint8_t c = 0; c < CONNECTOR_COUNT; c++) {
+        Track * other = current.connectedTrack((Connector)c);
+        if (other == NULL) continue;
+        /* A connection not made back is an error of LayoutReport */
+        const int8_t back = other->connectorBack(current, (Connector)c);
+        if (back < 0) continue;
+        const Direction wanted = (isInlet(c) != isInlet(back)) ?
+          current.direction() : opposite(current.direction());
+        const uint16_t id = other->identifier();
+        if ((colored[id >> 3] & (1 << (id & 7))) == 0) {
+          colored[id >> 3] |= 1 << (id & 7);
+          if (other->mDirection != wanted) {
+            if (other->mDirection != NO_DIRECTION) sChangedCount++;
+            other->mDirection = wanted;
+          }
+          queue[tail++] = id;
+        }
+        else if (other->direction() != wanted &&
+                 (id > current.identifier() || (other == &current && back > c))) {
+          /* Odd cycle, seen from both ends, kept once */
+          if (! addJoint(current, c, *other, back)) ok = false;
+        }
+      }
+    }
+  }
+  free(queue);
+  free(colored);
+  return ok;
+}
+
+/*---------------------------------------------------------------------------*/
+bool DirectionSolver::isJoint(const Track & inTrack, const uint8_t inConnector)
+{
+  for (uint16_t e = 0; e < (sJointCount << 1); e++) {
+    if (sEnds[e].track == inTrack.identifier() && sEnds[e].connector == inConnector) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*---------------------------------------------------------------------------*/
+Direction DirectionSolver::acrossJoint(
+  Track & inFrom,
+  const Direction inDir,
+  Track ** inNext,
+  const uint8_t inIndex)
+{
+  Track * to = inNext[inIndex];
+  /* Exits of inFrom to the same track before this one */
+  uint8_t rank = 0;
+  for (uint8_t i = 0; i < inIndex; i++) {
+    if (inNext[i] == to) rank++;
+  }
+  const uint8_t * exits = (inFrom.direction() == inDir) ? sOutletOrder : sInletOrder;
+  for (uint8_t i = 0; i < 3; i++) {
+    if (inFrom.connectedTrack((Connector)exits[i]) != to) continue;
+    if (rank == 0) return isJoint(inFrom, exits[i]) ? opposite(inDir) : inDir;
+    rank--;
+  }
+  return inDir;
+}
@@ -0,0 +1,89 @@
+/*
+ * DirectionSolver : orientation of the tracks so that the directions of
+ * connected tracks agree, and reversing joints where they cannot.
+ *
+ * connect() sets the direction of a track by its first connection, so a
+ * track may disagree with a neighbour connected later. The forward
+ * direction of a track goes from its inlets to its outlets: 2 tracks
+ * connected by an inlet and an outlet must have the same direction, 2
+ * tracks connected by 2 inlets or by 2 outlets opposite directions.
+ *
+ * solve() is called by Track::finalize(). It colors the tracks with the
+ * 2 directions by a breadth first walk of each part of the net, in a
+ * time linear in the number of tracks. The lowest track of a part keeps
+ * the direction given by connect(), so a net that agrees is left as it
+ * is. A connection that cannot agree closes a cycle of odd parity, a
+ * reversing loop or a wye: it is kept as a reversing joint. A train
+ * crossing a joint goes on the other way of the net, so the direction
+ * of a search is swapped.
+ *
+ * PathSearch, BatchSearch, ReversingSearch and ReachabilityIndex swap
+ * it with directionAfter(), a bit test when the track left is at no
+ * joint. Track::pathsTo() runs a PathSearch instead of the recursive
+ * search when the net has joints. The joints take n / 8 bytes and 6
+ * bytes each, nothing when there is none.
+ *
+ *   Track::finalize();
+ *   if (DirectionSolver::jointCount() > 0) ... there is a reversing loop
+ */
+#ifndef __DIRECTIONSOLVER_H__
+#define __DIRECTIONSOLVER_H__
+
+#include "Track.h"
+
+/*
+ * End of a reversing joint. A joint is kept by its 2 ends
+ */
+typedef struct {
+  uint16_t track;
+  uint8_t connector;
+} JointEnd;
+
+class DirectionSolver
+{
+  private:
+    static uint8_t *sAtJoint;     /* Bit vector of the tracks at a joint */
+    static JointEnd *sEnds;       /* 2 ends per joint                    */
+    static uint16_t sJointCount;
+    static uint16_t sChangedCount;
+
+    /* Keep a joint. False if out of memory */
+    static bool addJoint(Track & inTrack, const uint8_t inConnector,
+                         Track & inOther, const uint8_t inBack);
+    static Direction acrossJoint(Track & inFrom, const Direction inDir,
+                                 Track ** inNext, const uint8_t inIndex);
+
+  public:
+    /* Orient the tracks and find the joints. False if out of memory */
+    static bool solve();
+    static void clear();
+
+    static uint16_t jointCount() { return sJointCount; }
+    /* End of the joints, 2 per joint, the lower track first */
+    static const JointEnd & jointEnd(const uint16_t inIndex) { return sEnds[inIndex]; }
+    /* Tracks whose direction given by connect() was changed */
+    static uint16_t changedCount() { return sChangedCount; }
+    /* Whether connector inConnector of inTrack is a joint end */
+    static bool isJoint(const Track & inTrack, const uint8_t inConnector);
+
+    static bool isInlet(const uint8_t inConnector)
+    {
+      return inConnector == INLET || inConnector == LEFT_INLET || inConnector == RIGHT_INLET;
+    }
+
+    /*
+     * Direction of a search on inNext[inIndex], given by
+     * inFrom->nextTracks(inDir, ...). When inFrom reaches a track by
+     * several exits, they are taken left, straight, right, the order of
+     * nextTracks().
+     */
+    static Direction directionAfter(Track & inFrom, const Direction inDir,
+                                    Track ** inNext, const uint8_t inIndex)
+    {
+      const uint16_t id = inFrom.identifier();
+      if (sAtJoint == NULL || (sAtJoint[id >> 3] & (1 << (id & 7))) == 0) return inDir;
+      return acrossJoint(inFrom, inDir, inNext, inIndex);
+    }
+};
+
+#endif /* __DIRECTIONSOLVER_H__ */
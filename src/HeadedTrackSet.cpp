@@ -1,19 +1,33 @@
 /*
  *  Ensemble de voies orientées.
- *  L'ensemble est un vecteur de bits indexé par l'identifiant
+ *  L'ensemble est un vecteur d'estampilles indexé par l'identifiant
  *  des voies * 2 + l'orientation : 0 sens avant, 1 sens arriere.
- *  Chaque bit indique l'appartenance d'une voie à l'ensemble
- *  - 1 la Voie appartient à l'ensemble
- *  - 0 elle n'appartient pas à l'ensemble.
+ *  Une voie orientée appartient à l'ensemble quand son estampille est
+ *  l'époque de l'ensemble. Vider l'ensemble revient à passer à l'époque
+ *  suivante.
  */
 #include "HeadedTrackSet.h"
+#include "Profile.h"
+#include "HeapStats.h"
+
+HeadedTrackSet *HeadedTrackSet::sPool[HEADED_TRACK_SET_POOL_SIZE];
+uint8_t HeadedTrackSet::sPoolCount = 0;
 
 void HeadedTrackSet::allocate()
 {
-  mSet = new byte[2 * Track::sizeForSet()];
+  mSize = 2 * Track::count();
+  {
+    PROFILE_SCOPE(PROFILE_ALLOCATION);
+    mSet = new byte[mSize];
+  }
+  HEAP_ALLOCATED(HEAP_MARKING, mSize);
+  for (uint16_t i = 0; i < mSize; i++) {
+    mSet[i] = 0;
+  }
+  mEpoch = 1;
 #ifdef TRACE2
   Serial.print(F("*** HeadedTrackSet : allocate "));
-  Serial.print(2 * Track::sizeForSet());
+  Serial.print(mSize);
   Serial.println(F(" bytes"));
 #endif
 }
@@ -21,71 +35,65 @@ void HeadedTrackSet::allocate()
 HeadedTrackSet::HeadedTrackSet()
 {
   allocate();
-  clear();
 }
 
 HeadedTrackSet::HeadedTrackSet(
   const HeadedTrackSet & inSet)
 {
-//  Serial.println("  Constructeur par recopie");
-//  delay(1000);
   allocate();
   operator=(inSet);
 }
 
 HeadedTrackSet::~HeadedTrackSet()
 {
-//  Serial.println("  destruction d'un ensemble de voies");
-//  delay(1000);
-  delete mSet;
-//  Serial.println("  destruction terminee");
-//  delay(1000);
+  HEAP_FREED(HEAP_MARKING, mSize);
+  delete [] mSet;
 }
 
 void HeadedTrackSet::clear()
 {
-  for (uint8_t i = 0; i < (2 * Track::sizeForSet()); i++) {
-    mSet[i] = 0;
+  /* Stamps of the previous epochs are not in the set any longer */
+  mEpoch++;
+  if (mEpoch == 0) {
+    for (uint16_t i = 0; i < mSize; i++) {
+      mSet[i] = 0;
+    }
+    mEpoch = 1;
   }
 }
 
 bool HeadedTrackSet::isEmpty()
 {
-  for (uint8_t i = 0; i < 2 * Track::sizeForSet(); i++) {
-    if (mSet[i] != 0) return false;
+  for (uint16_t i = 0; i < mSize; i++) {
+    if (mSet[i] == mEpoch) return false;
   }
   return true;
 }
 
-void HeadedTrackSet::addTrack(uint8_t inId, uint8_t inDir)
+void HeadedTrackSet::addTrack(uint16_t inId, uint8_t inDir)
 {
-  mSet[(inId >> 2)] |=
-    1 << (((inId & 3) << 1) + inDir );
+  mSet[(inId << 1) + inDir] = mEpoch;
 #ifdef TRACE2
-  Serial.print(F("*** HeadedTrackSet : add, byte "));
-  Serial.print(inId >> 2);
-  Serial.print(F(" bit "));
-  Serial.println(((inId & 3) << 1) + inDir);
+  Serial.print(F("*** HeadedTrackSet : add, stamp "));
+  Serial.println((inId << 1) + inDir);
 #endif
 }
 
-void HeadedTrackSet::removeTrack(uint8_t inId, uint8_t inDir)
+void HeadedTrackSet::removeTrack(uint16_t inId, uint8_t inDir)
 {
-  mSet[(inId >> 2)] &=
-    ~(1 << (((inId & 3) << 1) + inDir ));
+  mSet[(inId << 1) + inDir] = 0;
 }
 
-bool HeadedTrackSet::containsTrack(uint8_t inId, uint8_t inDir)
+bool HeadedTrackSet::containsTrack(uint16_t inId, uint8_t inDir)
 {
-  return (mSet[(inId >> 2)] &
-    1 << (((inId & 3) << 1) + inDir )) != 0;
+  return mSet[(inId << 1) + inDir] == mEpoch;
 }
 
 HeadedTrackSet & HeadedTrackSet::operator=(
   const HeadedTrackSet & inSet)
 {
-  for (uint8_t i = 0; i < 2 * Track::sizeForSet(); i++) {
-    mSet[i] = inSet.mSet[i];
+  for (uint16_t i = 0; i < mSize; i++) {
+    mSet[i] = (inSet.mSet[i] == inSet.mEpoch) ? mEpoch : 0;
   }
   return *this;
 }
@@ -93,35 +101,45 @@ HeadedTrackSet & HeadedTrackSet::operator=(
 bool HeadedTrackSet::operator==(HeadedTrackSet & inSet)
 {
   bool result = true;
-  for (byte i = 0; i < 2 * Track::sizeForSet(); i++) {
-    result = result && (mSet[i] == inSet.mSet[i]);
+  for (uint16_t i = 0; i < mSize; i++) {
+    result = result && ((mSet[i] == mEpoch) == (inSet.mSet[i] == inSet.mEpoch));
   }
   return result;
 }
 
+HeadedTrackSet * HeadedTrackSet::acquire()
+{
+  HeadedTrackSet * set = NULL;
+  /* A set of the pool is dropped if the net has changed since */
+  while (set == NULL && sPoolCount > 0) {
+    set = sPool[--sPoolCount];
+    if (set->mSize != 2 * Track::count()) {
+      delete set;
+      set = NULL;
+    }
+  }
+  if (set == NULL) set = new HeadedTrackSet();
+  else set->clear();
+  return set;
+}
+
+void HeadedTrackSet::release(HeadedTrackSet * inSet)
+{
+  if (sPoolCount < HEADED_TRACK_SET_POOL_SIZE) sPool[sPoolCount++] = inSet;
+  else delete inSet;
+}
 
 #ifdef DEBUG
 void HeadedTrackSet::print()
 {
   bool emptySet = true;
-  for (uint8_t i = 0; i < 2 * Track::sizeForSet(); i++) {
-    uint8_t subVec = mSet[i];
-    for (uint8_t j = 0; j < 4; j++) {
-      uint8_t id = (i << 2) + j;
-      if (subVec & (1 << (2 * j))) {
-        emptySet = false;
-        Track::trackForId(id).print();
-        Serial.print('/');
-        displayDirection(FORWARD_DIRECTION);
-        Serial.print(' ');
-      }
-      if (subVec & (1 << ((2 * j) +1))) {
-        emptySet = false;
-        Track::trackForId(id).print();
-        Serial.print('/');
-        displayDirection(BACKWARD_DIRECTION);
-        Serial.print(' ');
-      }
+  for (uint16_t i = 0; i < mSize; i++) {
+    if (mSet[i] == mEpoch) {
+      emptySet = false;
+      Track::trackForId(i >> 1).print();
+      Serial.print('/');
+      displayDirection((Direction)(i & 1));
+      Serial.print(' ');
     }
   }
   if (emptySet) {
@@ -137,9 +155,9 @@ void HeadedTrackSet::println()
 
 void HeadedTrackSet::printraw()
 {
-  for (uint8_t i = 0; i < 2 * Track::sizeForSet(); i++) {
-    Serial.print((unsigned long)mSet[i], HEX);
-    Serial.print(' ');
+  for (uint16_t i = 0; i < mSize; i++) {
+    Serial.print(mSet[i] == mEpoch ? '1' : '0');
+    if (i & 1) Serial.print(' ');
   }
 }
 
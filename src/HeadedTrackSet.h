@@ -1,10 +1,13 @@
 /*
 * Set of oriented tracks.
-* The set is a bit vector indexed by the identifier
+* The set is a vector of epoch stamps indexed by the identifier
 * of the channels * 2 + the direction: 0 forward direction, 1 reverse direction.
-* Each bit indicates the belonging of a track to the set
-* - 1 the Way belongs to the whole
-* - 0 it does not belong to the whole.
+* An oriented track belongs to the set when its stamp is the epoch of
+* the set. Clearing the set is done by going to the next epoch, the
+* vector is only cleared when the epoch wraps around.
+*
+* The searches take their marking from a small pool with acquire() and
+* give it back with release() so that a query does not allocate.
  */
 #ifndef __HEADEDTRACKSET_H__
 #define __HEADEDTRACKSET_H__
@@ -12,9 +15,23 @@
 #include "HardwareSerial.h"
 #include "Track.h"
 
+/*
+ * Number of sets kept by the pool. More sets may be acquired at once,
+ * they are then allocated and freed on release
+ */
+#ifndef HEADED_TRACK_SET_POOL_SIZE
+#define HEADED_TRACK_SET_POOL_SIZE 2
+#endif
+
 class HeadedTrackSet
 {
   private:
+    uint16_t mSize;   /* Number of stamps, 2 per track */
+    uint8_t mEpoch;
+
+    static HeadedTrackSet *sPool[HEADED_TRACK_SET_POOL_SIZE];
+    static uint8_t sPoolCount; /* Sets available in the pool */
+
     void allocate();
 
   protected:
@@ -25,18 +42,24 @@ class HeadedTrackSet
     HeadedTrackSet(const HeadedTrackSet & set);
     ~HeadedTrackSet();
     void clear();
-    void addTrack(uint8_t inId, uint8_t inDir);
+    void addTrack(uint16_t inId, uint8_t inDir);
     void addTrack(Track & inTrack, uint8_t inDir) { addTrack(inTrack.identifier(), inDir);  }
     void addTrack(Track * inTrack, uint8_t inDir) { addTrack(inTrack->identifier(), inDir); }
-    void removeTrack(uint8_t inId, uint8_t inDir);
+    void removeTrack(uint16_t inId, uint8_t inDir);
     void removeTrack(Track & inTrack, uint8_t inDir) { removeTrack(inTrack.identifier(), inDir);  }
     void removeTrack(Track * inTrack, uint8_t inDir) { removeTrack(inTrack->identifier(), inDir); }
-    bool containsTrack(uint8_t inId, uint8_t inDir);
+    bool containsTrack(uint16_t inId, uint8_t inDir);
     bool isEmpty();
     bool containsTrack(Track * inTrack, uint8_t inDir) { return containsTrack(inTrack->identifier(), inDir); }
     bool containsTrack(Track & inTrack, uint8_t inDir) { return containsTrack(inTrack.identifier(), inDir);  }
     HeadedTrackSet &operator=(const HeadedTrackSet & inSet);
     bool operator==(HeadedTrackSet & inSet);
+
+    /* Get an empty set from the pool */
+    static HeadedTrackSet * acquire();
+    /* Give a set back to the pool */
+    static void release(HeadedTrackSet * inSet);
+
 #ifdef DEBUG
     void print();
     void println();
@@ -45,4 +68,23 @@ class HeadedTrackSet
 #endif
 };
 
+/*
+ * Set of the pool, given back when going out of scope
+ */
+class PooledHeadedTrackSet
+{
+  private:
+    HeadedTrackSet * mSet;
+
+    /* Not copied, the set would be given back twice */
+    PooledHeadedTrackSet(const PooledHeadedTrackSet &);
+    PooledHeadedTrackSet & operator=(const PooledHeadedTrackSet &);
+
+  public:
+    PooledHeadedTrackSet() : mSet(HeadedTrackSet::acquire()) {}
+    ~PooledHeadedTrackSet() { HeadedTrackSet::release(mSet); }
+    HeadedTrackSet & operator*() { return *mSet; }
+    HeadedTrackSet * operator->() { return mSet; }
+};
+
 #endif
@@ -0,0 +1,189 @@
+/*
+ * HeapStats : use of the heap by SwitchMan.
+ */
+#include "HeapStats.h"
+
+#ifdef SWITCHMAN_HEAP_STATS
+
+#include "HardwareSerial.h"
+
+#ifdef __AVR__
+
+/*
+ * Heap of avr-libc: the heap grows from __malloc_heap_start to __brkval,
+ * the blocks freed below __brkval are chained in __flp.
+ */
+struct __freelist {
+  size_t sz;
+  struct __freelist *nx;
+};
+
+extern char *__malloc_heap_start;
+extern char *__brkval;
+extern struct __freelist *__flp;
+
+static uint32_t heapTop()
+{
+  return (__brkval == NULL) ? 0 : (uint32_t)(__brkval - __malloc_heap_start);
+}
+
+void heapPlatformInfo(HeapInfo & outInfo)
+{
+  char stackTop;
+  char *heapEnd = (__brkval == NULL) ? __malloc_heap_start : __brkval;
+  uint32_t gap = (&stackTop > heapEnd) ? (uint32_t)(&stackTop - heapEnd) : 0;
+  gap = (gap > __malloc_margin) ? gap - __malloc_margin : 0;
+
+  uint32_t listFree = 0;
+  uint32_t largest = gap;
+  for (struct __freelist *block = __flp; block != NULL; block = block->nx) {
+    listFree += block->sz;
+    if (block->sz > largest) largest = block->sz;
+  }
+  outInfo.heapSize = heapTop();
+  outInfo.heapHighWater = 0;
+  outInfo.freeBytes = listFree + gap;
+  outInfo.largestFreeBlock = largest;
+}
+
+#else
+
+static uint32_t heapTop()
+{
+  return 0; /* Read by snapshot() only, mallinfo is not cheap */
+}
+
+#endif /* __AVR__ */
+
+uint32_t HeapStats::sAllocations[HEAP_SUBSYSTEM_COUNT];
+uint32_t HeapStats::sFrees[HEAP_SUBSYSTEM_COUNT];
+uint32_t HeapStats::sBytes[HEAP_SUBSYSTEM_COUNT];
+uint32_t HeapStats::sInUse = 0;
+uint32_t HeapStats::sHighWater = 0;
+uint32_t HeapStats::sQueryStart = 0;
+uint32_t HeapStats::sQueryHigh = 0;
+uint32_t HeapStats::sLastQueryPeak = 0;
+uint32_t HeapStats::sQueryPeak = 0;
+uint32_t HeapStats::sPlatformHighWater = 0;
+uint8_t HeapStats::sQueryDepth = 0;
+
+/*---------------------------------------------------------------------------*/
+void HeapStats::allocated(const uint8_t inSubsystem, const uint32_t inBytes)
+{
+  sAllocations[inSubsystem]++;
+  sBytes[inSubsystem] += inBytes;
+  sInUse += inBytes;
+  if (sInUse > sHighWater) sHighWater = sInUse;
+  if (sInUse > sQueryHigh) sQueryHigh = sInUse;
+  const uint32_t top = heapTop();
+  if (top > sPlatformHighWater) sPlatformHighWater = top;
+}
+
+/*---------------------------------------------------------------------------*/
+void HeapStats::freed(const uint8_t inSubsystem, const uint32_t inBytes)
+{
+  sFrees[inSubsystem]++;
+  /* A set allocated before a change of the net may be freed bigger */
+  sBytes[inSubsystem] -= (inBytes < sBytes[inSubsystem]) ? inBytes : sBytes[inSubsystem];
+  sInUse -= (inBytes < sInUse) ? inBytes : sInUse;
+}
+
+/*---------------------------------------------------------------------------*/
+void HeapStats::queryBegin()
+{
+  /* A query run by another one is part of it */
+  if (sQueryDepth++ == 0) {
+    sQueryStart = sInUse;
+    sQueryHigh = sInUse;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+void HeapStats::queryEnd()
+{
+  if (sQueryDepth == 0 || --sQueryDepth > 0) return;
+  sLastQueryPeak = sQueryHigh - sQueryStart;
+  if (sLastQueryPeak > sQueryPeak) sQueryPeak = sLastQueryPeak;
+}
+
+/*---------------------------------------------------------------------------*/
+void HeapStats::snapshot(HeapSnapshot & outSnapshot)
+{
+  heapPlatformInfo(outSnapshot.platform);
+  if (outSnapshot.platform.heapSize > sPlatformHighWater) {
+    sPlatformHighWater = outSnapshot.platform.heapSize;
+  }
+  outSnapshot.platform.heapHighWater = sPlatformHighWater;
+  outSnapshot.inUse = sInUse;
+  outSnapshot.highWater = sHighWater;
+  outSnapshot.lastQueryPeak = sLastQueryPeak;
+  outSnapshot.queryPeak = sQueryPeak;
+  for (uint8_t s = 0; s < HEAP_SUBSYSTEM_COUNT; s++) {
+    outSnapshot.allocations[s] = sAllocations[s];
+    outSnapshot.frees[s] = sFrees[s];
+    outSnapshot.bytes[s] = sBytes[s];
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+void HeapStats::reset()
+{
+  for (uint8_t s = 0; s < HEAP_SUBSYSTEM_COUNT; s++) {
+    sAllocations[s] = 0;
+    sFrees[s] = 0;
+  }
+  sHighWater = sInUse;
+  sLastQueryPeak = 0;
+  sQueryPeak = 0;
+  sPlatformHighWater = heapTop();
+}
+
+/*---------------------------------------------------------------------------*/
+static void printSubsystemName(const uint8_t inSubsystem)
+{
+  switch (inSubsystem) {
+    case HEAP_PATHS:   Serial.print(F("paths"));   break;
+    case HEAP_SETS:    Serial.print(F("sets"));    break;
+    case HEAP_MARKING: Serial.print(F("marking")); break;
+    case HEAP_SEARCH:  Serial.print(F("search"));  break;
+    case HEAP_INDEX:   Serial.print(F("index"));   break;
+    case HEAP_CACHE:   Serial.print(F("cache"));   break;
+  }
+}
+
+static void printValue(const uint32_t inValue)
+{
+  Serial.print(',');
+  Serial.print((unsigned long)inValue);
+}
+
+/*---------------------------------------------------------------------------*/
+void HeapStats::dump()
+{
+  HeapSnapshot state;
+  snapshot(state);
+  Serial.println(F("heap,size,high_water,free,largest_free_block"));
+  Serial.print(F("platform"));
+  printValue(state.platform.heapSize);
+  printValue(state.platform.heapHighWater);
+  printValue(state.platform.freeBytes);
+  printValue(state.platform.largestFreeBlock);
+  Serial.println();
+  Serial.println(F("heap,in_use,high_water,last_query_peak,query_peak"));
+  Serial.print(F("switchman"));
+  printValue(state.inUse);
+  printValue(state.highWater);
+  printValue(state.lastQueryPeak);
+  printValue(state.queryPeak);
+  Serial.println();
+  Serial.println(F("subsystem,allocations,frees,bytes"));
+  for (uint8_t s = 0; s < HEAP_SUBSYSTEM_COUNT; s++) {
+    printSubsystemName(s);
+    printValue(state.allocations[s]);
+    printValue(state.frees[s]);
+    printValue(state.bytes[s]);
+    Serial.println();
+  }
+}
+
+#endif /* SWITCHMAN_HEAP_STATS */
@@ -0,0 +1,127 @@
+/*
+ * HeapStats : use of the heap by SwitchMan, for the boards running for
+ * days where fragmentation may end up making an allocation fail.
+ *
+ * The statistics are built when SWITCHMAN_HEAP_STATS is defined in the
+ * build flags, the hooks are empty otherwise. For each subsystem they
+ * count the allocations, the frees and the bytes in use. They also keep
+ * the high-water mark of the bytes in use, the peak reached during the
+ * last query and the highest peak of a query, the bytes in use at the
+ * start of the query apart.
+ *
+ * The heap of the platform is read by snapshot():
+ * - on AVR, from the malloc free list and the gap between the heap and
+ *   the stack. The high-water mark of the heap is sampled at each
+ *   allocation of SwitchMan;
+ * - on the host, from mallinfo of the GNU C library, given by the unix
+ *   emulation (unix/HeapInfo.cpp). The largest free block is then the
+ *   top of the heap, the only one known.
+ *
+ *   HeapSnapshot etat;
+ *   HeapStats::snapshot(etat);
+ *   HeapStats::dump();
+ */
+#ifndef __HEAPSTATS_H__
+#define __HEAPSTATS_H__
+
+#include "Arduino.h"
+
+typedef enum {
+  HEAP_PATHS,      /* Paths of the PathSets                              */
+  HEAP_SETS,       /* TrackSets                                          */
+  HEAP_MARKING,    /* HeadedTrackSets marking the tracks visited         */
+  HEAP_SEARCH,     /* Stacks of the searches and PathSetMaps             */
+  HEAP_INDEX,      /* Tables kept by the ReachabilityIndex               */
+  HEAP_CACHE,      /* Routes kept by RouteCache                          */
+  HEAP_SUBSYSTEM_COUNT
+} HeapSubsystem;
+
+/*
+ * Heap of the platform, 0 when not known
+ */
+typedef struct {
+  uint32_t heapSize;         /* Bytes taken from the memory by the heap */
+  uint32_t heapHighWater;    /* Highest heapSize seen                   */
+  uint32_t freeBytes;        /* Free in the heap and, on AVR, before    */
+                             /* the stack                               */
+  uint32_t largestFreeBlock; /* Largest allocation possible             */
+} HeapInfo;
+
+typedef struct {
+  HeapInfo platform;
+  uint32_t inUse;            /* Bytes allocated by SwitchMan            */
+  uint32_t highWater;        /* Highest inUse                           */
+  uint32_t lastQueryPeak;    /* Bytes allocated during the last query   */
+  uint32_t queryPeak;        /* Highest lastQueryPeak                   */
+  uint32_t allocations[HEAP_SUBSYSTEM_COUNT];
+  uint32_t frees[HEAP_SUBSYSTEM_COUNT];
+  uint32_t bytes[HEAP_SUBSYSTEM_COUNT];
+} HeapSnapshot;
+
+/*
+ * Heap of the platform, given by the platform
+ */
+void heapPlatformInfo(HeapInfo & outInfo);
+
+#ifdef SWITCHMAN_HEAP_STATS
+
+class HeapStats
+{
+  private:
+    static uint32_t sAllocations[HEAP_SUBSYSTEM_COUNT];
+    static uint32_t sFrees[HEAP_SUBSYSTEM_COUNT];
+    static uint32_t sBytes[HEAP_SUBSYSTEM_COUNT];
+    static uint32_t sInUse;
+    static uint32_t sHighWater;
+    static uint32_t sQueryStart;    /* inUse when the query started */
+    static uint32_t sQueryHigh;     /* Highest inUse of the query   */
+    static uint32_t sLastQueryPeak;
+    static uint32_t sQueryPeak;
+    static uint32_t sPlatformHighWater;
+    static uint8_t sQueryDepth;
+
+  public:
+    static void allocated(const uint8_t inSubsystem, const uint32_t inBytes);
+    static void freed(const uint8_t inSubsystem, const uint32_t inBytes);
+    static void queryBegin();
+    static void queryEnd();
+
+    static uint32_t allocations(const uint8_t inSubsystem) { return sAllocations[inSubsystem]; }
+    static uint32_t frees(const uint8_t inSubsystem) { return sFrees[inSubsystem]; }
+    static uint32_t bytes(const uint8_t inSubsystem) { return sBytes[inSubsystem]; }
+    static uint32_t inUse() { return sInUse; }
+    static uint32_t highWater() { return sHighWater; }
+    static uint32_t lastQueryPeak() { return sLastQueryPeak; }
+    static uint32_t queryPeak() { return sQueryPeak; }
+
+    /* Statistics and heap of the platform */
+    static void snapshot(HeapSnapshot & outSnapshot);
+    /* Clear the counts and restart the high-water marks from now */
+    static void reset();
+    /* Print a snapshot as CSV on Serial */
+    static void dump();
+};
+
+/*
+ * Query measured from its declaration to the end of the block
+ */
+class HeapQueryScope
+{
+  public:
+    HeapQueryScope() { HeapStats::queryBegin(); }
+    ~HeapQueryScope() { HeapStats::queryEnd(); }
+};
+
+#define HEAP_ALLOCATED(subsystem, bytes) HeapStats::allocated((subsystem), (bytes))
+#define HEAP_FREED(subsystem, bytes) HeapStats::freed((subsystem), (bytes))
+#define HEAP_QUERY_SCOPE() HeapQueryScope heapQueryScope
+
+#else
+
+#define HEAP_ALLOCATED(subsystem, bytes)
+#define HEAP_FREED(subsystem, bytes)
+#define HEAP_QUERY_SCOPE()
+
+#endif /* SWITCHMAN_HEAP_STATS */
+
+#endif /* __HEAPSTATS_H__ */
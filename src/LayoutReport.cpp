@@ -0,0 +1,277 @@
+/*
+ * LayoutReport : what is wrong with the track net, found in one scan.
+ */
+#include "LayoutReport.h"
+#include "DirectionSolver.h"
+#include "HardwareSerial.h"
+
+/*
+ * Connectors of each kind of track, a bit per connector
+ */
+static const uint8_t sConnectors[] = {
+  (1 << OUTLET),                                                   /* DEADEND_TRACK    */
+  (1 << INLET) | (1 << OUTLET),                                    /* BLOCK_TRACK      */
+  (1 << INLET) | (1 << LEFT_OUTLET) | (1 << RIGHT_OUTLET),         /* TURNOUT_TRACK    */
+  (1 << INLET) | (1 << LEFT_OUTLET) | (1 << OUTLET) | (1 << RIGHT_OUTLET),
+                                                                   /* THREEWAY_TRACK   */
+  (1 << LEFT_INLET) | (1 << RIGHT_INLET) | (1 << LEFT_OUTLET) | (1 << RIGHT_OUTLET),
+                                                                   /* CROSSING_TRACK   */
+  (1 << LEFT_INLET) | (1 << RIGHT_INLET) | (1 << LEFT_OUTLET) | (1 << RIGHT_OUTLET),
+                                                                   /* DOUBLESLIP_TRACK */
+  (1 << LEFT_INLET) | (1 << RIGHT_INLET) | (1 << LEFT_OUTLET) | (1 << RIGHT_OUTLET)
+                                                                   /* SCISSORS_TRACK   */
+};
+
+/*---------------------------------------------------------------------------*/
+LayoutReport::LayoutReport() :
+  mKept(0),
+  mPartCount(0),
+  mLargestPart(0),
+  mRecordedErrors(0)
+{
+  for (uint8_t k = 0; k < LAYOUT_ISSUE_KIND_COUNT; k++) mCount[k] = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+void LayoutReport::add(
+  const uint8_t inKind,
+  const uint16_t inTrack,
+  const uint8_t inConnector,
+  const uint16_t inOther)
+{
+  mCount[inKind]++;
+  if (mKept < LAYOUT_REPORT_SIZE) {
+    LayoutIssue & issue = mIssues[mKept++];
+    issue.kind = inKind;
+    issue.connector = inConnector;
+    issue.track = inTrack;
+    issue.other = inOther;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+void LayoutReport::checkConnections(Track & inTrack)
+{
+  const uint16_t id = inTrack.identifier();
+  const uint8_t connectors = sConnectors[inTrack.kind()];
+  for (uint8_t c = 0; c < CONNECTOR_COUNT; c++) {
+    if ((connectors & (1 << c)) == 0) continue;
+    Track * other = inTrack.connectedTrack((Connector)c);
+    if (other == NULL) {
+      add(DANGLING_CONNECTOR, id, c, 0);
+      continue;
+    }
+    const int8_t back = other->connectorBack(inTrack, (Connector)c);
+    if (back < 0) {
+      add(ONE_WAY_CONNECTION, id, c, other->identifier());
+      continue;
+    }
+    /* A connection is checked once, from the track of lower identifier */
+    if (other->identifier() < id || (other == &inTrack && back < c)) continue;
+    const bool sameDirection = DirectionSolver::isInlet(c) != DirectionSolver::isInlet(back);
+    if ((inTrack.direction() == other->direction()) != sameDirection) {
+      const bool joint = DirectionSolver::isJoint(inTrack, c);
+      add(joint ? REVERSING_JOINT : DIRECTION_CONFLICT, id, c, other->identifier());
+    }
+  }
+}
+
+/*
+ * Root of the part of a track, the parents are halved on the way
+ */
+static uint16_t partOf(uint16_t * ioParent, uint16_t inId)
+{
+  while (ioParent[inId] != inId) {
+    ioParent[inId] = ioParent[ioParent[inId]];
+    inId = ioParent[inId];
+  }
+  return inId;
+}
+
+/*---------------------------------------------------------------------------*/
+void LayoutReport::findParts()
+{
+  const uint16_t size = Track::tableSize();
+  if (size == 0) return;
+  uint16_t *parent = (uint16_t *)malloc(size * sizeof(uint16_t));
+  uint16_t *tracks = (uint16_t *)malloc(size * sizeof(uint16_t));
+  if (parent == NULL || tracks == NULL) {
+    if (parent != NULL) free(parent);
+    if (tracks != NULL) free(tracks);
+    return;
+  }
+
+  for (uint16_t id = 0; id < size; id++) {
+    parent[id] = id;
+    tracks[id] = 0;
+  }
+  for (uint16_t id = 0; id < size; id++) {
+    Track * track = Track::findTrack(id);
+    if (track == NULL) continue;
+    for (uint8_t c = 0; c < CONNECTOR_COUNT; c++) {
+      Track * other = track->connectedTrack((Connector)c);
+      if (other == NULL || other->identifier() >= size) continue;
+      const uint16_t a = partOf(parent, id);
+      const uint16_t b = partOf(parent, other->identifier());
+      if (a < b) parent[b] = a;
+      else parent[a] = b;
+    }
+  }
+
+  /* Tracks of each part, counted at its root */
+  uint16_t largest = 0;
+  for (uint16_t id = 0; id < size; id++) {
+    if (Track::findTrack(id) != NULL) tracks[partOf(parent, id)]++;
+  }
+  for (uint16_t id = 0; id < size; id++) {
+    if (parent[id] == id && tracks[id] > 0) {
+      mPartCount++;
+      if (tracks[id] > tracks[largest]) largest = id;
+    }
+  }
+  mLargestPart = tracks[largest];
+
+  /* The other parts, given by their lowest track */
+  for (uint16_t id = 0; id < size; id++) {
+    if (Track::findTrack(id) == NULL) continue;
+    const uint16_t root = partOf(parent, id);
+    if (root != largest && tracks[root] > 0) {
+      add(SEPARATE_PART, id, NO_ISSUE_CONNECTOR, tracks[root]);
+      tracks[root] = 0;
+    }
+  }
+  free(parent);
+  free(tracks);
+}
+
+/*---------------------------------------------------------------------------*/
+void LayoutReport::build()
+{
+  mKept = 0;
+  for (uint8_t k = 0; k < LAYOUT_ISSUE_KIND_COUNT; k++) mCount[k] = 0;
+  mPartCount = 0;
+  mLargestPart = 0;
+  mRecordedErrors = Track::errorCount();
+
+  /* The table may be larger than the highest identifier until finalize() */
+  uint16_t end = Track::tableSize();
+  while (end > 0 && Track::findTrack(end - 1) == NULL) end--;
+
+  uint16_t found = 0;
+  for (uint16_t id = 0; id < end; id++) {
+    Track * track = Track::findTrack(id);
+    if (track == NULL) {
+      add(MISSING_TRACK, id, NO_ISSUE_CONNECTOR, 0);
+      continue;
+    }
+    found++;
+    checkConnections(*track);
+  }
+  if (Track::count() > found) {
+    add(DUPLICATE_TRACKS, 0, NO_ISSUE_CONNECTOR, Track::count() - found);
+  }
+  findParts();
+}
+
+/*---------------------------------------------------------------------------*/
+uint16_t LayoutReport::errorCount() const
+{
+  uint16_t errors = 0;
+  for (uint8_t k = 0; k < LAYOUT_ISSUE_KIND_COUNT; k++) {
+    if (k != SEPARATE_PART && k != REVERSING_JOINT) errors += mCount[k];
+  }
+  return errors;
+}
+
+/*---------------------------------------------------------------------------*/
+bool LayoutReport::isOk() const
+{
+  return errorCount() == 0;
+}
+
+/*---------------------------------------------------------------------------*/
+static void printKind(const uint8_t inKind)
+{
+  switch (inKind) {
+    case DANGLING_CONNECTOR: Serial.print(F("dangling_connector")); break;
+    case ONE_WAY_CONNECTION: Serial.print(F("one_way_connection")); break;
+    case DIRECTION_CONFLICT: Serial.print(F("direction_conflict")); break;
+    case MISSING_TRACK:      Serial.print(F("missing_track"));      break;
+    case DUPLICATE_TRACKS:   Serial.print(F("duplicate_tracks"));   break;
+    case SEPARATE_PART:      Serial.print(F("separate_part"));      break;
+    case REVERSING_JOINT:    Serial.print(F("reversing_joint"));    break;
+  }
+}
+
+static void printConnector(const uint8_t inConnector)
+{
+  switch (inConnector) {
+    case INLET:        Serial.print(F("inlet"));        break;
+    case LEFT_INLET:   Serial.print(F("left_inlet"));   break;
+    case RIGHT_INLET:  Serial.print(F("right_inlet"));  break;
+    case OUTLET:       Serial.print(F("outlet"));       break;
+    case LEFT_OUTLET:  Serial.print(F("left_outlet"));  break;
+    case RIGHT_OUTLET: Serial.print(F("right_outlet")); break;
+  }
+}
+
+static void printTrack(const uint16_t inId)
+{
+#ifdef SWITCHMAN_TRACK_NAMES
+  if (Track::findTrack(inId) != NULL) {
+    TrackNames::print(inId);
+    return;
+  }
+#endif
+  Serial.print((unsigned long)inId);
+}
+
+static void printValue(const uint32_t inValue)
+{
+  Serial.print(',');
+  Serial.print((unsigned long)inValue);
+}
+
+/*---------------------------------------------------------------------------*/
+void LayoutReport::print() const
+{
+  Serial.println(F("layout,tracks,parts,largest_part,errors,warnings,recorded_errors"));
+  Serial.print(F("layout"));
+  printValue(Track::count());
+  printValue(mPartCount);
+  printValue(mLargestPart);
+  printValue(errorCount());
+  printValue(warningCount());
+  printValue(mRecordedErrors);
+  Serial.println();
+
+  Serial.println(F("issue,count"));
+  for (uint8_t k = 0; k < LAYOUT_ISSUE_KIND_COUNT; k++) {
+    printKind(k);
+    printValue(mCount[k]);
+    Serial.println();
+  }
+
+  Serial.println(F("issue,track,connector,other"));
+  for (uint16_t i = 0; i < mKept; i++) {
+    const LayoutIssue & issue = mIssues[i];
+    printKind(issue.kind);
+    Serial.print(',');
+    if (issue.kind != DUPLICATE_TRACKS) printTrack(issue.track);
+    Serial.print(',');
+    printConnector(issue.connector);
+    Serial.print(',');
+    switch (issue.kind) {
+      case ONE_WAY_CONNECTION:
+      case DIRECTION_CONFLICT:
+      case REVERSING_JOINT:
+        printTrack(issue.other);
+        break;
+      case DUPLICATE_TRACKS:
+      case SEPARATE_PART:
+        Serial.print((unsigned long)issue.other);
+        break;
+    }
+    Serial.println();
+  }
+}
@@ -0,0 +1,104 @@
+/*
+ * LayoutReport : what is wrong with the track net, found in one scan.
+ *
+ * Track::finalize() only counts the errors and the searches then refuse
+ * to run. build() looks at every track and every connector once and
+ * lists the issues so that a whole layout may be corrected at once:
+ * - a connector of a track connected to nothing;
+ * - a connection that is not made back, when connecting the other track
+ *   failed;
+ * - a connection whose tracks have directions that disagree. The forward
+ *   direction of a track goes from its inlets to its outlets, so 2
+ *   tracks connected by an inlet and an outlet have the same direction,
+ *   and 2 tracks connected by 2 inlets or by 2 outlets have opposite
+ *   directions. Once finalized, DirectionSolver has made them agree but
+ *   at the reversing joints, which are a warning;
+ * - an identifier given to no track, below the highest one;
+ * - a part of the net connected to the rest by no track. This may be
+ *   wanted, a test track for instance, so it is a warning, not an error.
+ *
+ * The issues are counted by kind and the first LAYOUT_REPORT_SIZE ones
+ * are kept. The parts of the net are found with 4 bytes per track in the
+ * heap, freed before build() returns.
+ *
+ *   LayoutReport rapport;
+ *   rapport.build();
+ *   if (! rapport.isOk()) rapport.print();
+ */
+#ifndef __LAYOUTREPORT_H__
+#define __LAYOUTREPORT_H__
+
+#include "Track.h"
+
+#ifndef LAYOUT_REPORT_SIZE
+#ifdef __AVR__
+#define LAYOUT_REPORT_SIZE 8
+#else
+#define LAYOUT_REPORT_SIZE 64
+#endif
+#endif
+
+typedef enum {
+  DANGLING_CONNECTOR,     /* track, connector                            */
+  ONE_WAY_CONNECTION,     /* track, connector, other track               */
+  DIRECTION_CONFLICT,     /* track, connector, other track               */
+  MISSING_TRACK,          /* track is the identifier given to no track   */
+  DUPLICATE_TRACKS,       /* other is the number of tracks too many      */
+  SEPARATE_PART,          /* track is the lowest of the part, other its  */
+                          /* number of tracks. A warning                 */
+  REVERSING_JOINT,        /* track, connector, other track. A warning    */
+  LAYOUT_ISSUE_KIND_COUNT
+} LayoutIssueKind;
+
+#define NO_ISSUE_CONNECTOR 0xFF
+
+typedef struct {
+  uint8_t kind;
+  uint8_t connector;      /* Connector of track or NO_ISSUE_CONNECTOR    */
+  uint16_t track;
+  uint16_t other;
+} LayoutIssue;
+
+class LayoutReport
+{
+  private:
+    LayoutIssue mIssues[LAYOUT_REPORT_SIZE];
+    uint16_t mKept;
+    uint16_t mCount[LAYOUT_ISSUE_KIND_COUNT];
+    uint16_t mPartCount;
+    uint16_t mLargestPart;
+    uint16_t mRecordedErrors;
+
+    void add(
+      const uint8_t inKind,
+      const uint16_t inTrack,
+      const uint8_t inConnector,
+      const uint16_t inOther
+    );
+    void checkConnections(Track & inTrack);
+    void findParts();
+
+  public:
+    LayoutReport();
+    /* Scan the track net. May be called before or after finalize() */
+    void build();
+
+    /* No error. The warnings do not count */
+    bool isOk() const;
+    uint16_t errorCount() const;
+    uint16_t warningCount() const { return mCount[SEPARATE_PART] + mCount[REVERSING_JOINT]; }
+    uint16_t count(const uint8_t inKind) const { return mCount[inKind]; }
+    /* Issues kept, the first LAYOUT_REPORT_SIZE ones */
+    uint16_t issueCount() const { return mKept; }
+    const LayoutIssue & issue(const uint16_t inIndex) const { return mIssues[inIndex]; }
+    /* Parts of the net, 0 when there was no memory to find them */
+    uint16_t partCount() const { return mPartCount; }
+    uint16_t largestPart() const { return mLargestPart; }
+    /* Errors counted by Track when connecting and finalizing */
+    uint16_t recordedErrors() const { return mRecordedErrors; }
+
+    /* Print the report as CSV on Serial */
+    void print() const;
+};
+
+#endif /* __LAYOUTREPORT_H__ */
@@ -0,0 +1,293 @@
+/*
+ * PathSearch : search of the paths from a track to another one that
+ * may be run a piece at a time.
+ */
+#include "PathSearch.h"
+#include "ReachabilityIndex.h"
+#include "DirectionSolver.h"
+#include "Profile.h"
+#include "HeapStats.h"
+
+/*
+ * Number of tracks visited between 2 readings of the clock in stepFor
+ */
+#define VISITS_PER_CLOCK_READING 8
+
+PathSearch *PathSearch::sPool[PATH_SEARCH_POOL_SIZE];
+uint8_t PathSearch::sPoolCount = 0;
+
+/*---------------------------------------------------------------------------*/
+PathSearch::PathSearch() :
+  mTarget(0),
+  mTargets(NULL),
+  mDirection(NO_DIRECTION),
+  mStack(NULL),
+  mStackSize(0),
+  mTop(0),
+  mMarking(NULL),
+  mPath(NULL),
+  mPaths(NULL),
+  mVisitor(NULL),
+  mExploration(NULL),
+  mVisitCount(0),
+  mPathCount(0),
+  mRunning(false),
+  mStopped(false)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+PathSearch::~PathSearch()
+{
+  if (mStack != NULL) {
+    HEAP_FREED(HEAP_SEARCH, mStackSize * sizeof(Frame));
+    delete [] mStack;
+  }
+  if (mMarking != NULL) delete mMarking;
+  if (mPath != NULL) delete mPath;
+}
+
+/*---------------------------------------------------------------------------*/
+bool PathSearch::start(
+  Track & inFrom,
+  const uint16_t inId,
+  const Direction inDir,
+  PathSet & ioPaths)
+{
+  mPaths = &ioPaths;
+  mVisitor = NULL;
+  return startSearch(inFrom, inId, inDir);
+}
+
+/*---------------------------------------------------------------------------*/
+bool PathSearch::start(
+  Track & inFrom,
+  const uint16_t inId,
+  const Direction inDir,
+  RouteVisitor & inVisitor)
+{
+  mPaths = NULL;
+  mVisitor = &inVisitor;
+  return startSearch(inFrom, inId, inDir);
+}
+
+/*---------------------------------------------------------------------------*/
+bool PathSearch::visit(
+  Track & inFrom,
+  const uint16_t inId,
+  const Direction inDir,
+  RouteVisitor & inVisitor)
+{
+  if (start(inFrom, inId, inDir, inVisitor)) {
+    while (! step(0xFFFF));
+  }
+  return mStopped;
+}
+
+/*---------------------------------------------------------------------------*/
+bool PathSearch::startSearch(
+  Track & inFrom,
+  const uint16_t inId,
+  const Direction inDir)
+{
+  mTarget = inId;
+  mTargets = NULL;
+  return prepare(inFrom, inDir);
+}
+
+/*---------------------------------------------------------------------------*/
+bool PathSearch::startSearch(
+  Track & inFrom,
+  TrackSet & inTargets,
+  const Direction inDir)
+{
+  mTargets = &inTargets;
+  return prepare(inFrom, inDir);
+}
+
+/*---------------------------------------------------------------------------*/
+bool PathSearch::prepare(Track & inFrom, const Direction inDir)
+{
+  finish();
+  if (! Track::trackNetIsOk()) return false;
+
+  reserve();
+  mDirection = inDir;
+  mVisitCount = 0;
+  mPathCount = 0;
+  mTop = 0;
+  mRunning = true;
+  mStopped = false;
+  if (push(&inFrom, NULL, inDir)) mVisitCount++;
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+void PathSearch::reserve()
+{
+  /*
+   * A track is on the stack once, a crossing once per way, and twice as
+   * much when a reversing joint leads back to them the other way
+   */
+  const uint16_t stackSize = Track::count() << (DirectionSolver::jointCount() > 0 ? 2 : 1);
+  if (mStackSize != stackSize) {
+    if (mStack != NULL) {
+      HEAP_FREED(HEAP_SEARCH, mStackSize * sizeof(Frame));
+      delete [] mStack;
+    }
+    mStackSize = stackSize;
+    mStack = new Frame[mStackSize];
+    HEAP_ALLOCATED(HEAP_SEARCH, mStackSize * sizeof(Frame));
+    /* The net has changed, the marking and the path are made again */
+    if (mMarking != NULL) delete mMarking;
+    if (mPath != NULL) delete mPath;
+    mMarking = NULL;
+    mPath = NULL;
+  }
+  if (mMarking == NULL) mMarking = new HeadedTrackSet();
+  else mMarking->clear(); /* The previous search may have been aborted */
+  if (mPath == NULL) mPath = new TrackSet();
+}
+
+/*---------------------------------------------------------------------------*/
+PathSearch * PathSearch::acquire()
+{
+  if (sPoolCount > 0) return sPool[--sPoolCount];
+  return new PathSearch();
+}
+
+/*---------------------------------------------------------------------------*/
+void PathSearch::release(PathSearch * inSearch)
+{
+  /* A search given back while running is stopped */
+  inSearch->finish();
+  if (sPoolCount < PATH_SEARCH_POOL_SIZE) sPool[sPoolCount++] = inSearch;
+  else delete inSearch;
+}
+
+/*---------------------------------------------------------------------------*/
+bool PathSearch::isTarget(Track * inTrack)
+{
+  if (mTargets == NULL) return inTrack->identifier() == mTarget;
+  if (! mTargets->containsTrack(inTrack)) return false;
+  /*
+   * A crossing already on the path has been reached by a shorter path,
+   * so has a track reached again the other way after a reversing joint
+   */
+  if (inTrack->entryCount() > 1 || DirectionSolver::jointCount() > 0) {
+    for (uint16_t i = 0; i + 1 < mTop; i++) {
+      if (mStack[i].track == inTrack) return false;
+    }
+  }
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+bool PathSearch::leadsToTarget(Track * inTrack, const Direction inDir)
+{
+  /* The search does not go beyond the target */
+  if (mTargets == NULL) return inTrack->identifier() != mTarget;
+  /* Crossings are not in the index as start tracks */
+  if (! ReachabilityIndex::isBuilt() || inTrack->entryCount() > 1) return true;
+  for (uint8_t i = 0; i < Track::sizeForSet(); i++) {
+    uint8_t targets = mTargets->byteAt(i);
+    for (uint8_t bit = 0; targets != 0; bit++, targets >>= 1) {
+      if ((targets & 1) &&
+          ReachabilityIndex::reaches(inTrack->identifier(), (i << 3) + bit, inDir)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/*---------------------------------------------------------------------------*/
+bool PathSearch::push(Track * inTrack, const Track * inFrom, const Direction inDir)
+{
+  /* A full stack before marking, pop() would not unmark the track */
+  if (mTop >= mStackSize) return false;
+  /* Crossings are not marked since they may be used on both ways */
+  if (inTrack->entryCount() == 1) {
+    if (mMarking->containsTrack(inTrack, inDir)) {
+      if (mExploration != NULL) mExploration[inTrack->identifier()].marked++;
+      return false;
+    }
+    mMarking->addTrack(inTrack, inDir);
+  }
+  const bool explore = leadsToTarget(inTrack, inDir);
+  mStack[mTop].track = inTrack;
+  mStack[mTop].from = inFrom;
+  mStack[mTop].next = 0;
+  mStack[mTop].explore = explore;
+  mStack[mTop].dir = inDir;
+  mTop++;
+  const bool target = isTarget(inTrack);
+  if (mExploration != NULL) {
+    TrackExploration & exploration = mExploration[inTrack->identifier()];
+    exploration.visits++;
+    if (! explore && ! target) exploration.pruned++;
+  }
+  if (target) recordPath();
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+void PathSearch::pop()
+{
+  const Frame & frame = mStack[--mTop];
+  if (frame.track->entryCount() == 1) mMarking->removeTrack(frame.track, frame.dir);
+}
+
+/*---------------------------------------------------------------------------*/
+void PathSearch::recordPath()
+{
+  mPath->clear();
+  for (uint16_t i = 0; i < mTop; i++) mPath->addTrack(mStack[i].track);
+  mPathCount++;
+  pathFound(*mPath);
+}
+
+/*---------------------------------------------------------------------------*/
+void PathSearch::pathFound(const TrackSet & inPath)
+{
+  if (mVisitor == NULL) mPaths->addPath(inPath);
+  else if (! mVisitor->visitRoute(inPath)) {
+    mStopped = true;
+    finish();
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+bool PathSearch::step(const uint16_t inVisits)
+{
+  PROFILE_SCOPE(PROFILE_STEP);
+  uint16_t visits = 0;
+  while (mRunning && mTop > 0 && visits < inVisits) {
+    Frame & frame = mStack[mTop - 1];
+    Track * next[MAX_NEXT_TRACKS];
+    uint8_t count = 0;
+    if (frame.explore) {
+      count = frame.track->nextTracks(frame.dir, frame.from, next);
+    }
+    if (frame.next < count) {
+      const Direction dir =
+        DirectionSolver::directionAfter(*frame.track, frame.dir, next, frame.next);
+      Track * nextTrack = next[frame.next++];
+      if (push(nextTrack, frame.track, dir)) visits++;
+    }
+    else pop();
+  }
+  mVisitCount += visits;
+  if (mTop == 0) finish();
+  return isDone();
+}
+
+/*---------------------------------------------------------------------------*/
+bool PathSearch::stepFor(const uint32_t inMicros)
+{
+  uint32_t startTime = micros();
+  while (! isDone() && (micros() - startTime) < inMicros) {
+    step(VISITS_PER_CLOCK_READING);
+  }
+  return isDone();
+}
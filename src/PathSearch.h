@@ -0,0 +1,174 @@
+/*
+ * PathSearch : search of the paths from a track to another one that
+ * may be run a piece at a time.
+ * The search uses an explicit stack instead of the recursion of
+ * Track::allPathsTo so that it can be stopped after a number of visited
+ * tracks or a given time and resumed later, from loop() for instance.
+ * Each path found is added to the PathSet given at start or given to a
+ * RouteVisitor as soon as it is found. The visitor may stop the search,
+ * to take the first route that suits for instance. The memory used then
+ * depends on the length of the routes, not on their number. The working
+ * memory is kept from a search to the next one. Track::pathsTo and
+ * Track::visitPathsTo take their search from a small pool with acquire()
+ * and give it back with release().
+ *
+ *   PathSearch search;
+ *   search.start(voie23, voie1_id, FORWARD_DIRECTION, paths);
+ *   ...
+ *   void loop() {
+ *     if (! search.isDone()) search.stepFor(500);
+ *   }
+ */
+#ifndef __PATHSEARCH_H__
+#define __PATHSEARCH_H__
+
+#include "PathSet.h"
+#include "HeadedTrackSet.h"
+
+/*
+ * Number of searches kept by the pool. More searches may be acquired at
+ * once, they are then allocated and freed on release
+ */
+#ifndef PATH_SEARCH_POOL_SIZE
+#define PATH_SEARCH_POOL_SIZE 2
+#endif
+
+/*
+ * Visitor of the routes found by a search
+ */
+class RouteVisitor
+{
+  public:
+    /* Called for each route found. Return false to stop the search */
+    virtual bool visitRoute(const TrackSet & inRoute) = 0;
+};
+
+/*
+ * Exploration of a track by the searches, for the heatmaps of the host
+ * exporter. Counted only when a table is given to setExploration().
+ */
+typedef struct {
+  uint32_t visits;   /* Times the track was put on the path               */
+  uint32_t marked;   /* Times it was refused, already on the path         */
+  uint32_t pruned;   /* Times it was not explored, no target reachable    */
+} TrackExploration;
+
+class PathSearch
+{
+  private:
+    typedef struct {
+      Track * track;        /* Track visited                          */
+      const Track * from;   /* Track used to get there                */
+      uint8_t next;         /* Index of the next track to explore     */
+      bool explore;         /* Explore the tracks following this one  */
+      Direction dir;        /* Swapped by the reversing joints        */
+    } Frame;
+
+    uint16_t mTarget;
+    TrackSet * mTargets;  /* Targets of a search to several tracks  */
+    Direction mDirection;
+    Frame * mStack;
+    uint16_t mStackSize;
+    uint16_t mTop;
+    HeadedTrackSet * mMarking;
+    TrackSet * mPath;     /* Path being recorded                    */
+    PathSet * mPaths;
+    RouteVisitor * mVisitor;
+    TrackExploration * mExploration;
+    uint32_t mVisitCount;
+    uint32_t mPathCount;  /* Paths found, the duplicates included   */
+    bool mRunning;
+    bool mStopped;        /* Stopped by the visitor */
+
+    static PathSearch *sPool[PATH_SEARCH_POOL_SIZE];
+    static uint8_t sPoolCount; /* Searches available in the pool */
+
+    bool push(Track * inTrack, const Track * inFrom, const Direction inDir);
+    void pop();
+    bool isTarget(Track * inTrack);
+    bool leadsToTarget(Track * inTrack, const Direction inDir);
+    void recordPath();
+    void finish() { mRunning = false; }
+    bool prepare(Track & inFrom, const Direction inDir);
+
+  protected:
+    /* Start a search. The paths are given to pathFound() */
+    bool startSearch(Track & inFrom, const uint16_t inId, const Direction inDir);
+    /*
+     * Start a search to all the tracks of inTargets in one traversal. The
+     * search goes on beyond the targets. inTargets must live until the
+     * search is done.
+     */
+    bool startSearch(Track & inFrom, TrackSet & inTargets, const Direction inDir);
+    /* Track reached by the path given to pathFound() */
+    Track * lastTrack() const { return mStack[mTop - 1].track; }
+    /*
+     * Called for each path found. Give it to the visitor or add it to the
+     * PathSet by default
+     */
+    virtual void pathFound(const TrackSet & inPath);
+
+  public:
+    PathSearch();
+    virtual ~PathSearch();
+    /*
+     * Start a search of the paths from inFrom to track inId. ioPaths
+     * must live until the search is done. Return false if the track
+     * net is not ok.
+     */
+    bool start(Track & inFrom, const uint16_t inId, const Direction inDir, PathSet & ioPaths);
+    /*
+     * Allocate the working memory for the current track net ahead of the
+     * first search, done by start() otherwise
+     */
+    void reserve();
+    /* Start a search giving the paths to inVisitor */
+    bool start(Track & inFrom, const uint16_t inId, const Direction inDir, RouteVisitor & inVisitor);
+    /*
+     * Run a whole search giving the paths to inVisitor. Return true if
+     * the visitor stopped it.
+     */
+    bool visit(Track & inFrom, const uint16_t inId, const Direction inDir, RouteVisitor & inVisitor);
+    /* Visit at most inVisits tracks. Return true when the search is done */
+    bool step(const uint16_t inVisits);
+    /* Search during about inMicros microseconds. Return true when done */
+    bool stepFor(const uint32_t inMicros);
+    /* Stop the search. The paths found so far are kept */
+    void abort() { finish(); }
+    bool isDone() const { return ! mRunning; }
+    bool wasStopped() const { return mStopped; }
+    uint32_t visitCount() const { return mVisitCount; }
+    uint32_t pathCount() const { return mPathCount; }
+    /*
+     * Count the exploration of each track in ioTable, Track::count()
+     * entries indexed by identifier, until NULL is given. The table is
+     * not cleared by the searches.
+     */
+    void setExploration(TrackExploration * ioTable) { mExploration = ioTable; }
+
+    /* Get a search from the pool, its working memory kept from the last use */
+    static PathSearch * acquire();
+    /* Give a search back to the pool */
+    static void release(PathSearch * inSearch);
+};
+
+/*
+ * Search of the pool, given back when going out of scope
+ */
+class PooledPathSearch
+{
+  private:
+    PathSearch * mSearch;
+
+    /* Not copied, the search would be given back twice */
+    PooledPathSearch(const PooledPathSearch &);
+    PooledPathSearch & operator=(const PooledPathSearch &);
+
+  public:
+    PooledPathSearch() : mSearch(PathSearch::acquire()) {}
+    ~PooledPathSearch() { PathSearch::release(mSearch); }
+    PathSearch & operator*() { return *mSearch; }
+    PathSearch * operator->() { return mSearch; }
+};
+
+#endif /* __PATHSEARCH_H__ */
@@ -3,6 +3,20 @@
  */
 #include "PathSet.h"
 
+#ifdef SWITCHMAN_HEAP_STATS
+void * Path::operator new(size_t inSize)
+{
+  HEAP_ALLOCATED(HEAP_PATHS, inSize);
+  return ::operator new(inSize);
+}
+
+void Path::operator delete(void * inPath, size_t inSize)
+{
+  HEAP_FREED(HEAP_PATHS, inSize);
+  ::operator delete(inPath);
+}
+#endif
+
 bool Path::fitWith(const Path & inPath)
 {
   uint8_t result = 0;
@@ -69,6 +83,44 @@ void PathSet::addTrack(uint16_t inId)
   }
 }
 
+/*
+ * Adds a set of tracks to all paths contained in the set
+ */
+void PathSet::addTrackSet(const TrackSet & inSet)
+{
+#ifdef TRACE
+  this->println();
+  Serial.print("Adding ");
+  ((TrackSet &)inSet).println();
+#endif
+  Path * p = mListHead;
+  while (p != NULL) {
+    p->addTrackSet(inSet);
+    p = p->mNext;
+  }
+}
+
+/*
+ * Adds a path to the set if not already in. The empty path of a new set
+ * is used for the first one.
+ */
+void PathSet::addPath(const TrackSet & inPath)
+{
+  if (mListHead != NULL && mListHead->mNext == NULL && mListHead->isEmpty()) {
+    *(TrackSet *)mListHead = inPath;
+    return;
+  }
+  Path * c = new Path();
+  *(TrackSet *)c = inPath;
+  if (containsPath(*c)) {
+    delete c;
+  }
+  else {
+    c->mNext = mListHead;
+    mListHead = c;
+  }
+}
+
 bool PathSet::containsPath(Path & inPath)
 {
   Path *p = mListHead;
@@ -5,6 +5,7 @@
 #define __PATHSET_H__
 
 #include "TrackSet.h"
+#include "HeapStats.h"
 
 class PathSet;
 
@@ -15,9 +16,16 @@ class Path : public TrackSet
     friend class PathSet;
 
   public:
-    Path() : TrackSet() { mNext = NULL; }
-    Path(const Path & inPath) : TrackSet(inPath) { mNext = NULL; }
+    Path() : TrackSet(HEAP_PATHS) { mNext = NULL; }
+    Path(const Path & inPath) : TrackSet(inPath, HEAP_PATHS) { mNext = NULL; }
+    Path * next() const { return mNext; }
     bool fitWith(const Path & inPath);
+
+#ifdef SWITCHMAN_HEAP_STATS
+    /* The paths themselves are counted too */
+    static void * operator new(size_t inSize);
+    static void operator delete(void * inPath, size_t inSize);
+#endif
 };
 
 /*
@@ -41,10 +49,13 @@ class PathSet
     ~PathSet();
     void addTrack(uint16_t inId);
     void addTrack(Track * inTrack) { addTrack(inTrack->identifier()); }
+    void addTrackSet(const TrackSet & inSet);
+    void addPath(const TrackSet & inPath);
     bool containsPath(Path & inPath);
     PathSet & operator+=(PathSet & inSet);
     PathSet & operator=(PathSet & inSet);
     uint16_t count();
+    Path * firstPath() const { return mListHead; }
 #ifdef DEBUG
     void print();
     void println();
@@ -0,0 +1,175 @@
+/*
+ * Profile : time spent in the route queries, measured with a cycle
+ * counter.
+ */
+#include "Profile.h"
+
+#ifdef SWITCHMAN_PROFILE
+
+#include "HardwareSerial.h"
+
+#ifdef __AVR__
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+/*
+ * Profile clock of AVR: Timer1 counts the CPU cycles, its overflows
+ * give the 16 upper bits.
+ */
+static volatile uint16_t sTimerOverflows = 0;
+
+ISR(TIMER1_OVF_vect)
+{
+  sTimerOverflows++;
+}
+
+void profileClockBegin()
+{
+  uint8_t sreg = SREG;
+  cli();
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+  TCNT1 = 0;
+  TIFR1 = _BV(TOV1);
+  TIMSK1 = _BV(TOIE1);
+  sTimerOverflows = 0;
+  SREG = sreg;
+}
+
+uint32_t profileTicks()
+{
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t low = TCNT1;
+  uint16_t high = sTimerOverflows;
+  /* Overflow not served yet because interrupts are off */
+  if ((TIFR1 & _BV(TOV1)) && low < 0x8000) high++;
+  SREG = sreg;
+  return ((uint32_t)high << 16) | low;
+}
+
+uint16_t profileTicksPerMicrosecond()
+{
+  return F_CPU / 1000000UL;
+}
+
+#endif /* __AVR__ */
+
+uint32_t Profile::sCount[PROFILE_POINT_COUNT];
+uint64_t Profile::sTotal[PROFILE_POINT_COUNT];
+uint32_t Profile::sMin[PROFILE_POINT_COUNT];
+uint32_t Profile::sMax[PROFILE_POINT_COUNT];
+uint16_t Profile::sHistogram[PROFILE_POINT_COUNT][PROFILE_BUCKETS];
+Profile::Frame Profile::sStack[PROFILE_DEPTH];
+uint8_t Profile::sDepth = 0;
+uint16_t Profile::sTooDeep = 0;
+
+/*---------------------------------------------------------------------------*/
+void Profile::begin()
+{
+  profileClockBegin();
+  reset();
+}
+
+/*---------------------------------------------------------------------------*/
+void Profile::reset()
+{
+  for (uint8_t p = 0; p < PROFILE_POINT_COUNT; p++) {
+    sCount[p] = 0;
+    sTotal[p] = 0;
+    sMin[p] = 0xFFFFFFFF;
+    sMax[p] = 0;
+    for (uint8_t b = 0; b < PROFILE_BUCKETS; b++) sHistogram[p][b] = 0;
+  }
+  sDepth = 0;
+  sTooDeep = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+void Profile::enter(__attribute__((unused)) const uint8_t inPoint)
+{
+  if (sDepth < PROFILE_DEPTH) {
+    sStack[sDepth].enclosed = 0;
+    sStack[sDepth++].start = profileTicks();
+  }
+  else sTooDeep++;
+}
+
+/*---------------------------------------------------------------------------*/
+void Profile::exit(const uint8_t inPoint)
+{
+  const uint32_t now = profileTicks();
+  if (sTooDeep > 0) {
+    sTooDeep--;
+    return;
+  }
+  if (sDepth == 0) return; /* Entered before begin() or reset() */
+  Frame & frame = sStack[--sDepth];
+  const uint32_t elapsed = now - frame.start;
+  record(inPoint, inPoint == PROFILE_QUERY ? elapsed : elapsed - frame.enclosed);
+  if (sDepth > 0) sStack[sDepth - 1].enclosed += elapsed;
+}
+
+/*---------------------------------------------------------------------------*/
+void Profile::record(const uint8_t inPoint, const uint32_t inTicks)
+{
+  sCount[inPoint]++;
+  sTotal[inPoint] += inTicks;
+  if (inTicks < sMin[inPoint]) sMin[inPoint] = inTicks;
+  if (inTicks > sMax[inPoint]) sMax[inPoint] = inTicks;
+  uint8_t b = 0;
+  for (uint32_t ticks = inTicks >> 1; ticks != 0 && b < PROFILE_BUCKETS - 1; ticks >>= 1) b++;
+  if (sHistogram[inPoint][b] < 0xFFFF) sHistogram[inPoint][b]++;
+}
+
+/*---------------------------------------------------------------------------*/
+static void printPointName(const uint8_t inPoint)
+{
+  switch (inPoint) {
+    case PROFILE_QUERY:      Serial.print(F("query"));      break;
+    case PROFILE_STEP:       Serial.print(F("step"));       break;
+    case PROFILE_DEADEND:    Serial.print(F("deadend"));    break;
+    case PROFILE_BLOCK:      Serial.print(F("block"));      break;
+    case PROFILE_TURNOUT:    Serial.print(F("turnout"));    break;
+    case PROFILE_THREEWAY:   Serial.print(F("threeway"));   break;
+    case PROFILE_CROSSING:   Serial.print(F("crossing"));   break;
+    case PROFILE_DOUBLESLIP: Serial.print(F("doubleslip")); break;
+    case PROFILE_ALLOCATION: Serial.print(F("allocation")); break;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+void Profile::dump()
+{
+  const uint16_t ticksPerMicrosecond = profileTicksPerMicrosecond();
+  Serial.print(F("profile,ticks_per_us,"));
+  Serial.println((unsigned long)ticksPerMicrosecond);
+  Serial.print(F("point,count,total_us,mean,min,max"));
+  for (uint8_t b = 0; b < PROFILE_BUCKETS; b++) {
+    Serial.print(F(",b"));
+    Serial.print((unsigned long)b);
+  }
+  Serial.println();
+  for (uint8_t p = 0; p < PROFILE_POINT_COUNT; p++) {
+    if (sCount[p] == 0) continue;
+    printPointName(p);
+    Serial.print(',');
+    Serial.print((unsigned long)sCount[p]);
+    Serial.print(',');
+    Serial.print((unsigned long)(sTotal[p] / ticksPerMicrosecond));
+    Serial.print(',');
+    Serial.print((unsigned long)(sTotal[p] / sCount[p]));
+    Serial.print(',');
+    Serial.print((unsigned long)sMin[p]);
+    Serial.print(',');
+    Serial.print((unsigned long)sMax[p]);
+    for (uint8_t b = 0; b < PROFILE_BUCKETS; b++) {
+      Serial.print(',');
+      Serial.print((unsigned long)sHistogram[p][b]);
+    }
+    Serial.println();
+  }
+}
+
+#endif /* SWITCHMAN_PROFILE */
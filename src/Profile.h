@@ -0,0 +1,128 @@
+/*
+ * Profile : time spent in the route queries, measured with a cycle
+ * counter.
+ *
+ * Profiling is built when SWITCHMAN_PROFILE is defined in the build
+ * flags, the hooks are empty otherwise. The time is counted in ticks of
+ * the profile clock:
+ * - on AVR, Timer1 counting the CPU cycles, prescaler 1. Timer1 is then
+ *   not available to the sketch (Servo, PWM on pins 9 and 10 of a Uno
+ *   or Nano, 11 and 12 of a Mega);
+ * - on the host, the TSC of x86 processors or clock_gettime, given by
+ *   the unix emulation (unix/ProfileClock.cpp).
+ * The dump gives the ticks per microsecond so the profiles of both
+ * platforms may be compared.
+ *
+ * Each profile point keeps a count, the total, minimum and maximum time
+ * and a histogram: bucket i counts the times from 2^i to 2^(i+1) - 1
+ * ticks, the last bucket the longer ones. The time of a query includes
+ * everything done during the query. The time of the other points is
+ * their own time, the points they enclose apart, so the time of a turnout
+ * does not include the tracks after it.
+ *
+ *   Profile::begin();
+ *   voie23.pathsTo(voie1_id, FORWARD_DIRECTION, itineraires);
+ *   Profile::dump();
+ */
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include "Arduino.h"
+
+typedef enum {
+  PROFILE_QUERY,       /* Track::pathsTo, visitPathsTo, BatchSearch   */
+  PROFILE_STEP,        /* PathSearch::step                            */
+  PROFILE_DEADEND,     /* allPathsTo of each kind of track            */
+  PROFILE_BLOCK,
+  PROFILE_TURNOUT,
+  PROFILE_THREEWAY,
+  PROFILE_CROSSING,
+  PROFILE_DOUBLESLIP,
+  PROFILE_ALLOCATION,  /* Allocation of the sets, paths included      */
+  PROFILE_POINT_COUNT
+} ProfilePoint;
+
+/*
+ * Profile clock, given by the platform
+ */
+void profileClockBegin();
+uint32_t profileTicks();
+uint16_t profileTicksPerMicrosecond();
+
+#ifdef SWITCHMAN_PROFILE
+
+/* Buckets of the histograms, 2 bytes each per point */
+#ifndef PROFILE_BUCKETS
+#ifdef __AVR__
+#define PROFILE_BUCKETS 16
+#else
+#define PROFILE_BUCKETS 24
+#endif
+#endif
+
+/* Points enclosed in one another that are measured, the deeper ones are not */
+#ifndef PROFILE_DEPTH
+#define PROFILE_DEPTH 24
+#endif
+
+class Profile
+{
+  private:
+    typedef struct {
+      uint32_t start;     /* Ticks when the point was entered      */
+      uint32_t enclosed;  /* Ticks of the points it encloses       */
+    } Frame;
+
+    static uint32_t sCount[PROFILE_POINT_COUNT];
+    static uint64_t sTotal[PROFILE_POINT_COUNT];
+    static uint32_t sMin[PROFILE_POINT_COUNT];
+    static uint32_t sMax[PROFILE_POINT_COUNT];
+    static uint16_t sHistogram[PROFILE_POINT_COUNT][PROFILE_BUCKETS];
+    static Frame sStack[PROFILE_DEPTH];
+    static uint8_t sDepth;
+    static uint16_t sTooDeep; /* Points entered beyond PROFILE_DEPTH */
+
+    static void record(const uint8_t inPoint, const uint32_t inTicks);
+
+  public:
+    /* Start the clock and clear the profile */
+    static void begin();
+    static void reset();
+    static void enter(const uint8_t inPoint);
+    static void exit(const uint8_t inPoint);
+
+    static uint32_t count(const uint8_t inPoint) { return sCount[inPoint]; }
+    static uint64_t total(const uint8_t inPoint) { return sTotal[inPoint]; }
+    static uint32_t minimum(const uint8_t inPoint) { return sMin[inPoint]; }
+    static uint32_t maximum(const uint8_t inPoint) { return sMax[inPoint]; }
+    static uint16_t bucket(const uint8_t inPoint, const uint8_t inBucket)
+    {
+      return sHistogram[inPoint][inBucket];
+    }
+
+    /* Print the profile as CSV on Serial */
+    static void dump();
+};
+
+/*
+ * Point measured from its declaration to the end of the block
+ */
+class ProfileScope
+{
+  private:
+    uint8_t mPoint;
+
+  public:
+    ProfileScope(const uint8_t inPoint) : mPoint(inPoint) { Profile::enter(inPoint); }
+    ~ProfileScope() { Profile::exit(mPoint); }
+};
+
+#define PROFILE_SCOPE(point) ProfileScope profileScope(point)
+
+#else
+
+#define PROFILE_SCOPE(point)
+
+#endif /* SWITCHMAN_PROFILE */
+
+#endif /* __PROFILE_H__ */
@@ -0,0 +1,245 @@
+/*
+ * ReachabilityIndex : tells in constant time if a track may be reached
+ * from another one in a travel direction.
+ */
+#include "ReachabilityIndex.h"
+#include "DirectionSolver.h"
+#include "HeapStats.h"
+
+#define NO_STATE 0xFFFF
+
+uint16_t *ReachabilityIndex::sStartComponent = NULL;
+uint8_t *ReachabilityIndex::sRows = NULL;
+uint16_t ReachabilityIndex::sComponentCount = 0;
+
+/*
+ * Working data used during the build only
+ */
+static uint16_t *gFirstState;  /* First state of each track            */
+static uint16_t *gOwner;       /* Track of each state                  */
+static uint16_t *gNext;        /* Following states, MAX_NEXT_TRACKS each */
+static uint8_t *gExpanded;     /* Bit vector of the expanded states    */
+
+static uint16_t stateOf(Track * inTrack, const uint8_t inEntry, const Direction inDir)
+{
+  return gFirstState[inTrack->identifier()] + (inEntry << 1) + inDir;
+}
+
+/*
+ * Compute the following states of a track reached from inFrom.
+ * Crossings are expanded when reached since the way they are gone
+ * through depends on the track used to get there.
+ */
+static void expand(Track * inTrack, const Track * inFrom, const Direction inDir)
+{
+  uint16_t state = stateOf(inTrack, inTrack->entryOf(inFrom), inDir);
+  gExpanded[state >> 3] |= 1 << (state & 7);
+  Track * next[MAX_NEXT_TRACKS];
+  uint8_t count = inTrack->nextTracks(inDir, inFrom, next);
+  for (uint8_t i = 0; i < count; i++) {
+    /* A reversing joint leads to the other direction */
+    const Direction nextDir = DirectionSolver::directionAfter(*inTrack, inDir, next, i);
+    uint16_t nextState = stateOf(next[i], next[i]->entryOf(inTrack), nextDir);
+    gNext[state * MAX_NEXT_TRACKS + i] = nextState;
+    if (next[i]->entryCount() > 1 &&
+        (gExpanded[nextState >> 3] & (1 << (nextState & 7))) == 0) {
+      expand(next[i], inTrack, nextDir);
+    }
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+bool ReachabilityIndex::build()
+{
+  clear();
+  if (! Track::trackNetIsOk()) return false;
+
+  const uint16_t trackCount = Track::count();
+  const uint8_t rowSize = Track::sizeForSet();
+
+  /* Number the states, NO_STATE must stay out of reach */
+  uint32_t states = 0;
+  for (uint16_t t = 0; t < trackCount; t++) {
+    states += Track::trackForId(t).entryCount() << 1;
+  }
+  if (states >= NO_STATE) return false;
+  const uint16_t stateCount = states;
+  gFirstState = new uint16_t[trackCount];
+  states = 0;
+  for (uint16_t t = 0; t < trackCount; t++) {
+    gFirstState[t] = states;
+    states += Track::trackForId(t).entryCount() << 1;
+  }
+  gOwner = new uint16_t[stateCount];
+  for (uint16_t t = 0; t < trackCount; t++) {
+    uint16_t last = gFirstState[t] + (Track::trackForId(t).entryCount() << 1);
+    for (uint16_t s = gFirstState[t]; s < last; s++) gOwner[s] = t;
+  }
+
+  /* Build the edges */
+  const uint32_t edgeCount = (uint32_t)stateCount * MAX_NEXT_TRACKS;
+  gNext = new uint16_t[edgeCount];
+  for (uint32_t i = 0; i < edgeCount; i++) gNext[i] = NO_STATE;
+  uint16_t bitVectorSize = (stateCount >> 3) + ((stateCount & 7) != 0);
+  gExpanded = new uint8_t[bitVectorSize];
+  for (uint16_t i = 0; i < bitVectorSize; i++) gExpanded[i] = 0;
+  for (uint16_t t = 0; t < trackCount; t++) {
+    Track & track = Track::trackForId(t);
+    if (track.entryCount() == 1) {
+      expand(&track, NULL, FORWARD_DIRECTION);
+      expand(&track, NULL, BACKWARD_DIRECTION);
+    }
+  }
+  delete [] gExpanded;
+
+  /*
+   * Tarjan's algorithm with an explicit stack. Components are found
+   * in reverse topological order so the rows of the components
+   * reachable from a component are complete when it is found.
+   */
+  uint16_t *index = new uint16_t[stateCount];
+  uint16_t *low = new uint16_t[stateCount];
+  uint16_t *component = new uint16_t[stateCount];
+  uint16_t *stack = new uint16_t[stateCount];
+  uint16_t *callState = new uint16_t[stateCount];
+  uint8_t *callEdge = new uint8_t[stateCount];
+  uint8_t *rows = (uint8_t *)malloc((uint32_t)stateCount * rowSize);
+  for (uint16_t s = 0; s < stateCount; s++) {
+    index[s] = NO_STATE;
+    component[s] = NO_STATE;
+  }
+  uint16_t counter = 0;
+  uint16_t stackTop = 0;
+  uint16_t componentCount = 0;
+
+  for (uint16_t root = 0; root < stateCount; root++) {
+    if (index[root] != NO_STATE) continue;
+    uint16_t callTop = 0;
+    callState[callTop] = root;
+    callEdge[callTop++] = 0;
+    index[root] = low[root] = counter++;
+    stack[stackTop++] = root;
+
+    while (callTop > 0) {
+      uint16_t v = callState[callTop - 1];
+      uint8_t e = callEdge[callTop - 1];
+      uint16_t w = (e < MAX_NEXT_TRACKS) ? gNext[v * MAX_NEXT_TRACKS + e] : NO_STATE;
+      if (w != NO_STATE) {
+        callEdge[callTop - 1]++;
+        if (index[w] == NO_STATE) {
+          index[w] = low[w] = counter++;
+          stack[stackTop++] = w;
+          callState[callTop] = w;
+          callEdge[callTop++] = 0;
+        }
+        else if (component[w] == NO_STATE && index[w] < low[v]) {
+          /* w is still on the stack */
+          low[v] = index[w];
+        }
+      }
+      else {
+        callTop--;
+        if (low[v] == index[v]) {
+          /* v is the root of a component, its states are on top of stack */
+          uint16_t bottom = stackTop;
+          do {
+            component[stack[--bottom]] = componentCount;
+          } while (stack[bottom] != v);
+          uint8_t *row = rows + componentCount * rowSize;
+          for (uint8_t i = 0; i < rowSize; i++) row[i] = 0;
+          for (uint16_t k = bottom; k < stackTop; k++) {
+            uint16_t s = stack[k];
+            row[gOwner[s] >> 3] |= 1 << (gOwner[s] & 7);
+            for (uint8_t i = 0; i < MAX_NEXT_TRACKS; i++) {
+              uint16_t n = gNext[s * MAX_NEXT_TRACKS + i];
+              if (n != NO_STATE && component[n] != componentCount) {
+                uint8_t *nextRow = rows + component[n] * rowSize;
+                for (uint8_t j = 0; j < rowSize; j++) row[j] |= nextRow[j];
+              }
+            }
+          }
+          stackTop = bottom;
+          componentCount++;
+        }
+        if (callTop > 0) {
+          uint16_t u = callState[callTop - 1];
+          if (low[v] < low[u]) low[u] = low[v];
+        }
+      }
+    }
+  }
+
+  /*
+   * Keep the component of the start states. A search starting on a
+   * crossing does not go anywhere since it does not know where it
+   * comes from.
+   */
+  sStartComponent = new uint16_t[trackCount << 1];
+  for (uint16_t t = 0; t < trackCount; t++) {
+    bool isCrossing = Track::trackForId(t).entryCount() > 1;
+    sStartComponent[(t << 1) + FORWARD_DIRECTION] =
+      isCrossing ? NO_STATE : component[gFirstState[t] + FORWARD_DIRECTION];
+    sStartComponent[(t << 1) + BACKWARD_DIRECTION] =
+      isCrossing ? NO_STATE : component[gFirstState[t] + BACKWARD_DIRECTION];
+  }
+  sRows = (uint8_t *)realloc(rows, componentCount * rowSize);
+  sComponentCount = componentCount;
+  HEAP_ALLOCATED(HEAP_INDEX, (trackCount << 1) * sizeof(uint16_t));
+  HEAP_ALLOCATED(HEAP_INDEX, componentCount * rowSize);
+
+  delete [] index;
+  delete [] low;
+  delete [] component;
+  delete [] stack;
+  delete [] callState;
+  delete [] callEdge;
+  delete [] gNext;
+  delete [] gOwner;
+  delete [] gFirstState;
+
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+uint32_t ReachabilityIndex::buildSize()
+{
+  const uint16_t trackCount = Track::count();
+  uint32_t stateCount = 0;
+  for (uint16_t t = 0; t < trackCount; t++) {
+    stateCount += Track::trackForId(t).entryCount() << 1;
+  }
+  /*
+   * First state and 2 start components per track. Owner, edges, the 6
+   * arrays of Tarjan's algorithm and a row per state
+   */
+  return (uint32_t)trackCount * 3 * sizeof(uint16_t) +
+         stateCount * ((1 + MAX_NEXT_TRACKS + 5) * sizeof(uint16_t) + 1 + Track::sizeForSet());
+}
+
+/*---------------------------------------------------------------------------*/
+void ReachabilityIndex::clear()
+{
+  if (sRows != NULL) {
+    HEAP_FREED(HEAP_INDEX, sComponentCount * Track::sizeForSet());
+    free(sRows);
+    sRows = NULL;
+  }
+  if (sStartComponent != NULL) {
+    HEAP_FREED(HEAP_INDEX, (Track::count() << 1) * sizeof(uint16_t));
+    delete [] sStartComponent;
+    sStartComponent = NULL;
+  }
+  sComponentCount = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+bool ReachabilityIndex::reaches(
+  const uint16_t inFromId,
+  const uint16_t inToId,
+  const Direction inDir)
+{
+  uint16_t c = sStartComponent[(inFromId << 1) + inDir];
+  if (c == NO_STATE) return inFromId == inToId;
+  const uint8_t *row = sRows + c * Track::sizeForSet();
+  return (row[inToId >> 3] & (1 << (inToId & 7))) != 0;
+}
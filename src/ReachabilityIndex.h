@@ -0,0 +1,64 @@
+/*
+ * ReachabilityIndex : tells in constant time if a track may be reached
+ * from another one in a travel direction.
+ * The index is built by Track::finalize() on the graph of the search
+ * states: a state is a track, the way it is gone through (crossings have
+ * 2 ways) and the travel direction. The strongly connected components of
+ * this graph are computed and, for each component, the set of reachable
+ * tracks is stored as a bit vector indexed by the track identifiers.
+ * The memory used is (number of components) * Track::sizeForSet() bytes.
+ *
+ * A track gone through one way, a double slip included, has one state
+ * per direction. The next states of a double slip are those of all its
+ * entries on a side, which is exact since each inlet leads to each
+ * outlet and the reverse. A track whose exits would depend on the
+ * entry, a single slip for instance, would make the index over-approximate:
+ * reaches() could then return true where there is no route, a false
+ * answer staying always right. build() returns false when the net has
+ * more states than the 16 bits state numbers allow.
+ */
+#ifndef __REACHABILITYINDEX_H__
+#define __REACHABILITYINDEX_H__
+
+#include "Track.h"
+
+/*
+ * Track::finalize() builds the index when the build takes at most this
+ * many bytes of working memory. 0 leaves the build to the sketch.
+ */
+#ifndef REACHABILITY_INDEX_BUILD_BYTES
+#ifdef __AVR__
+#define REACHABILITY_INDEX_BUILD_BYTES 1024
+#else
+#define REACHABILITY_INDEX_BUILD_BYTES 0x1000000UL
+#endif
+#endif
+
+class ReachabilityIndex
+{
+  private:
+    static uint16_t *sStartComponent; /* Component of the start states  */
+    static uint8_t *sRows;            /* Reachable tracks per component */
+    static uint16_t sComponentCount;  /* Number of components           */
+
+  public:
+    /* Build the index. Return false if the track net is not ok or too large */
+    static bool build();
+    /* Bytes of working memory taken by the build for the current net */
+    static uint32_t buildSize();
+    /* Free the index */
+    static void clear();
+    static bool isBuilt() { return sRows != NULL; }
+    static uint16_t componentCount() { return sComponentCount; }
+    /*
+     * Return true if a train starting on track inFromId and travelling
+     * in inDir may reach track inToId.
+     */
+    static bool reaches(
+      const uint16_t inFromId,
+      const uint16_t inToId,
+      const Direction inDir
+    );
+};
+
+#endif /* __REACHABILITYINDEX_H__ */
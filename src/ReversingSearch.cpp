@@ -0,0 +1,300 @@
+/*
+ * ReversingSearch : search of routes allowing the train to reverse
+ * on designated tracks.
+ */
+#include "ReversingSearch.h"
+#include "DirectionSolver.h"
+#include "HeapStats.h"
+
+/*=============================================================================
+ * LegRoute
+ */
+LegRoute::LegRoute(const LegRoute & inRoute)
+{
+  mFirstLeg = NULL;
+  mNext = NULL;
+  Leg * l = inRoute.mFirstLeg;
+  Leg * last = NULL;
+  while (l != NULL) {
+    Leg * c = new Leg(*l);
+    if (last == NULL) mFirstLeg = c;
+    else last->mNext = c;
+    last = c;
+    l = l->mNext;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+LegRoute::~LegRoute()
+{
+  Leg * l = mFirstLeg;
+  while (l != NULL) {
+    Leg * current = l;
+    l = l->mNext;
+    delete current;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+Leg * LegRoute::addLeg(const Direction inDir)
+{
+  Leg * leg = new Leg(inDir);
+  if (mFirstLeg == NULL) {
+    mFirstLeg = leg;
+  }
+  else {
+    Leg * l = mFirstLeg;
+    while (l->mNext != NULL) l = l->mNext;
+    l->mNext = leg;
+  }
+  return leg;
+}
+
+/*---------------------------------------------------------------------------*/
+uint8_t LegRoute::legCount() const
+{
+  uint8_t c = 0;
+  Leg * l = mFirstLeg;
+  while (l != NULL) {
+    c++;
+    l = l->mNext;
+  }
+  return c;
+}
+
+/*---------------------------------------------------------------------------*/
+bool LegRoute::operator==(const LegRoute & inRoute) const
+{
+  Leg * l1 = mFirstLeg;
+  Leg * l2 = inRoute.mFirstLeg;
+  while (l1 != NULL && l2 != NULL) {
+    if (l1->mDirection != l2->mDirection || ! (*l1 == *l2)) return false;
+    l1 = l1->mNext;
+    l2 = l2->mNext;
+  }
+  return l1 == NULL && l2 == NULL;
+}
+
+#ifdef DEBUG
+void LegRoute::print()
+{
+  Leg * l = mFirstLeg;
+  while (l != NULL) {
+    displayDirection(l->mDirection);
+    Serial.print(F(": "));
+    l->print();
+    l = l->mNext;
+    if (l != NULL) Serial.print(F("| "));
+  }
+}
+
+void LegRoute::println()
+{
+  print();
+  Serial.println();
+}
+#endif
+
+/*=============================================================================
+ * LegRouteSet
+ */
+void LegRouteSet::clear()
+{
+  LegRoute * r = mListHead;
+  while (r != NULL) {
+    LegRoute * current = r;
+    r = r->mNext;
+    delete current;
+  }
+  mListHead = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+bool LegRouteSet::containsRoute(const LegRoute & inRoute) const
+{
+  LegRoute * r = mListHead;
+  while (r != NULL) {
+    if (*r == inRoute) return true;
+    r = r->mNext;
+  }
+  return false;
+}
+
+/*---------------------------------------------------------------------------*/
+void LegRouteSet::addRoute(const LegRoute & inRoute)
+{
+  if (! containsRoute(inRoute)) {
+    LegRoute * c = new LegRoute(inRoute);
+    c->mNext = mListHead;
+    mListHead = c;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+uint16_t LegRouteSet::count() const
+{
+  uint16_t c = 0;
+  LegRoute * r = mListHead;
+  while (r != NULL) {
+    c++;
+    r = r->mNext;
+  }
+  return c;
+}
+
+#ifdef DEBUG
+void LegRouteSet::print()
+{
+  LegRoute * r = mListHead;
+  Serial.println("================");
+  if (r == NULL) {
+    Serial.println("*   No Route   *");
+  }
+  while (r != NULL) {
+    r->println();
+    r = r->mNext;
+  }
+  Serial.println("================");
+}
+
+void LegRouteSet::println()
+{
+  print();
+  Serial.println();
+}
+#endif
+
+/*=============================================================================
+ * ReversingSearch
+ */
+ReversingSearch::ReversingSearch(const uint8_t inMaxReversals) :
+  mReversingTracks(),
+  mMaxReversals(inMaxReversals),
+  mTarget(0),
+  mStack(NULL),
+  mStackDir(NULL),
+  mStackSize(0),
+  mStackTop(0),
+  mMarking(NULL),
+  mRoutes(NULL)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+bool ReversingSearch::routesTo(
+  Track & inFrom,
+  const uint16_t inId,
+  const Direction inDir,
+  LegRouteSet & ioRoutes)
+{
+  if (! Track::trackNetIsOk()) return false;
+  HEAP_QUERY_SCOPE();
+
+  /* A track is on the stack at most once per way and per direction */
+  mStackSize = Track::count() << 2;
+  uint16_t before = ioRoutes.count();
+  PooledHeadedTrackSet marking;
+  mTarget = inId;
+  mStack = new Track *[mStackSize];
+  mStackDir = new uint8_t[mStackSize];
+  HEAP_ALLOCATED(HEAP_SEARCH, mStackSize * (sizeof(Track *) + sizeof(uint8_t)));
+  mStackTop = 0;
+  mMarking = &*marking;
+  mRoutes = &ioRoutes;
+
+  explore(&inFrom, NULL, inDir, mMaxReversals);
+
+  HEAP_FREED(HEAP_SEARCH, mStackSize * (sizeof(Track *) + sizeof(uint8_t)));
+  delete [] mStack;
+  delete [] mStackDir;
+  mStack = NULL;
+  mStackDir = NULL;
+  mMarking = NULL;
+  mRoutes = NULL;
+  return ioRoutes.count() > before;
+}
+
+/*---------------------------------------------------------------------------*/
+void ReversingSearch::push(Track * inTrack, const Direction inDir)
+{
+  mStack[mStackTop] = inTrack;
+  mStackDir[mStackTop++] = inDir;
+}
+
+/*---------------------------------------------------------------------------*/
+void ReversingSearch::explore(
+  Track * inTrack,
+  const Track * inFrom,
+  const Direction inDir,
+  const uint8_t inReversalsLeft)
+{
+  /* Crossings are not marked since they may be used on both ways */
+  bool marked = (inTrack->entryCount() == 1);
+  if (marked && mMarking->containsTrack(inTrack, inDir)) return;
+  if (mStackTop >= mStackSize) return;
+  if (marked) mMarking->addTrack(inTrack, inDir);
+  push(inTrack, inDir);
+
+  if (inTrack->identifier() == mTarget) {
+    recordRoute();
+  }
+  else {
+    exploreNext(inTrack, inFrom, inDir, inReversalsLeft);
+
+    /*
+     * Reverse here if allowed. The train leaves the way it came in, a
+     * turnout does not send it on another branch, so it goes back on
+     * inFrom in the direction opposite to the one it had there.
+     */
+    Direction back = (inDir == FORWARD_DIRECTION) ?
+      BACKWARD_DIRECTION : FORWARD_DIRECTION;
+    if (inReversalsLeft > 0 && inFrom != NULL && marked &&
+        mReversingTracks.containsTrack(inTrack) &&
+        ! mMarking->containsTrack(inTrack, back) &&
+        mStackTop < mStackSize) {
+      const Direction backOnFrom = (mStackDir[mStackTop - 2] == FORWARD_DIRECTION) ?
+        BACKWARD_DIRECTION : FORWARD_DIRECTION;
+      mMarking->addTrack(inTrack, back);
+      push(inTrack, back);
+      explore((Track *)inFrom, inTrack, backOnFrom, inReversalsLeft - 1);
+      mStackTop--;
+      mMarking->removeTrack(inTrack, back);
+    }
+  }
+
+  mStackTop--;
+  if (marked) mMarking->removeTrack(inTrack, inDir);
+}
+
+/*---------------------------------------------------------------------------*/
+void ReversingSearch::exploreNext(
+  Track * inTrack,
+  const Track * inFrom,
+  const Direction inDir,
+  const uint8_t inReversalsLeft)
+{
+  Track * next[MAX_NEXT_TRACKS];
+  uint8_t count = inTrack->nextTracks(inDir, inFrom, next);
+  for (uint8_t i = 0; i < count; i++) {
+    const Direction nextDir = DirectionSolver::directionAfter(*inTrack, inDir, next, i);
+    explore(next[i], inTrack, nextDir, inReversalsLeft);
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+void ReversingSearch::recordRoute()
+{
+  LegRoute route;
+  Leg * leg = NULL;
+  for (uint16_t i = 0; i < mStackTop; i++) {
+    /*
+     * The train reverses on a track pushed twice in a row. Crossing a
+     * reversing joint swaps the direction within a leg
+     */
+    if (leg == NULL || mStack[i] == mStack[i - 1]) {
+      leg = route.addLeg((Direction)mStackDir[i]);
+    }
+    leg->addTrack(mStack[i]);
+  }
+  mRoutes->addRoute(route);
+}
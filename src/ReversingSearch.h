@@ -0,0 +1,140 @@
+/*
+ * ReversingSearch : search of routes allowing the train to reverse
+ * on designated tracks, like a shunting move in a siding and back out.
+ * A route is made of legs. Each leg is travelled in one direction and
+ * the train reverses on the last track of a leg which is also the first
+ * track of the next one. The next leg leaves by the connector the train
+ * came in, toward the track before the reversal.
+ * The search is done once for all the legs: the marking of the tracks
+ * is indexed by the direction so a track may be used once per
+ * direction.
+ */
+#ifndef __REVERSINGSEARCH_H__
+#define __REVERSINGSEARCH_H__
+
+#include "TrackSet.h"
+#include "HeadedTrackSet.h"
+
+class LegRoute;
+class LegRouteSet;
+
+/*
+ * Part of a route travelled in one direction
+ */
+class Leg : public TrackSet
+{
+  private:
+    Direction mDirection;
+    Leg *mNext; /* To chain */
+    friend class LegRoute;
+
+  public:
+    Leg(const Direction inDir) : TrackSet() { mDirection = inDir; mNext = NULL; }
+    Leg(const Leg & inLeg) : TrackSet(inLeg) { mDirection = inLeg.mDirection; mNext = NULL; }
+    Direction direction() const { return mDirection; }
+    Leg * next() const { return mNext; }
+};
+
+/*
+ * Route made of legs
+ */
+class LegRoute
+{
+  private:
+    Leg *mFirstLeg;
+    LegRoute *mNext; /* To chain */
+    friend class LegRouteSet;
+
+  public:
+    LegRoute() { mFirstLeg = NULL; mNext = NULL; }
+    LegRoute(const LegRoute & inRoute);
+    ~LegRoute();
+    /* Append a leg at the end of the route and return it */
+    Leg * addLeg(const Direction inDir);
+    Leg * firstLeg() const { return mFirstLeg; }
+    uint8_t legCount() const;
+    bool operator==(const LegRoute & inRoute) const;
+#ifdef DEBUG
+    void print();
+    void println();
+#endif
+};
+
+/*
+ * Set of routes with legs
+ */
+class LegRouteSet
+{
+  private:
+    LegRoute *mListHead;
+
+    void clear();
+
+  public:
+    LegRouteSet() { mListHead = NULL; }
+    ~LegRouteSet() { clear(); }
+    /* Add a copy of inRoute if not already in the set */
+    void addRoute(const LegRoute & inRoute);
+    bool containsRoute(const LegRoute & inRoute) const;
+    LegRoute * firstRoute() const { return mListHead; }
+    LegRoute * nextRoute(const LegRoute * inRoute) const { return inRoute->mNext; }
+    uint16_t count() const;
+#ifdef DEBUG
+    void print();
+    void println();
+#endif
+};
+
+class ReversingSearch
+{
+  private:
+    TrackSet mReversingTracks; /* Tracks where the train may reverse */
+    uint8_t mMaxReversals;     /* Maximum number of reversals        */
+    /* Working data of a search */
+    uint16_t mTarget;
+    Track **mStack;            /* Tracks of the route being built    */
+    uint8_t *mStackDir;        /* and their travel direction         */
+    uint16_t mStackSize;
+    uint16_t mStackTop;
+    HeadedTrackSet *mMarking;
+    LegRouteSet *mRoutes;
+
+    void explore(
+      Track * inTrack,
+      const Track * inFrom,
+      const Direction inDir,
+      const uint8_t inReversalsLeft
+    );
+    void exploreNext(
+      Track * inTrack,
+      const Track * inFrom,
+      const Direction inDir,
+      const uint8_t inReversalsLeft
+    );
+    void push(Track * inTrack, const Direction inDir);
+    void recordRoute();
+
+  public:
+    /*
+     * Must be built after all the tracks are declared since it holds
+     * a TrackSet.
+     */
+    ReversingSearch(const uint8_t inMaxReversals);
+    void allowReversalAt(const uint16_t inId) { mReversingTracks.addTrack(inId); }
+    void allowReversalAt(Track & inTrack) { mReversingTracks.addTrack(inTrack); }
+    void forbidReversalAt(const uint16_t inId) { mReversingTracks.removeTrack(inId); }
+    void forbidReversalAt(Track & inTrack) { mReversingTracks.removeTrack(inTrack); }
+    void setMaxReversals(const uint8_t inMaxReversals) { mMaxReversals = inMaxReversals; }
+    /*
+     * Find the routes from inFrom to track inId starting in direction
+     * inDir. Return true if at least one route has been found.
+     */
+    bool routesTo(
+      Track & inFrom,
+      const uint16_t inId,
+      const Direction inDir,
+      LegRouteSet & ioRoutes
+    );
+};
+
+#endif /* __REVERSINGSEARCH_H__ */
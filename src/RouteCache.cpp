@@ -0,0 +1,300 @@
+/*
+ * RouteCache : routes of the last queries, kept in a memory of bounded
+ * size and given again without searching.
+ */
+#include "RouteCache.h"
+#include "HeapStats.h"
+
+#define MAX_BUCKET_COUNT 4096
+
+/*
+ * The hash table takes at most a 16th of the capacity
+ */
+static uint16_t bucketCountFor(const uint32_t inCapacity)
+{
+  uint16_t count = 1;
+  while (count < MAX_BUCKET_COUNT &&
+         (uint32_t)(count << 1) * sizeof(RouteCacheEntry *) <= (inCapacity >> 4)) {
+    count <<= 1;
+  }
+  return count;
+}
+
+/* Avoided tracks then routes, after the header */
+static uint8_t * dataOf(const RouteCacheEntry * inEntry)
+{
+  return (uint8_t *)(inEntry + 1);
+}
+
+/*---------------------------------------------------------------------------*/
+RouteCache::RouteCache(const uint32_t inCapacity) :
+  mBuckets(NULL),
+  mBucketCount(bucketCountFor(inCapacity)),
+  mNewest(NULL),
+  mOldest(NULL),
+  mCapacity(inCapacity),
+  mBytes(0),
+  mEntryCount(0),
+  mHits(0),
+  mMisses(0),
+  mEvictions(0)
+{
+  const uint32_t tableSize = (uint32_t)mBucketCount * sizeof(RouteCacheEntry *);
+  if (tableSize > mCapacity) return;
+  mBuckets = (RouteCacheEntry **)malloc(tableSize);
+  if (mBuckets == NULL) return;
+  HEAP_ALLOCATED(HEAP_CACHE, tableSize);
+  for (uint16_t b = 0; b < mBucketCount; b++) mBuckets[b] = NULL;
+  mBytes = tableSize;
+}
+
+/*---------------------------------------------------------------------------*/
+RouteCache::~RouteCache()
+{
+  clear();
+  if (mBuckets != NULL) {
+    HEAP_FREED(HEAP_CACHE, mBytes);
+    free(mBuckets);
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+uint32_t RouteCache::entrySize(const RouteCacheEntry * inEntry)
+{
+  return sizeof(RouteCacheEntry) + inEntry->avoidedSize +
+         (uint32_t)inEntry->routeCount * Track::sizeForSet();
+}
+
+/*---------------------------------------------------------------------------*/
+uint16_t RouteCache::bucketOf(
+  const uint16_t inOrigin,
+  const uint16_t inTarget,
+  const Direction inDir,
+  const uint32_t inState) const
+{
+  uint32_t hash = ((uint32_t)inOrigin << 16) ^ inTarget ^ ((uint32_t)inDir << 15);
+  hash ^= inState;
+  hash ^= hash >> 16;
+  hash *= 0x45D9F3BUL;
+  hash ^= hash >> 16;
+  return hash & (mBucketCount - 1);
+}
+
+/*---------------------------------------------------------------------------*/
+RouteCacheEntry * RouteCache::lookup(
+  const uint16_t inOrigin,
+  const uint16_t inTarget,
+  const Direction inDir,
+  const uint32_t inState,
+  const TrackSet * inAvoided,
+  const bool inByCaller)
+{
+  if (mBuckets == NULL) return NULL;
+  const uint8_t avoidedSize = (inAvoided == NULL) ? 0 : Track::sizeForSet();
+  RouteCacheEntry * entry = mBuckets[bucketOf(inOrigin, inTarget, inDir, inState)];
+  for (; entry != NULL; entry = entry->chain) {
+    if (entry->origin != inOrigin || entry->target != inTarget ||
+        entry->direction != inDir || entry->state != inState ||
+        entry->avoidedSize != avoidedSize || entry->byCaller != inByCaller) {
+      continue;
+    }
+    uint8_t i = 0;
+    while (i < avoidedSize && dataOf(entry)[i] == inAvoided->byteAt(i)) i++;
+    if (i == avoidedSize) return entry;
+  }
+  return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteCache::unlink(RouteCacheEntry * inEntry)
+{
+  if (inEntry->newer != NULL) inEntry->newer->older = inEntry->older;
+  else mNewest = inEntry->older;
+  if (inEntry->older != NULL) inEntry->older->newer = inEntry->newer;
+  else mOldest = inEntry->newer;
+  inEntry->newer = inEntry->older = NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteCache::remove(RouteCacheEntry * inEntry)
+{
+  unlink(inEntry);
+  RouteCacheEntry ** link = &mBuckets[bucketOf(inEntry->origin, inEntry->target,
+                                               (Direction)inEntry->direction,
+                                               inEntry->state)];
+  while (*link != inEntry) link = &(*link)->chain;
+  *link = inEntry->chain;
+  const uint32_t size = entrySize(inEntry);
+  HEAP_FREED(HEAP_CACHE, size);
+  free(inEntry);
+  mBytes -= size;
+  mEntryCount--;
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteCache::insert(
+  const uint16_t inOrigin,
+  const uint16_t inTarget,
+  const Direction inDir,
+  const uint32_t inState,
+  const TrackSet * inAvoided,
+  const bool inByCaller,
+  PathSet & inPaths,
+  const bool inFound)
+{
+  if (mBuckets == NULL) return;
+  const uint8_t setSize = Track::sizeForSet();
+  const uint8_t avoidedSize = (inAvoided == NULL) ? 0 : setSize;
+  const uint16_t routeCount = inPaths.count();
+  const uint32_t size = sizeof(RouteCacheEntry) + avoidedSize + (uint32_t)routeCount * setSize;
+  /* Too large to be kept, even alone */
+  if (size + (uint32_t)mBucketCount * sizeof(RouteCacheEntry *) > mCapacity) return;
+  while (mOldest != NULL && mBytes + size > mCapacity) {
+    remove(mOldest);
+    mEvictions++;
+  }
+
+  RouteCacheEntry * entry = (RouteCacheEntry *)malloc(size);
+  if (entry == NULL) return;
+  HEAP_ALLOCATED(HEAP_CACHE, size);
+  entry->state = inState;
+  entry->origin = inOrigin;
+  entry->target = inTarget;
+  entry->routeCount = routeCount;
+  entry->direction = inDir;
+  entry->avoidedSize = avoidedSize;
+  entry->found = inFound;
+  entry->byCaller = inByCaller;
+  uint8_t * data = dataOf(entry);
+  for (uint8_t i = 0; i < avoidedSize; i++) *data++ = inAvoided->byteAt(i);
+  for (Path * p = inPaths.firstPath(); p != NULL; p = p->next()) {
+    if (p->isEmpty()) continue;
+    for (uint8_t i = 0; i < setSize; i++) *data++ = p->byteAt(i);
+  }
+
+  RouteCacheEntry ** bucket = &mBuckets[bucketOf(inOrigin, inTarget, inDir, inState)];
+  entry->chain = *bucket;
+  *bucket = entry;
+  entry->older = mNewest;
+  entry->newer = NULL;
+  if (mNewest != NULL) mNewest->newer = entry;
+  else mOldest = entry;
+  mNewest = entry;
+  mBytes += size;
+  mEntryCount++;
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteCache::give(RouteCacheEntry * inEntry, PathSet & ioPaths)
+{
+  /* The most recently used */
+  if (inEntry != mNewest) {
+    unlink(inEntry);
+    inEntry->older = mNewest;
+    mNewest->newer = inEntry;
+    mNewest = inEntry;
+  }
+  const uint8_t setSize = Track::sizeForSet();
+  const uint8_t * data = dataOf(inEntry) + inEntry->avoidedSize;
+  TrackSet route;
+  for (uint16_t r = 0; r < inEntry->routeCount; r++) {
+    for (uint8_t i = 0; i < setSize; i++) route.setByteAt(i, *data++);
+    ioPaths.addPath(route);
+  }
+  return inEntry->found;
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteCache::pathsTo(
+  Track & inFrom,
+  const uint16_t inId,
+  const Direction inDir,
+  PathSet & ioPaths)
+{
+  RouteCacheEntry * entry = lookup(inFrom.identifier(), inId, inDir, 0, NULL, false);
+  if (entry != NULL) {
+    mHits++;
+    return give(entry, ioPaths);
+  }
+  mMisses++;
+  /* Only the routes of the query are kept, not those already in ioPaths */
+  PathSet routes;
+  const bool found = inFrom.pathsTo(inId, inDir, routes);
+  insert(inFrom.identifier(), inId, inDir, 0, NULL, false, routes, found);
+  ioPaths += routes;
+  return found;
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteCache::pathsAvoiding(
+  Track & inFrom,
+  const uint16_t inId,
+  const Direction inDir,
+  const TrackSet & inAvoided,
+  PathSet & ioPaths)
+{
+  /* The avoided tracks are compared, the state only spreads the buckets */
+  uint32_t state = 2166136261UL;
+  for (uint8_t i = 0; i < Track::sizeForSet(); i++) {
+    state = (state ^ inAvoided.byteAt(i)) * 16777619UL;
+  }
+  RouteCacheEntry * entry = lookup(inFrom.identifier(), inId, inDir, state, &inAvoided, false);
+  if (entry != NULL) {
+    mHits++;
+    return give(entry, ioPaths);
+  }
+  mMisses++;
+
+  PathSet routes;
+  inFrom.pathsTo(inId, inDir, routes);
+  PathSet kept;
+  bool found = false;
+  for (Path * p = routes.firstPath(); p != NULL; p = p->next()) {
+    if (p->isEmpty()) continue;
+    uint8_t i = 0;
+    while (i < Track::sizeForSet() && (p->byteAt(i) & inAvoided.byteAt(i)) == 0) i++;
+    if (i < Track::sizeForSet()) continue;
+    kept.addPath(*p);
+    found = true;
+  }
+  insert(inFrom.identifier(), inId, inDir, state, &inAvoided, false, kept, found);
+  ioPaths += kept;
+  return found;
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteCache::find(
+  const uint16_t inOrigin,
+  const uint16_t inTarget,
+  const Direction inDir,
+  const uint32_t inState,
+  PathSet & ioPaths)
+{
+  RouteCacheEntry * entry = lookup(inOrigin, inTarget, inDir, inState, NULL, true);
+  if (entry == NULL) {
+    mMisses++;
+    return false;
+  }
+  mHits++;
+  give(entry, ioPaths);
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteCache::store(
+  const uint16_t inOrigin,
+  const uint16_t inTarget,
+  const Direction inDir,
+  const uint32_t inState,
+  PathSet & inPaths)
+{
+  RouteCacheEntry * entry = lookup(inOrigin, inTarget, inDir, inState, NULL, true);
+  if (entry != NULL) remove(entry);
+  insert(inOrigin, inTarget, inDir, inState, NULL, true, inPaths, inPaths.count() > 0);
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteCache::clear()
+{
+  while (mOldest != NULL) remove(mOldest);
+}
@@ -0,0 +1,134 @@
+/*
+ * RouteCache : routes of the last queries, kept in a memory of bounded
+ * size and given again without searching.
+ *
+ * A dispatcher asks the same routes again and again, and the routes of
+ * every pair of tracks do not fit in memory on a large layout. The cache
+ * keeps the routes of a query by its origin, target, direction and a
+ * state given by the caller. The routes are stored as their bit vectors,
+ * Track::sizeForSet() bytes each, after a header of about 20 bytes on
+ * AVR and 40 on the host.
+ *
+ * pathsAvoiding() searches the routes going through none of a set of
+ * tracks, the locked or out of service ones for instance. The set is the
+ * state of the query and is kept with the routes, so a query with
+ * another set is searched again. find() and store() keep routes found
+ * by the caller under a state of its own, the positions of the turnouts
+ * for instance. They are apart from the searched queries, whatever the
+ * state.
+ *
+ * The size of the cache, headers, routes and hash table, stays under
+ * the capacity given in bytes. The least recently used query is evicted
+ * to make room for a new one, in constant time. A query is found in
+ * constant time on average. The cache must be cleared when the track net
+ * changes.
+ *
+ *   RouteCache itineraires(4096);
+ *   itineraires.pathsTo(voie23, voie1_id, FORWARD_DIRECTION, paths);
+ */
+#ifndef __ROUTECACHE_H__
+#define __ROUTECACHE_H__
+
+#include "PathSet.h"
+
+#ifndef ROUTE_CACHE_CAPACITY
+#ifdef __AVR__
+#define ROUTE_CACHE_CAPACITY 512
+#else
+#define ROUTE_CACHE_CAPACITY 1048576
+#endif
+#endif
+
+/*
+ * Query kept in the cache, followed by the avoided tracks if any, then
+ * by the routes
+ */
+typedef struct RouteCacheEntry {
+  struct RouteCacheEntry *newer;  /* Least recently used list        */
+  struct RouteCacheEntry *older;
+  struct RouteCacheEntry *chain;  /* Next entry of the hash bucket   */
+  uint32_t state;
+  uint16_t origin;
+  uint16_t target;
+  uint16_t routeCount;
+  uint8_t direction;
+  uint8_t avoidedSize;            /* Bytes of the avoided tracks     */
+  bool found;                     /* Returned by Track::pathsTo      */
+  bool byCaller;                  /* Kept by store(), not searched   */
+} RouteCacheEntry;
+
+class RouteCache
+{
+  private:
+    RouteCacheEntry **mBuckets;
+    uint16_t mBucketCount;          /* A power of 2                  */
+    RouteCacheEntry *mNewest;
+    RouteCacheEntry *mOldest;
+    uint32_t mCapacity;
+    uint32_t mBytes;
+    uint16_t mEntryCount;
+    uint32_t mHits;
+    uint32_t mMisses;
+    uint32_t mEvictions;
+
+    static uint32_t entrySize(const RouteCacheEntry * inEntry);
+    uint16_t bucketOf(const uint16_t inOrigin, const uint16_t inTarget,
+                      const Direction inDir, const uint32_t inState) const;
+    RouteCacheEntry * lookup(const uint16_t inOrigin, const uint16_t inTarget,
+                             const Direction inDir, const uint32_t inState,
+                             const TrackSet * inAvoided, const bool inByCaller);
+    void unlink(RouteCacheEntry * inEntry);
+    void remove(RouteCacheEntry * inEntry);
+    void insert(const uint16_t inOrigin, const uint16_t inTarget,
+                const Direction inDir, const uint32_t inState,
+                const TrackSet * inAvoided, const bool inByCaller,
+                PathSet & inPaths, const bool inFound);
+    bool give(RouteCacheEntry * inEntry, PathSet & ioPaths);
+
+  public:
+    RouteCache(const uint32_t inCapacity = ROUTE_CACHE_CAPACITY);
+    ~RouteCache();
+
+    /* Track::pathsTo() through the cache */
+    bool pathsTo(Track & inFrom, const uint16_t inId, const Direction inDir, PathSet & ioPaths);
+    /* Routes of Track::pathsTo() going through none of inAvoided */
+    bool pathsAvoiding(
+      Track & inFrom,
+      const uint16_t inId,
+      const Direction inDir,
+      const TrackSet & inAvoided,
+      PathSet & ioPaths
+    );
+    /*
+     * Routes kept for a query and a state of the caller, added to
+     * ioPaths. Return false if the query is not in the cache.
+     */
+    bool find(
+      const uint16_t inOrigin,
+      const uint16_t inTarget,
+      const Direction inDir,
+      const uint32_t inState,
+      PathSet & ioPaths
+    );
+    /* Keep the routes found for a query and a state of the caller */
+    void store(
+      const uint16_t inOrigin,
+      const uint16_t inTarget,
+      const Direction inDir,
+      const uint32_t inState,
+      PathSet & inPaths
+    );
+    /* Forget every query, the counters are kept */
+    void clear();
+    void resetCounters() { mHits = mMisses = mEvictions = 0; }
+
+    uint32_t hits() const { return mHits; }
+    uint32_t misses() const { return mMisses; }
+    uint32_t evictions() const { return mEvictions; }
+    uint16_t entryCount() const { return mEntryCount; }
+    /* Bytes used, the hash table included, never above the capacity */
+    uint32_t bytes() const { return mBytes; }
+    uint32_t capacity() const { return mCapacity; }
+};
+
+#endif /* __ROUTECACHE_H__ */
@@ -0,0 +1,250 @@
+/*
+ * RouteProtocol : binary protocol to query routes over a serial line.
+ */
+#include "RouteProtocol.h"
+#include "PathSet.h"
+#include "RouteCache.h"
+
+#define QUERY_LENGTH 5
+
+/*---------------------------------------------------------------------------*/
+RouteProtocol::RouteProtocol(HardwareSerial & inSerial) :
+  mSerial(inSerial),
+  mState(WAIT_SYNC),
+  mType(0),
+  mLength(0),
+  mIndex(0),
+  mCrc(0),
+  mReceivedCrc(0),
+  mQueueHead(0),
+  mQueueCount(0),
+  mSendCrc(0),
+  mCache(NULL)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+uint16_t RouteProtocol::crc(uint16_t inCrc, const uint8_t inByte)
+{
+  inCrc ^= (uint16_t)inByte << 8;
+  for (uint8_t i = 0; i < 8; i++) {
+    if (inCrc & 0x8000) inCrc = (inCrc << 1) ^ 0x1021;
+    else                inCrc <<= 1;
+  }
+  return inCrc;
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteProtocol::receive(const uint8_t inByte)
+{
+  bool queued = false;
+
+  switch (mState) {
+    case WAIT_SYNC:
+      if (inByte == ROUTE_PROTOCOL_SYNC) {
+        mCrc = 0xFFFF;
+        mState = GET_TYPE;
+      }
+      break;
+
+    case GET_TYPE:
+      if (inByte != ROUTE_QUERY_FRAME) resynchronize(inByte);
+      else {
+        mType = inByte;
+        mCrc = crc(mCrc, inByte);
+        mState = GET_SEQ;
+      }
+      break;
+
+    case GET_SEQ:
+      mPending.seq = inByte;
+      mCrc = crc(mCrc, inByte);
+      mState = GET_LENGTH_LOW;
+      break;
+
+    case GET_LENGTH_LOW:
+      if (inByte != QUERY_LENGTH) resynchronize(inByte);
+      else {
+        mLength = inByte;
+        mCrc = crc(mCrc, inByte);
+        mState = GET_LENGTH_HIGH;
+      }
+      break;
+
+    case GET_LENGTH_HIGH:
+      if (inByte != 0) resynchronize(inByte);
+      else {
+        mCrc = crc(mCrc, inByte);
+        mIndex = 0;
+        mState = GET_PAYLOAD;
+      }
+      break;
+
+    case GET_PAYLOAD:
+      /* Fields are decoded as they come */
+      mCrc = crc(mCrc, inByte);
+      switch (mIndex++) {
+        case 0: mPending.origin = inByte;                  break;
+        case 1: mPending.origin |= (uint16_t)inByte << 8;  break;
+        case 2: mPending.target = inByte;                  break;
+        case 3: mPending.target |= (uint16_t)inByte << 8;  break;
+        case 4: mPending.direction = inByte;               break;
+      }
+      if (mIndex == mLength) mState = GET_CRC_LOW;
+      break;
+
+    case GET_CRC_LOW:
+      mReceivedCrc = inByte;
+      mState = GET_CRC_HIGH;
+      break;
+
+    case GET_CRC_HIGH:
+      mReceivedCrc |= (uint16_t)inByte << 8;
+      mState = WAIT_SYNC;
+      if (mReceivedCrc == mCrc) {
+        frameReceived();
+        queued = true;
+      }
+      break;
+  }
+  return queued;
+}
+
+/*
+ * A query is only 5 bytes long so the header is checked as it comes.
+ * When a wrong byte is a sync byte it may start the next frame.
+ */
+void RouteProtocol::resynchronize(const uint8_t inByte)
+{
+  if (inByte == ROUTE_PROTOCOL_SYNC) {
+    mCrc = 0xFFFF;
+    mState = GET_TYPE;
+  }
+  else mState = WAIT_SYNC;
+}
+
+/*---------------------------------------------------------------------------*/
+uint8_t RouteProtocol::receive(const uint8_t * inBuffer, const uint16_t inLength)
+{
+  uint8_t queued = 0;
+  for (uint16_t i = 0; i < inLength; i++) {
+    if (receive(inBuffer[i])) queued++;
+  }
+  return queued;
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteProtocol::frameReceived()
+{
+  if (mQueueCount < ROUTE_PROTOCOL_QUEUE_SIZE) {
+    uint8_t tail = (mQueueHead + mQueueCount) % ROUTE_PROTOCOL_QUEUE_SIZE;
+    mQueue[tail] = mPending;
+    mQueueCount++;
+  }
+  else {
+    answerStatus(mPending.seq, ROUTE_BUSY);
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteProtocol::answerNext()
+{
+  if (mQueueCount == 0) return false;
+  RouteQuery query = mQueue[mQueueHead];
+  mQueueHead = (mQueueHead + 1) % ROUTE_PROTOCOL_QUEUE_SIZE;
+  mQueueCount--;
+  answer(query);
+  return true;
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteProtocol::serve()
+{
+  while (mSerial.available() > 0) {
+    receive((uint8_t)mSerial.read());
+  }
+  answerNext();
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteProtocol::sendByte(const uint8_t inByte)
+{
+  mSendCrc = crc(mSendCrc, inByte);
+  mSerial.write(inByte);
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteProtocol::sendWord(const uint16_t inWord)
+{
+  sendByte(inWord & 0xFF);
+  sendByte(inWord >> 8);
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteProtocol::beginAnswer(const uint8_t inSeq, const uint16_t inLength)
+{
+  mSerial.write((uint8_t)ROUTE_PROTOCOL_SYNC);
+  mSendCrc = 0xFFFF;
+  sendByte(ROUTE_ANSWER_FRAME);
+  sendByte(inSeq);
+  sendWord(inLength);
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteProtocol::endAnswer()
+{
+  uint16_t frameCrc = mSendCrc;
+  mSerial.write((uint8_t)(frameCrc & 0xFF));
+  mSerial.write((uint8_t)(frameCrc >> 8));
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteProtocol::answerStatus(const uint8_t inSeq, const RouteStatus inStatus)
+{
+  beginAnswer(inSeq, 4);
+  sendByte(inStatus);
+  sendWord(0);
+  sendByte(Track::sizeForSet());
+  endAnswer();
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteProtocol::answer(const RouteQuery & inQuery)
+{
+  if (! Track::trackNetIsOk()) {
+    answerStatus(inQuery.seq, ROUTE_BAD_NET);
+    return;
+  }
+  if (inQuery.origin >= Track::count() ||
+      inQuery.target >= Track::count() ||
+      inQuery.direction > BACKWARD_DIRECTION) {
+    answerStatus(inQuery.seq, ROUTE_BAD_TRACK);
+    return;
+  }
+
+  PathSet paths;
+  Track & origin = Track::trackForId(inQuery.origin);
+  if (mCache != NULL) {
+    mCache->pathsTo(origin, inQuery.target, (Direction)inQuery.direction, paths);
+  }
+  else {
+    origin.pathsTo(inQuery.target, (Direction)inQuery.direction, paths);
+  }
+  uint16_t count = paths.count();
+  uint8_t size = Track::sizeForSet();
+  uint32_t length = 4 + (uint32_t)count * size;
+  if (length > 0xFFFF) {
+    answerStatus(inQuery.seq, ROUTE_TOO_MANY);
+    return;
+  }
+
+  beginAnswer(inQuery.seq, length);
+  sendByte(ROUTE_OK);
+  sendWord(count);
+  sendByte(size);
+  for (Path * p = paths.firstPath(); p != NULL; p = p->next()) {
+    if (p->isEmpty()) continue;
+    for (uint8_t i = 0; i < size; i++) sendByte(p->byteAt(i));
+  }
+  endAnswer();
+}
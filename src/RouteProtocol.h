@@ -0,0 +1,112 @@
+/*
+ * RouteProtocol : binary protocol to query routes over a serial line.
+ *
+ * Frame: 0x7E | type | seq | len (2) | payload (len) | crc (2)
+ * 16 bits values are little endian. The crc is a CRC16-CCITT (0x1021,
+ * initial value 0xFFFF) of the bytes from type to the end of payload.
+ *
+ * Query (type 0x01), payload of 5 bytes:
+ *   origin id (2) | target id (2) | direction (1)
+ * Answer (type 0x81), same seq as the query:
+ *   status (1) | route count (2) | route size (1) | routes
+ * Each route is a TrackSet bit vector of route size bytes.
+ *
+ * Queries are decoded byte by byte as they are received, without being
+ * copied in a frame buffer, and queued. Several queries may be sent
+ * without waiting for the answers, the seq tells which query an answer
+ * belongs to. serve() answers one query per call so that loop() is not
+ * blocked for long. With a RouteCache given by setCache(), the routes
+ * asked again are answered from the cache.
+ */
+#ifndef __ROUTEPROTOCOL_H__
+#define __ROUTEPROTOCOL_H__
+
+#include "HardwareSerial.h"
+#include "Track.h"
+
+class RouteCache;
+
+#ifndef ROUTE_PROTOCOL_QUEUE_SIZE
+#define ROUTE_PROTOCOL_QUEUE_SIZE 4
+#endif
+
+#define ROUTE_PROTOCOL_SYNC   0x7E
+#define ROUTE_QUERY_FRAME     0x01
+#define ROUTE_ANSWER_FRAME    0x81
+
+/*
+ * Status of an answer
+ */
+typedef enum {
+  ROUTE_OK,
+  ROUTE_BAD_TRACK,
+  ROUTE_BAD_NET,
+  ROUTE_BUSY,
+  ROUTE_TOO_MANY,
+  ROUTE_BAD_QUERY
+} RouteStatus;
+
+/*
+ * Query waiting for its answer
+ */
+typedef struct {
+  uint8_t seq;
+  uint16_t origin;
+  uint16_t target;
+  uint8_t direction;
+} RouteQuery;
+
+class RouteProtocol
+{
+  private:
+    typedef enum {
+      WAIT_SYNC,
+      GET_TYPE,
+      GET_SEQ,
+      GET_LENGTH_LOW,
+      GET_LENGTH_HIGH,
+      GET_PAYLOAD,
+      GET_CRC_LOW,
+      GET_CRC_HIGH
+    } ParserState;
+
+    HardwareSerial & mSerial;
+    ParserState mState;
+    uint8_t mType;
+    uint16_t mLength;
+    uint16_t mIndex;          /* Index of the payload byte received */
+    uint16_t mCrc;            /* Crc of the received frame          */
+    uint16_t mReceivedCrc;
+    RouteQuery mPending;      /* Query being received               */
+    RouteQuery mQueue[ROUTE_PROTOCOL_QUEUE_SIZE];
+    uint8_t mQueueHead;
+    uint8_t mQueueCount;
+    uint16_t mSendCrc;        /* Crc of the frame being sent        */
+    RouteCache *mCache;       /* NULL if the routes are not kept    */
+
+    void resynchronize(const uint8_t inByte);
+    void frameReceived();
+    void beginAnswer(const uint8_t inSeq, const uint16_t inLength);
+    void sendByte(const uint8_t inByte);
+    void sendWord(const uint16_t inWord);
+    void endAnswer();
+    void answer(const RouteQuery & inQuery);
+    void answerStatus(const uint8_t inSeq, const RouteStatus inStatus);
+
+  public:
+    RouteProtocol(HardwareSerial & inSerial);
+    static uint16_t crc(uint16_t inCrc, const uint8_t inByte);
+    /* Decode a received byte. Return true when a query has been queued */
+    bool receive(const uint8_t inByte);
+    /* Decode the bytes of a buffer in place */
+    uint8_t receive(const uint8_t * inBuffer, const uint16_t inLength);
+    uint8_t pendingCount() const { return mQueueCount; }
+    /* Answer the oldest query. Return false if there is none */
+    bool answerNext();
+    /* Read the serial line and answer one query */
+    void serve();
+    /* Answer through inCache, NULL to search every route again */
+    void setCache(RouteCache * inCache) { mCache = inCache; }
+};
+
+#endif /* __ROUTEPROTOCOL_H__ */
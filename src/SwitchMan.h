@@ -3,11 +3,23 @@
 
 #include "Arduino.h"
 #include "Track.h"
+#include "TrackNames.h"
 #include "TrackSet.h"
 #include "PathSet.h"
 #include "HeadedTrackSet.h"
+#include "BlockChain.h"
+#include "ReachabilityIndex.h"
+#include "ReversingSearch.h"
+#include "RouteProtocol.h"
+#include "PathSearch.h"
+#include "BatchSearch.h"
+#include "Profile.h"
+#include "HeapStats.h"
+#include "LayoutReport.h"
+#include "DirectionSolver.h"
+#include "RouteCache.h"
 
-#ifdef DEBUG
+#ifdef SWITCHMAN_TRACK_NAMES
 
 #define TRACK(tracktype,trackname) \
 static const uint16_t trackname##_id = __COUNTER__; \
@@ -22,4 +34,31 @@ tracktype trackname(trackname##_id);
 
 #endif
 
+/*
+ * With SWITCHMAN_STATIC_TRACK_TABLE, the track table is an array sized
+ * at compile time instead of being allocated in the heap. TRACK_TABLE()
+ * must then be written once, after the last TRACK() of the sketch.
+ */
+#ifdef SWITCHMAN_STATIC_TRACK_TABLE
+
+#ifdef SWITCHMAN_TRACK_NAMES
+#define TRACK_NAME_TABLE() \
+NameOffset switchmanTrackNameTable[ \
+  sizeof(switchmanTrackTable) / sizeof(switchmanTrackTable[0])];
+#else
+#define TRACK_NAME_TABLE()
+#endif
+
+#define TRACK_TABLE() \
+Track * switchmanTrackTable[__COUNTER__]; \
+extern const uint16_t switchmanTrackTableSize = \
+  sizeof(switchmanTrackTable) / sizeof(switchmanTrackTable[0]); \
+TRACK_NAME_TABLE()
+
+#else
+
+#define TRACK_TABLE()
+
+#endif
+
 #endif /* __SWITCHMAN_H__ */
@@ -1,6 +1,13 @@
 #include "Track.h"
 #include "PathSet.h"
 #include "HeadedTrackSet.h"
+#include "BlockChain.h"
+#include "ReachabilityIndex.h"
+#include "PathSearch.h"
+#include "Profile.h"
+#include "HeapStats.h"
+#include "LayoutReport.h"
+#include "DirectionSolver.h"
 
 #ifdef DEBUG
 /*
@@ -85,6 +92,11 @@ void displayTrackConnector(const Track * inTrack, const Connector inConnector)
   Serial.println(')');
 }
 
+#endif
+
+/* Trace of the exploration of the recursive search */
+#ifdef TRACE
+
 static uint16_t gDepth = 0;
 
 void depthDisplayTrack(const Track * inTrack)
@@ -120,7 +132,7 @@ displayTrackConnector(obj,connector);
 
 #else
 
-#define BAD_CONNECTOR_ERROR(message,connector)
+#define BAD_CONNECTOR_ERROR(message,obj,connector)
 #define USED_CONNECTOR_ERROR(message,obj,connector)
 
 #endif
@@ -131,75 +143,188 @@ displayTrackConnector(obj,connector);
  * Track
  */
 uint16_t Track::sCount = 0;
+uint16_t Track::sErrorCount = 0;
+#ifdef SWITCHMAN_STATIC_TRACK_TABLE
+/* Defined by TRACK_TABLE() in the sketch, after the tracks */
+extern Track * switchmanTrackTable[];
+extern const uint16_t switchmanTrackTableSize;
+uint16_t Track::sTrackTableSize = 0;
+Track **Track::sTracks = switchmanTrackTable;
+#else
 uint16_t Track::sTrackTableSize = 16;
 Track **Track::sTracks = NULL;
-uint16_t Track::sErrorCount = 0;
+#endif
 
 /*---------------------------------------------------------------------------*/
 Track::Track(NAME_DECL_FIRST(inName) const uint16_t inId) :
-#ifdef DEBUG
-  mName(inName),
-#endif
   mIdentifier(inId),
   mDirection(NO_DIRECTION)
 {
+#ifdef SWITCHMAN_PACKED_TRACKS
+  /* The links to it would not hold its identifier */
+  if (mIdentifier >= NO_TRACK_INDEX) incErrorCount();
+#endif
+#ifdef SWITCHMAN_STATIC_TRACK_TABLE
+  /* The table is already there, its size is known at compile time */
+  if (mIdentifier >= switchmanTrackTableSize) {
+    incErrorCount();
+    return;
+  }
+  sCount++;
+  if (mIdentifier >= sTrackTableSize) sTrackTableSize = mIdentifier + 1;
+#else
   if (sTracks == NULL) {
     sTracks = (Track **)malloc(sTrackTableSize * sizeof(Track **));
+    /* Identifiers not given stay NULL, see finalize() */
+    memset(sTracks, 0, sTrackTableSize * sizeof(Track **));
   }
 
   sCount++;
 
   if (mIdentifier >= sTrackTableSize) {
-    sTrackTableSize = sTrackTableSize * 2;
-    sTracks = (Track **)realloc(sTracks, sTrackTableSize * sizeof(Track **));
+    uint16_t size = (sTrackTableSize == 0) ? 16 : sTrackTableSize;
+    while (mIdentifier >= size) size = size * 2;
+    sTracks = (Track **)realloc(sTracks, size * sizeof(Track **));
+    memset(sTracks + sTrackTableSize, 0, (size - sTrackTableSize) * sizeof(Track **));
+    sTrackTableSize = size;
   }
+#endif
 
+  /* 2 tracks with the same identifier */
+  if (sTracks[mIdentifier] != NULL) incErrorCount();
   sTracks[mIdentifier] = this;
+#ifdef SWITCHMAN_TRACK_NAMES
+  TrackNames::add(mIdentifier, inName);
+#endif
 }
 
 /*---------------------------------------------------------------------------*/
 void Track::finalize()
 {
-  if (sTrackTableSize > sCount) {
-    sTrackTableSize = sCount;
+#ifndef SWITCHMAN_STATIC_TRACK_TABLE
+  /* Shrink the table to the highest identifier */
+  if (sTracks == NULL) sTrackTableSize = 0;
+  uint16_t size = sTrackTableSize;
+  while (size > 0 && sTracks[size - 1] == NULL) size--;
+  if (size > 0 && size < sTrackTableSize) {
+    sTrackTableSize = size;
     sTracks = (Track **)realloc(sTracks, sTrackTableSize * sizeof(Track **));
   }
-  /* Check the track net */
+#endif
+  /* Make the directions agree, reversing loops get a joint */
+  if (! DirectionSolver::solve()) incErrorCount();
+  /*
+   * Check the track net, LayoutReport tells what is wrong. Identifiers
+   * must have no gap, the missing ones are NULL in the table
+   */
   for (uint16_t t = 0; t < sTrackTableSize; t++) {
-    if (! sTracks[t]->connectionsOk()) incErrorCount();
+    if (sTracks[t] == NULL || ! sTracks[t]->connectionsOk()) incErrorCount();
+  }
+#ifdef DEBUG
+  if (! trackNetIsOk()) {
+    LayoutReport report;
+    report.build();
+    report.print();
+  }
+#endif
+#ifdef SWITCHMAN_TRACK_NAMES
+  TrackNames::buildIndex();
+#endif
+  if (trackNetIsOk()) {
+    /* Collapse the runs of blocks */
+    BlockChain::build();
+    /* Index the reachable tracks when the build fits in memory */
+    if (ReachabilityIndex::buildSize() <= REACHABILITY_INDEX_BUILD_BYTES) {
+      ReachabilityIndex::build();
+    }
   }
 }
 
 /*---------------------------------------------------------------------------*/
 void Track::setDirection(const Direction inDir)
 {
-  if (mDirection == NO_DIRECTION || mDirection == inDir) mDirection = inDir;
-#ifdef DEBUG
-  else {
-    Serial.print(F("Direction already set: "));
-    displayTrackln(this);
-  }
-#endif
+  /* The first connection gives the direction, DirectionSolver fixes it */
+  if (mDirection == NO_DIRECTION) mDirection = inDir;
 }
 
 /*---------------------------------------------------------------------------*/
 bool Track::pathsTo(Track & inTrack, const Direction inDir, PathSet & ioPaths)
 {
-#ifdef TRACE
-  gDepth = 0;
-#endif
-  HeadedTrackSet marking;
-  return allPathsTo(inTrack.identifier(), inDir, ioPaths, NULL, marking);
+  return pathsTo(inTrack.identifier(), inDir, ioPaths);
 }
 
 /*---------------------------------------------------------------------------*/
 bool Track::pathsTo(uint16_t inId, const Direction inDir, PathSet & ioPaths)
 {
+  PROFILE_SCOPE(PROFILE_QUERY);
+  HEAP_QUERY_SCOPE();
 #ifdef TRACE
   gDepth = 0;
 #endif
-  HeadedTrackSet marking;
-  return allPathsTo(inId, inDir, ioPaths, NULL, marking);
+  /* Do not explore if the index tells the target cannot be reached */
+  if (ReachabilityIndex::isBuilt() &&
+      ! ReachabilityIndex::reaches(identifier(), inId, inDir)) {
+    return false;
+  }
+  /* The recursive search keeps one direction, joints swap it */
+  if (DirectionSolver::jointCount() > 0) {
+    PooledPathSearch search;
+    if (! search->start(*this, inId, inDir, ioPaths)) return false;
+    while (! search->step(0xFFFF));
+    /* Paths already in ioPaths are not added again but are found */
+    return search->pathCount() > 0;
+  }
+  PooledHeadedTrackSet marking;
+  return allPathsTo(inId, inDir, ioPaths, NULL, *marking);
+}
+
+/*---------------------------------------------------------------------------*/
+bool Track::visitPathsTo(uint16_t inId, const Direction inDir, RouteVisitor & inVisitor)
+{
+  PROFILE_SCOPE(PROFILE_QUERY);
+  HEAP_QUERY_SCOPE();
+  if (ReachabilityIndex::isBuilt() &&
+      ! ReachabilityIndex::reaches(identifier(), inId, inDir)) {
+    return false;
+  }
+  PooledPathSearch search;
+  return search->visit(*this, inId, inDir, inVisitor);
+}
+
+/*---------------------------------------------------------------------------*/
+bool Track::mayReach(const uint16_t inId, const Direction inDir)
+{
+  /* Crossings are not in the index as start tracks */
+  if (identifier() == inId || entryCount() > 1 || ! ReachabilityIndex::isBuilt()) {
+    return true;
+  }
+  return ReachabilityIndex::reaches(identifier(), inId, inDir);
+}
+
+/*---------------------------------------------------------------------------*/
+bool Track::allPathsFromNextTracks(
+  const uint16_t inId,
+  const Direction inDir,
+  PathSet & ioPaths,
+  const Track * inFrom,
+  HeadedTrackSet & ioMarking)
+{
+  Track * next[MAX_NEXT_TRACKS];
+  uint8_t count = nextTracks(inDir, inFrom, next);
+  if (count == 1) {
+    return next[0]->allPathsTo(inId, inDir, ioPaths, this, ioMarking);
+  }
+  bool result = false;
+  PathSet initialPaths(ioPaths);
+  for (uint8_t i = 0; i < count; i++) {
+    PathSet paths(initialPaths);
+    if (next[i]->allPathsTo(inId, inDir, paths, this, ioMarking)) {
+      if (result) ioPaths += paths;
+      else        ioPaths = paths;
+      result = true;
+    }
+  }
+  return result;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -208,12 +333,28 @@ Track & Track::trackForId(uint16_t inId)
   return *(sTracks[inId]);
 }
 
-#ifdef DEBUG
+/*---------------------------------------------------------------------------*/
+int8_t Track::connectorBack(Track & inFrom, const Connector inConnector)
+{
+  /* A track connected to itself has its connectors paired in order */
+  uint8_t rank = 0;
+  for (uint8_t c = 0; c < inConnector; c++) {
+    if (inFrom.connectedTrack((Connector)c) == this) rank++;
+  }
+  if (&inFrom == this) rank ^= 1;
+  for (uint8_t c = 0; c < CONNECTOR_COUNT; c++) {
+    if (connectedTrack((Connector)c) == &inFrom) {
+      if (rank == 0) return c;
+      rank--;
+    }
+  }
+  return -1;
+}
+
+#ifdef SWITCHMAN_TRACK_NAMES
 void Track::print() const
 {
-  char buf[32];
-  strcpy_P(buf, (char *)pgm_read_word(mName));
-  Serial.print(buf);
+  TrackNames::print(mIdentifier);
 }
 
 void Track::println() const
@@ -241,7 +382,7 @@ ErrorCode DeadendTrack::connect(
   if (mOutTrack == NULL) {
     if (inFromConnector == OUTLET) {
       mOutTrack = &inToTrack;
-      mOutTrack->connectFrom(this, inToConnector);
+      inToTrack.connectFrom(this, inToConnector);
       setDirection(FORWARD_DIRECTION);
     }
     else {
@@ -288,6 +429,25 @@ bool DeadendTrack::connectionsOk()
   return mOutTrack != NULL;
 }
 
+/*---------------------------------------------------------------------------*/
+Track * DeadendTrack::connectedTrack(const Connector inConnector)
+{
+  return (inConnector == OUTLET) ? mOutTrack : NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+uint8_t DeadendTrack::nextTracks(
+  const Direction inDir,
+  __attribute__((unused)) const Track * inFrom,
+  Track ** outNext)
+{
+  if (direction() == inDir) {
+    outNext[0] = mOutTrack;
+    return 1;
+  }
+  return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 bool DeadendTrack::allPathsTo(
   const uint16_t inId,                          /* id of the target track     */
@@ -296,11 +456,12 @@ bool DeadendTrack::allPathsTo(
   __attribute__((unused)) const Track * inFrom, /* track used to get there    */
   HeadedTrackSet & ioMarking)                   /* to mark the visited tracks */
 {
+  PROFILE_SCOPE(PROFILE_DEADEND);
   ensureTrackNetOk();
   ddTrack(this);
   incDepth();
   bool result = false;
-  if (! ioMarking.containsTrack(this,inDir))
+  if (! ioMarking.containsTrack(this,inDir) && mayReach(inId, inDir))
   {
     ioMarking.addTrack(this, inDir);
     if (inId == identifier()) { /* found */
@@ -308,13 +469,15 @@ bool DeadendTrack::allPathsTo(
       result = true;
     }
     else {
-      if (direction() == FORWARD_DIRECTION && direction() == inDir) {
+      if (direction() == inDir) {
         if (mOutTrack->allPathsTo(inId, inDir, ioPaths, this, ioMarking)) {
           ioPaths.addTrack(this);
           result = true;
         }
       }
     }
+    /* Other paths may go through this track */
+    ioMarking.removeTrack(this, inDir);
   }
   decDepth();
   return result;
@@ -324,7 +487,10 @@ bool DeadendTrack::allPathsTo(
  * Block
  */
 BlockTrack::BlockTrack(NAME_DECL_FIRST(inName) const uint16_t inId) :
-  Track(NAME_ARG_FIRST(inName) inId), mInTrack(NULL), mOutTrack(NULL)
+  Track(NAME_ARG_FIRST(inName) inId),
+  mInTrack(NULL),
+  mOutTrack(NULL),
+  mChain(NULL)
 {}
 
 /*---------------------------------------------------------------------------*/
@@ -340,7 +506,7 @@ ErrorCode BlockTrack::connect(
     case INLET:
       if (mInTrack == NULL) {
         mInTrack = &inToTrack;
-        mInTrack->connectFrom(this, inToConnector);
+        inToTrack.connectFrom(this, inToConnector);
         setDirection(BACKWARD_DIRECTION);
       }
       else result = USED_CONNECTOR;
@@ -349,7 +515,7 @@ ErrorCode BlockTrack::connect(
     case OUTLET:
       if (mOutTrack == NULL) {
         mOutTrack = &inToTrack;
-        mOutTrack->connectFrom(this, inToConnector);
+        inToTrack.connectFrom(this, inToConnector);
         setDirection(FORWARD_DIRECTION);
       }
       else result = USED_CONNECTOR;
@@ -418,6 +584,26 @@ bool BlockTrack::connectionsOk()
   return mInTrack != NULL && mOutTrack != NULL;
 }
 
+/*---------------------------------------------------------------------------*/
+Track * BlockTrack::connectedTrack(const Connector inConnector)
+{
+  switch (inConnector) {
+    case INLET:  return mInTrack;
+    case OUTLET: return mOutTrack;
+    default:     return NULL;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+uint8_t BlockTrack::nextTracks(
+  const Direction inDir,
+  __attribute__((unused)) const Track * inFrom,
+  Track ** outNext)
+{
+  outNext[0] = (direction() == inDir) ? mOutTrack : mInTrack;
+  return 1;
+}
+
 /*---------------------------------------------------------------------------*/
 bool BlockTrack::allPathsTo(
   const uint16_t inId,                          /* id of the target track     */
@@ -426,16 +612,37 @@ bool BlockTrack::allPathsTo(
   __attribute__((unused)) const Track * inFrom, /* track used to get there    */
   HeadedTrackSet & ioMarking)                   /* to mark the visited tracks */
 {
+  PROFILE_SCOPE(PROFILE_BLOCK);
   ensureTrackNetOk();
   ddTrack(this);
   incDepth();
   bool result = false;
-  if (! ioMarking.containsTrack(this,inDir)) {
+  if (! ioMarking.containsTrack(this,inDir) && mayReach(inId, inDir)) {
     ioMarking.addTrack(this, inDir);
+    BlockTrack * farEnd = NULL;
+    if (mChain != NULL && ! mChain->containsTrack(inId)) {
+      farEnd = mChain->farEnd(this, inDir);
+    }
     if (inId == identifier()) { /* found */
       ioPaths.addTrack(this);
       result = true;
     }
+    else if (farEnd != NULL) {
+      /*
+       * Entering a chain of blocks by one end, cross it in one step.
+       * If the far end is already marked, the blocks in between lead
+       * to it and there is no path.
+       */
+      if (! ioMarking.containsTrack(farEnd, inDir)) {
+        ioMarking.addTrack(farEnd, inDir);
+        Track * exitTrack = mChain->exitFrom(this);
+        if (exitTrack->allPathsTo(inId, inDir, ioPaths, farEnd, ioMarking)) {
+          ioPaths.addTrackSet(mChain->members());
+          result = true;
+        }
+        ioMarking.removeTrack(farEnd, inDir);
+      }
+    }
     else {
       if (direction() == inDir) {
         if (mOutTrack->allPathsTo(inId, inDir, ioPaths, this, ioMarking)) {
@@ -450,6 +657,7 @@ bool BlockTrack::allPathsTo(
         }
       }
     }
+    ioMarking.removeTrack(this, inDir);
   }
   decDepth();
   return result;
@@ -463,7 +671,6 @@ TurnoutTrack::TurnoutTrack(NAME_DECL_FIRST(inName) const uint16_t inId) :
   mInTrack(NULL),
   mOutLeftTrack(NULL),
   mOutRightTrack(NULL),
-  mPartialPath(NULL),
   mPosition(NO_POSITION)
 {}
 
@@ -480,7 +687,7 @@ ErrorCode TurnoutTrack::connect(
     case INLET:
       if (mInTrack == NULL) {
         mInTrack = &inToTrack;
-        mInTrack->connectFrom(this, inToConnector);
+        inToTrack.connectFrom(this, inToConnector);
         setDirection(BACKWARD_DIRECTION);
       }
       else result = USED_CONNECTOR;
@@ -489,7 +696,7 @@ ErrorCode TurnoutTrack::connect(
     case LEFT_OUTLET:
       if (mOutLeftTrack == NULL) {
         mOutLeftTrack = &inToTrack;
-        mOutLeftTrack->connectFrom(this, inToConnector);
+        inToTrack.connectFrom(this, inToConnector);
         setDirection(FORWARD_DIRECTION);
       }
       else result = USED_CONNECTOR;
@@ -498,7 +705,7 @@ ErrorCode TurnoutTrack::connect(
     case RIGHT_OUTLET:
       if (mOutRightTrack == NULL) {
         mOutRightTrack = &inToTrack;
-        mOutRightTrack->connectFrom(this, inToConnector);
+        inToTrack.connectFrom(this, inToConnector);
         setDirection(FORWARD_DIRECTION);
       }
       else result = USED_CONNECTOR;
@@ -571,6 +778,34 @@ bool TurnoutTrack::connectionsOk()
   return mInTrack != NULL && mOutLeftTrack != NULL && mOutRightTrack != NULL;
 }
 
+/*---------------------------------------------------------------------------*/
+Track * TurnoutTrack::connectedTrack(const Connector inConnector)
+{
+  switch (inConnector) {
+    case INLET:        return mInTrack;
+    case LEFT_OUTLET:  return mOutLeftTrack;
+    case RIGHT_OUTLET: return mOutRightTrack;
+    default:           return NULL;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+uint8_t TurnoutTrack::nextTracks(
+  const Direction inDir,
+  __attribute__((unused)) const Track * inFrom,
+  Track ** outNext)
+{
+  if (direction() == inDir) { /* travelling from in to out */
+    outNext[0] = mOutLeftTrack;
+    outNext[1] = mOutRightTrack;
+    return 2;
+  }
+  else { /* travelling from out to in */
+    outNext[0] = mInTrack;
+    return 1;
+  }
+}
+
 /*---------------------------------------------------------------------------*/
 bool TurnoutTrack::allPathsTo(
   const uint16_t inId,
@@ -579,37 +814,19 @@ bool TurnoutTrack::allPathsTo(
   __attribute__((unused)) const Track * inFrom,
   HeadedTrackSet & ioMarking)
 {
+  PROFILE_SCOPE(PROFILE_TURNOUT);
   ensureTrackNetOk();
   ddTrack(this);
   incDepth();
   bool result = false;
-  if (ioMarking.containsTrack(this,inDir)) {
-    /*
-     * track already looked up.
-     * 1) a partial path has been left: a path to the target exists and hads
-     *    been explored
-     * 2) no partial path: no path to the target
-     */
-    if (mPartialPath != NULL) {
-#ifdef TRACE
-      Serial.println(F("$$$$ Partial path"));
-      mPartialPath->println();
-#endif
-      ioPaths = *mPartialPath;
-      result = true;
-    }
-    else result = false;
-  }
-  else {
+  /*
+   * A track already on the path is not gone through again. The paths
+   * found from a track depend on the tracks already on the path, so they
+   * are not kept from a visit to the next one. A track from which the
+   * index tells the target cannot be reached is not gone through.
+   */
+  if (! ioMarking.containsTrack(this,inDir) && mayReach(inId, inDir)) {
     ioMarking.addTrack(this, inDir);
-    /*
-     * remove the partiel path left by a previous
-     * exploration if direction is out to in.
-     */
-    if (direction() != inDir && mPartialPath != NULL) {
-      delete mPartialPath;
-      mPartialPath = NULL;
-    }
 
     if (identifier() == inId) { /* found */
       ioPaths.addTrack(this);
@@ -637,11 +854,11 @@ bool TurnoutTrack::allPathsTo(
       else { /* travelling from out to in */
         if (mInTrack->allPathsTo(inId, inDir, ioPaths, this, ioMarking)) {
           ioPaths.addTrack(this);
-          mPartialPath = new PathSet(ioPaths);
           result = true;
         }
       }
     }
+    ioMarking.removeTrack(this, inDir);
   }
   decDepth();
   return result;
@@ -653,6 +870,163 @@ void TurnoutTrack::setPosition(const Position inPosition)
   mPosition = inPosition;
 }
 
+/*=============================================================================
+ * Three-way turnout track
+ */
+ThreeWayTrack::ThreeWayTrack(NAME_DECL_FIRST(inName) const uint16_t inId) :
+  Track(NAME_ARG_FIRST(inName) inId),
+  mInTrack(NULL),
+  mOutLeftTrack(NULL),
+  mOutTrack(NULL),
+  mOutRightTrack(NULL),
+  mPosition(NO_POSITION)
+{}
+
+/*---------------------------------------------------------------------------*/
+ErrorCode ThreeWayTrack::connect(
+  const Connector inFromConnector,
+  Track &         inToTrack,
+  const Connector inToConnector)
+{
+  ErrorCode result = NO_ERROR;
+  TrackLink * connection = NULL;
+  Direction dir = FORWARD_DIRECTION;
+
+  switch (inFromConnector) {
+    case INLET:        connection = &mInTrack; dir = BACKWARD_DIRECTION; break;
+    case LEFT_OUTLET:  connection = &mOutLeftTrack;                      break;
+    case OUTLET:       connection = &mOutTrack;                          break;
+    case RIGHT_OUTLET: connection = &mOutRightTrack;                     break;
+    case LEFT_INLET:
+    case RIGHT_INLET:
+    default:
+      result = BAD_CONNECTOR;
+      BAD_CONNECTOR_ERROR("ThreeWayTrack::connect/", this, inFromConnector);
+      break;
+  }
+  if (connection != NULL) {
+    if (*connection == NULL) {
+      *connection = &inToTrack;
+      inToTrack.connectFrom(this, inToConnector);
+      setDirection(dir);
+    }
+    else {
+      result = USED_CONNECTOR;
+      incErrorCount();
+      USED_CONNECTOR_ERROR("ThreeWayTrack::connect", this, inFromConnector);
+    }
+  }
+  return result;
+}
+
+/*---------------------------------------------------------------------------*/
+ErrorCode ThreeWayTrack::connectFrom(Track * inTrack, const Connector inConnector)
+{
+  ErrorCode result = NO_ERROR;
+  TrackLink * connection = NULL;
+  Direction dir = BACKWARD_DIRECTION;
+
+  switch (inConnector) {
+    case INLET:        connection = &mInTrack; dir = FORWARD_DIRECTION; break;
+    case LEFT_OUTLET:  connection = &mOutLeftTrack;                     break;
+    case OUTLET:       connection = &mOutTrack;                         break;
+    case RIGHT_OUTLET: connection = &mOutRightTrack;                    break;
+    case LEFT_INLET:
+    case RIGHT_INLET:
+    default:
+      result = BAD_CONNECTOR;
+      BAD_CONNECTOR_ERROR("ThreeWayTrack::connectFrom/", this, inConnector);
+      break;
+  }
+  if (connection != NULL) {
+    if (*connection == NULL) {
+      *connection = inTrack;
+      setDirection(dir);
+    }
+    else {
+      result = USED_CONNECTOR;
+      incErrorCount();
+      USED_CONNECTOR_ERROR("ThreeWayTrack::connectFrom", this, inConnector);
+    }
+  }
+  return result;
+}
+
+/*---------------------------------------------------------------------------*/
+bool ThreeWayTrack::connectionsOk()
+{
+  return mInTrack != NULL &&
+         mOutLeftTrack != NULL &&
+         mOutTrack != NULL &&
+         mOutRightTrack != NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+Track * ThreeWayTrack::connectedTrack(const Connector inConnector)
+{
+  switch (inConnector) {
+    case INLET:        return mInTrack;
+    case LEFT_OUTLET:  return mOutLeftTrack;
+    case OUTLET:       return mOutTrack;
+    case RIGHT_OUTLET: return mOutRightTrack;
+    default:           return NULL;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+uint8_t ThreeWayTrack::nextTracks(
+  const Direction inDir,
+  __attribute__((unused)) const Track * inFrom,
+  Track ** outNext)
+{
+  if (direction() == inDir) { /* travelling from in to out */
+    outNext[0] = mOutLeftTrack;
+    outNext[1] = mOutTrack;
+    outNext[2] = mOutRightTrack;
+    return 3;
+  }
+  else { /* travelling from out to in */
+    outNext[0] = mInTrack;
+    return 1;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+bool ThreeWayTrack::allPathsTo(
+  const uint16_t inId,
+  const Direction inDir,
+  PathSet & ioPaths,
+  const Track * inFrom,
+  HeadedTrackSet & ioMarking)
+{
+  PROFILE_SCOPE(PROFILE_THREEWAY);
+  ensureTrackNetOk();
+  ddTrack(this);
+  incDepth();
+  bool result = false;
+  /* See TurnoutTrack::allPathsTo */
+  if (! ioMarking.containsTrack(this, inDir) && mayReach(inId, inDir)) {
+    ioMarking.addTrack(this, inDir);
+    if (identifier() == inId) { /* found */
+      ioPaths.addTrack(this);
+      result = true;
+    }
+    else if (allPathsFromNextTracks(inId, inDir, ioPaths, inFrom, ioMarking)) {
+      ioPaths.addTrack(this);
+      result = true;
+    }
+    ioMarking.removeTrack(this, inDir);
+  }
+  decDepth();
+  return result;
+}
+
+/*---------------------------------------------------------------------------*/
+void ThreeWayTrack::setPosition(const Position inPosition)
+{
+  mPosition = inPosition;
+}
+
 /*=============================================================================
  * Crossing track
  */
@@ -676,7 +1050,7 @@ ErrorCode CrossingTrack::connect(
     case LEFT_INLET:
       if (mInLeftTrack == NULL) {
         mInLeftTrack = &inToTrack;
-        mInLeftTrack->connectFrom(this, inToConnector);
+        inToTrack.connectFrom(this, inToConnector);
         setDirection(BACKWARD_DIRECTION);
       }
       else result = USED_CONNECTOR;
@@ -685,7 +1059,7 @@ ErrorCode CrossingTrack::connect(
     case RIGHT_INLET:
       if (mInRightTrack == NULL) {
         mInRightTrack = &inToTrack;
-        mInRightTrack->connectFrom(this, inToConnector);
+        inToTrack.connectFrom(this, inToConnector);
         setDirection(BACKWARD_DIRECTION);
       }
       else result = USED_CONNECTOR;
@@ -694,7 +1068,7 @@ ErrorCode CrossingTrack::connect(
     case LEFT_OUTLET:
       if (mOutLeftTrack == NULL) {
         mOutLeftTrack = &inToTrack;
-        mOutLeftTrack->connectFrom(this, inToConnector);
+        inToTrack.connectFrom(this, inToConnector);
         setDirection(FORWARD_DIRECTION);
       }
       else result = USED_CONNECTOR;
@@ -703,7 +1077,7 @@ ErrorCode CrossingTrack::connect(
     case RIGHT_OUTLET:
       if (mOutRightTrack == NULL) {
         mOutRightTrack = &inToTrack;
-        mOutRightTrack->connectFrom(this, inToConnector);
+        inToTrack.connectFrom(this, inToConnector);
         setDirection(FORWARD_DIRECTION);
       }
       else result = USED_CONNECTOR;
@@ -787,6 +1161,45 @@ bool CrossingTrack::connectionsOk()
          mOutRightTrack != NULL;
 }
 
+/*---------------------------------------------------------------------------*/
+Track * CrossingTrack::connectedTrack(const Connector inConnector)
+{
+  switch (inConnector) {
+    case LEFT_INLET:   return mInLeftTrack;
+    case RIGHT_INLET:  return mInRightTrack;
+    case LEFT_OUTLET:  return mOutLeftTrack;
+    case RIGHT_OUTLET: return mOutRightTrack;
+    default:           return NULL;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+uint8_t CrossingTrack::nextTracks(
+  const Direction inDir,
+  const Track * inFrom,
+  Track ** outNext)
+{
+  Track * next = NULL;
+  if (direction() == inDir) {
+    if (inFrom == mInLeftTrack)        next = mOutRightTrack;
+    else if (inFrom == mInRightTrack)  next = mOutLeftTrack;
+  }
+  else {
+    if (inFrom == mOutLeftTrack)       next = mInRightTrack;
+    else if (inFrom == mOutRightTrack) next = mInLeftTrack;
+  }
+  if (next == NULL) return 0;
+  outNext[0] = next;
+  return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+uint8_t CrossingTrack::entryOf(const Track * inFrom)
+{
+  /* 0 for the LEFT_INLET to RIGHT_OUTLET way, 1 for the other one */
+  return (inFrom == mInRightTrack || inFrom == mOutLeftTrack) ? 1 : 0;
+}
+
 /*---------------------------------------------------------------------------*/
 bool CrossingTrack::allPathsTo(
   const uint16_t inId,
@@ -795,6 +1208,7 @@ bool CrossingTrack::allPathsTo(
   const Track * inFrom,
   HeadedTrackSet & ioMarking)
 {
+  PROFILE_SCOPE(PROFILE_CROSSING);
   ensureTrackNetOk();
   ddTrack(this);
   incDepth();
@@ -840,21 +1254,204 @@ bool CrossingTrack::allPathsTo(
 /*=============================================================================
  * DoubleslipTrack
  */
-// DoubleslipTrack::DoubleslipTrack(NAME_DECL_FIRST(inName) const uint16_t inId) :
-//   CrossingTrack(NAME_ARG_FIRST(inName) inId),
-//   mInPosition(NO_POSITION),
-//   mOutPosition(NO_POSITION)
-// {
-// }
-//
-// /*---------------------------------------------------------------------------*/
-// void DoubleslipTrack::setInPosition(const Position inPosition)
-// {
-//   mInPosition = inPosition;
-// }
-//
-// /*---------------------------------------------------------------------------*/
-// void DoubleslipTrack::setOutPosition(const Position inPosition)
-// {
-//   mOutPosition = inPosition;
-// }
+
+/*
+ * Connectors are numbered 0: LEFT_INLET, 1: RIGHT_INLET, 2: LEFT_OUTLET
+ * and 3: RIGHT_OUTLET. Each inlet leads to both outlets and each outlet
+ * to both inlets.
+ */
+#define DS_INLETS   0x03
+#define DS_OUTLETS  0x0C
+#define NO_CONNECTOR 4
+
+const uint8_t DoubleslipTrack::sRoutes[4] = {
+  DS_OUTLETS, DS_OUTLETS, DS_INLETS, DS_INLETS
+};
+
+DoubleslipTrack::DoubleslipTrack(NAME_DECL_FIRST(inName) const uint16_t inId) :
+  CrossingTrack(NAME_ARG_FIRST(inName) inId),
+  mInPosition(NO_POSITION),
+  mOutPosition(NO_POSITION)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+Track * DoubleslipTrack::connectorTrack(const uint8_t inConnector) const
+{
+  switch (inConnector) {
+    case 0:  return mInLeftTrack;
+    case 1:  return mInRightTrack;
+    case 2:  return mOutLeftTrack;
+    case 3:  return mOutRightTrack;
+    default: return NULL;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+uint8_t DoubleslipTrack::connectorOf(const Track * inTrack) const
+{
+  if (inTrack == NULL)            return NO_CONNECTOR;
+  if (inTrack == mInLeftTrack)    return 0;
+  if (inTrack == mInRightTrack)   return 1;
+  if (inTrack == mOutLeftTrack)   return 2;
+  if (inTrack == mOutRightTrack)  return 3;
+  return NO_CONNECTOR;
+}
+
+/*---------------------------------------------------------------------------*/
+uint8_t DoubleslipTrack::nextTracks(
+  const Direction inDir,
+  const Track * inFrom,
+  Track ** outNext)
+{
+  /* Side of the double slip the train leaves by */
+  uint8_t exits = (direction() == inDir) ? DS_OUTLETS : DS_INLETS;
+  uint8_t entry = connectorOf(inFrom);
+  if (entry != NO_CONNECTOR) exits &= sRoutes[entry];
+  uint8_t count = 0;
+  for (uint8_t c = 0; c < 4; c++) {
+    if (exits & (1 << c)) outNext[count++] = connectorTrack(c);
+  }
+  return count;
+}
+
+/*---------------------------------------------------------------------------*/
+bool DoubleslipTrack::allPathsTo(
+  const uint16_t inId,
+  const Direction inDir,
+  PathSet & ioPaths,
+  const Track * inFrom,
+  HeadedTrackSet & ioMarking)
+{
+  PROFILE_SCOPE(PROFILE_DOUBLESLIP);
+  ensureTrackNetOk();
+  ddTrack(this);
+  incDepth();
+  bool result = false;
+  /* See TurnoutTrack::allPathsTo */
+  if (! ioMarking.containsTrack(this, inDir) && mayReach(inId, inDir)) {
+    ioMarking.addTrack(this, inDir);
+    if (identifier() == inId) { /* found */
+      ioPaths.addTrack(this);
+      result = true;
+    }
+    else if (allPathsFromNextTracks(inId, inDir, ioPaths, inFrom, ioMarking)) {
+      ioPaths.addTrack(this);
+      result = true;
+    }
+    ioMarking.removeTrack(this, inDir);
+  }
+  decDepth();
+  return result;
+}
+
+/*---------------------------------------------------------------------------*/
+void DoubleslipTrack::setInPosition(const Position inPosition)
+{
+  mInPosition = inPosition;
+}
+
+/*---------------------------------------------------------------------------*/
+void DoubleslipTrack::setOutPosition(const Position inPosition)
+{
+  mOutPosition = inPosition;
+}
+
+/*=============================================================================
+ * ScissorsTrack
+ */
+const ScissorsRoute ScissorsTrack::sRoutes[SCISSORS_ROUTE_COUNT] = {
+  { LEFT_INLET,  LEFT_OUTLET,  STRAIGHT_POSITION },
+  { LEFT_INLET,  RIGHT_OUTLET, LEFT_POSITION     },
+  { RIGHT_INLET, LEFT_OUTLET,  RIGHT_POSITION    },
+  { RIGHT_INLET, RIGHT_OUTLET, STRAIGHT_POSITION }
+};
+
+ScissorsTrack::ScissorsTrack(NAME_DECL_FIRST(inName) const uint16_t inId) :
+  CrossingTrack(NAME_ARG_FIRST(inName) inId),
+  mPosition(NO_POSITION)
+{}
+
+/*---------------------------------------------------------------------------*/
+Position ScissorsTrack::positionFor(const Connector inFrom, const Connector inTo)
+{
+  for (uint8_t r = 0; r < SCISSORS_ROUTE_COUNT; r++) {
+    if ((sRoutes[r].from == inFrom && sRoutes[r].to == inTo) ||
+        (sRoutes[r].from == inTo && sRoutes[r].to == inFrom)) {
+      return sRoutes[r].position;
+    }
+  }
+  return NO_POSITION;
+}
+
+/*---------------------------------------------------------------------------*/
+uint8_t ScissorsTrack::nextTracks(
+  const Direction inDir,
+  const Track * inFrom,
+  Track ** outNext)
+{
+  /* Without the track it comes from, the road is not known */
+  if (inFrom == NULL) return 0;
+  /* Connector entered by and exits, left first, on the other side */
+  Connector entry;
+  Connector exits[2];
+  if (direction() == inDir) {
+    if (inFrom == mInLeftTrack)       entry = LEFT_INLET;
+    else if (inFrom == mInRightTrack) entry = RIGHT_INLET;
+    else return 0;
+    exits[0] = LEFT_OUTLET;
+    exits[1] = RIGHT_OUTLET;
+  }
+  else {
+    if (inFrom == mOutLeftTrack)       entry = LEFT_OUTLET;
+    else if (inFrom == mOutRightTrack) entry = RIGHT_OUTLET;
+    else return 0;
+    exits[0] = LEFT_INLET;
+    exits[1] = RIGHT_INLET;
+  }
+  uint8_t count = 0;
+  for (uint8_t e = 0; e < 2; e++) {
+    if (positionFor(entry, exits[e]) != NO_POSITION) {
+      outNext[count++] = connectedTrack(exits[e]);
+    }
+  }
+  return count;
+}
+
+/*---------------------------------------------------------------------------*/
+uint8_t ScissorsTrack::entryOf(const Track * inFrom)
+{
+  return (inFrom == mInLeftTrack || inFrom == mOutLeftTrack) ? 0 : 1;
+}
+
+/*---------------------------------------------------------------------------*/
+bool ScissorsTrack::allPathsTo(
+  const uint16_t inId,
+  const Direction inDir,
+  PathSet & ioPaths,
+  const Track * inFrom,
+  HeadedTrackSet & ioMarking)
+{
+  PROFILE_SCOPE(PROFILE_CROSSING);
+  ensureTrackNetOk();
+  ddTrack(this);
+  incDepth();
+  bool result = false;
+  /* Not marked, like a crossing, since each road is a way of its own */
+  if (identifier() == inId) {
+    ioPaths.addTrack(this);
+    result = true;
+  }
+  else if (allPathsFromNextTracks(inId, inDir, ioPaths, inFrom, ioMarking)) {
+    ioPaths.addTrack(this);
+    result = true;
+  }
+  decDepth();
+  return result;
+}
+
+/*---------------------------------------------------------------------------*/
+void ScissorsTrack::setPosition(const Position inPosition)
+{
+  mPosition = inPosition;
+}
@@ -3,6 +3,7 @@
 
 #include "Arduino.h"
 #include "Debug.h"
+#include "TrackNames.h"
 
 /*
  * Direction of travel
@@ -26,14 +27,38 @@ typedef enum {
 } Connector;
 
 /*
- * Positions of turnout, single and double slip
+ * Positions of turnout, three-way turnout, scissors, single and double slip
  */
 typedef enum {
   NO_POSITION,
   LEFT_POSITION,
-  RIGHT_POSITION
+  RIGHT_POSITION,
+  STRAIGHT_POSITION
 } Position;
 
+/*
+ * Kinds of track element
+ */
+typedef enum {
+  DEADEND_TRACK,
+  BLOCK_TRACK,
+  TURNOUT_TRACK,
+  THREEWAY_TRACK,
+  CROSSING_TRACK,
+  DOUBLESLIP_TRACK,
+  SCISSORS_TRACK
+} TrackKind;
+
+/*
+ * Number of connectors of the Connector type
+ */
+#define CONNECTOR_COUNT 6
+
+/*
+ * Maximum number of tracks following a track in a travel direction
+ */
+#define MAX_NEXT_TRACKS 3
+
 typedef enum {
   NO_ERROR,
   BAD_CONNECTOR,
@@ -43,6 +68,40 @@ typedef enum {
 class PathSet;
 class HeadedTrackSet;
 class Track;
+class BlockChain;
+class RouteVisitor;
+
+/*
+ * Link from a track to a connected track.
+ * With SWITCHMAN_PACKED_TRACKS, the links hold the identifier of the
+ * connected track instead of a pointer: 1 byte instead of 2 on AVR and
+ * 8 on 64 bits hosts. SWITCHMAN_WIDE_TRACK_IDS makes it 2 bytes for
+ * nets of more than 255 tracks. Tracks are then reached through the
+ * track table. A track whose identifier does not fit, 255 and above on
+ * 1 byte, is an error of the net and the links to it are empty.
+ */
+#ifdef SWITCHMAN_PACKED_TRACKS
+#ifdef SWITCHMAN_WIDE_TRACK_IDS
+typedef uint16_t TrackIndex;
+#else
+typedef uint8_t TrackIndex;
+#endif
+#define NO_TRACK_INDEX ((TrackIndex)~0)
+
+class TrackLink
+{
+private:
+  TrackIndex mIndex;
+
+public:
+  TrackLink() : mIndex(NO_TRACK_INDEX) {}
+  TrackLink(const Track * inTrack);
+  operator Track *() const;
+  Track * operator->() const { return *this; }
+};
+#else
+typedef Track * TrackLink;
+#endif
 
 #ifdef DEBUG
 void displayConnectorName(const Connector inConnector);
@@ -56,8 +115,8 @@ void displayTrack(const Track & inTrack);
 void displayTrackln(const Track & inTrack);
 #endif
 
-#ifdef DEBUG
-#define NAME(name) F("name")
+#ifdef SWITCHMAN_TRACK_NAMES
+#define NAME(name) F(#name)
 #define NAME_DECL_ALONE(name) const char * name
 #define NAME_DECL_FIRST(name) const char * name,
 #define NAME_ARG_FIRST(name) name,
@@ -74,9 +133,6 @@ void displayTrackln(const Track & inTrack);
 class Track
 {
 private:
-#ifdef DEBUG
-  const char * mName;
-#endif
   uint16_t mIdentifier : 14; /* Track identifier */
   Direction mDirection : 2;  /* Travel direction */
 
@@ -89,6 +145,19 @@ private:
 protected:
   void setDirection(const Direction inDir); /* Set the travelling direction */
   static void incErrorCount() { sErrorCount++; }
+  /*
+   * Return false if the index tells the target cannot be reached from
+   * this track, the recursive search does not go further.
+   */
+  bool mayReach(const uint16_t inId, const Direction inDir);
+  /* Build the paths from the tracks following this one and merge them */
+  bool allPathsFromNextTracks(
+    const uint16_t inId,
+    const Direction inDir,
+    PathSet & ioPaths,
+    const Track * inFrom,
+    HeadedTrackSet & ioMarking
+  );
 
 public:
   /* return true if the track is a block */
@@ -116,10 +185,34 @@ public:
     const Connector inToConnector
   ) = 0;
   virtual bool connectionsOk() = 0;
+  /*
+   * Get the tracks following this one when travelling in inDir and
+   * coming from inFrom. Store them in outNext and return their count
+   */
+  virtual uint8_t nextTracks(
+    const Direction inDir,
+    const Track * inFrom,
+    Track ** outNext
+  ) = 0;
+  /* Number of ways to go through the track. Only crossings have 2 */
+  virtual uint8_t entryCount() { return 1; }
+  /* Way used to go through the track when coming from inFrom */
+  virtual uint8_t entryOf(__attribute__((unused)) const Track * inFrom) { return 0; }
+  /* Kind of the track element */
+  virtual TrackKind kind() = 0;
+  /* Track connected to a connector, NULL if none or if the track has not it */
+  virtual Track * connectedTrack(const Connector inConnector) = 0;
   bool pathsTo(Track & inTrack, const Direction inDir, PathSet & ioPaths);
   bool pathsTo(uint16_t inId, const Direction inDir, PathSet & ioPaths);
+  /*
+   * Give each path to track inId to inVisitor as soon as it is found,
+   * until the visitor returns false. Return true if it did.
+   */
+  bool visitPathsTo(uint16_t inId, const Direction inDir, RouteVisitor & inVisitor);
 
-#ifdef DEBUG
+#ifdef SWITCHMAN_TRACK_NAMES
+  /* Name of the track, in flash memory on AVR. See TrackNames.h */
+  const char * name() const { return TrackNames::name(mIdentifier); }
   void print() const;
   void println() const;
 #endif
@@ -132,19 +225,55 @@ public:
 
   static void finalize();
   static Track & trackForId(uint16_t inId);
+  /* Track of identifier inId, NULL if there is none */
+  static Track * findTrack(const uint16_t inId)
+  {
+    return (sTracks != NULL && inId < sTrackTableSize) ? sTracks[inId] : NULL;
+  }
+  /* Size of the track table, the highest identifier + 1 once finalized */
+  static uint16_t tableSize() { return sTrackTableSize; }
   static bool checkTrackNet();
   static bool trackNetIsOk() { return sErrorCount == 0; }
+  static uint16_t errorCount() { return sErrorCount; }
+  /*
+   * Connector of this track connected to connector inConnector of
+   * inFrom, -1 if this track is not connected back. When 2 tracks are
+   * connected more than once, the connections are matched in the order
+   * of the connectors.
+   */
+  int8_t connectorBack(Track & inFrom, const Connector inConnector);
+
+  /* Orients the tracks in finalize() */
+  friend class DirectionSolver;
+#ifdef SWITCHMAN_PACKED_TRACKS
+  friend class TrackLink;
+#endif
 };
 
+#ifdef SWITCHMAN_PACKED_TRACKS
+inline TrackLink::TrackLink(const Track * inTrack) :
+  mIndex((inTrack == NULL || inTrack->identifier() >= NO_TRACK_INDEX) ?
+         NO_TRACK_INDEX : inTrack->identifier())
+{
+}
+
+inline TrackLink::operator Track *() const
+{
+  return (mIndex == NO_TRACK_INDEX) ? NULL : Track::sTracks[mIndex];
+}
+#endif
+
 /*
  * Dead-end track
  */
 class DeadendTrack : public Track
 {
 private:
-  Track * mOutTrack;  /* OUTLET connector */
+  TrackLink mOutTrack;  /* OUTLET connector */
 
 public:
+  virtual TrackKind kind() { return DEADEND_TRACK; }
+  virtual Track * connectedTrack(const Connector inConnector);
   virtual ErrorCode connectFrom(Track * inTrack, const Connector inConnector);
   virtual bool allPathsTo(
     const uint16_t inId,
@@ -161,6 +290,11 @@ public:
     const Connector inToConnector
   );
   virtual bool connectionsOk();
+  virtual uint8_t nextTracks(
+    const Direction inDir,
+    const Track * inFrom,
+    Track ** outNext
+  );
 };
 
 /*
@@ -169,10 +303,15 @@ public:
 class BlockTrack : public Track
 {
 private:
-  Track * mInTrack;   /* INLET connector  */
-  Track * mOutTrack;  /* OUTLET connector */
+  TrackLink mInTrack;   /* INLET connector  */
+  TrackLink mOutTrack;  /* OUTLET connector */
+  BlockChain * mChain; /* Chain of blocks this block belongs to, if any */
+
+  friend class BlockChain;
 
 public:
+  virtual TrackKind kind() { return BLOCK_TRACK; }
+  virtual Track * connectedTrack(const Connector inConnector);
   virtual bool isBlock() { return true; }
   virtual ErrorCode connectFrom(Track * inTrack, const Connector inConnector);
   virtual bool allPathsTo(
@@ -190,6 +329,11 @@ public:
     const Connector inToConnector
   );
   virtual bool connectionsOk();
+  virtual uint8_t nextTracks(
+    const Direction inDir,
+    const Track * inFrom,
+    Track ** outNext
+  );
 };
 
 /*
@@ -198,13 +342,14 @@ public:
 class TurnoutTrack : public Track
 {
 private:
-  Track * mInTrack;       /* INLET connector        */
-  Track * mOutLeftTrack;  /* LEFT_OUTLET connector  */
-  Track * mOutRightTrack; /* RIGHT_OUTLET connector */
-  PathSet * mPartialPath;
-  Position mPosition;    /* The position of the Turnout */
+  TrackLink mInTrack;       /* INLET connector        */
+  TrackLink mOutLeftTrack;  /* LEFT_OUTLET connector  */
+  TrackLink mOutRightTrack; /* RIGHT_OUTLET connector */
+  Position mPosition:3;  /* The position of the Turnout */
 
 public:
+  virtual TrackKind kind() { return TURNOUT_TRACK; }
+  virtual Track * connectedTrack(const Connector inConnector);
   virtual ErrorCode connectFrom(Track * inTrack, const Connector inConnector);
   virtual bool allPathsTo(
     const uint16_t inId,
@@ -221,6 +366,51 @@ public:
     const Connector inToConnector
   );
   virtual bool connectionsOk();
+  virtual uint8_t nextTracks(
+    const Direction inDir,
+    const Track * inFrom,
+    Track ** outNext
+  );
+
+  void setPosition(const Position inPosition);
+};
+
+/*
+ * Three-way turnout track
+ */
+class ThreeWayTrack : public Track
+{
+private:
+  TrackLink mInTrack;       /* INLET connector        */
+  TrackLink mOutLeftTrack;  /* LEFT_OUTLET connector  */
+  TrackLink mOutTrack;      /* OUTLET connector       */
+  TrackLink mOutRightTrack; /* RIGHT_OUTLET connector */
+  Position mPosition:3;   /* The position of the three-way turnout */
+
+public:
+  virtual TrackKind kind() { return THREEWAY_TRACK; }
+  virtual Track * connectedTrack(const Connector inConnector);
+  virtual ErrorCode connectFrom(Track * inTrack, const Connector inConnector);
+  virtual bool allPathsTo(
+    const uint16_t inId,
+    const Direction inDir,
+    PathSet & ioPaths,
+    const Track * inFrom,
+    HeadedTrackSet & ioMarking
+  );
+
+  ThreeWayTrack(NAME_DECL_FIRST(inName) const uint16_t inId);
+  virtual ErrorCode connect(
+    const Connector inFromConnector,
+    Track & inToTrack,
+    const Connector inToConnector
+  );
+  virtual bool connectionsOk();
+  virtual uint8_t nextTracks(
+    const Direction inDir,
+    const Track * inFrom,
+    Track ** outNext
+  );
 
   void setPosition(const Position inPosition);
 };
@@ -231,12 +421,14 @@ public:
 class CrossingTrack : public Track
 {
 protected:
-  Track * mInLeftTrack;
-  Track * mInRightTrack;
-  Track * mOutLeftTrack;
-  Track * mOutRightTrack;
+  TrackLink mInLeftTrack;
+  TrackLink mInRightTrack;
+  TrackLink mOutLeftTrack;
+  TrackLink mOutRightTrack;
 
 public:
+  virtual TrackKind kind() { return CROSSING_TRACK; }
+  virtual Track * connectedTrack(const Connector inConnector);
   virtual ErrorCode connectFrom(Track * inTrack, const Connector inConnector);
   virtual bool allPathsTo(
     const uint16_t inId,
@@ -246,6 +438,9 @@ public:
     HeadedTrackSet & ioMarking
   );
 
+  virtual uint8_t entryCount() { return 2; }
+  virtual uint8_t entryOf(const Track * inFrom);
+
   CrossingTrack(NAME_DECL_FIRST(inName) const uint16_t inId);
   virtual ErrorCode connect(
     const Connector inFromConnector,
@@ -253,31 +448,107 @@ public:
     const Connector inToConnector
   );
   virtual bool connectionsOk();
+  virtual uint8_t nextTracks(
+    const Direction inDir,
+    const Track * inFrom,
+    Track ** outNext
+  );
 };
 
 /*
  * Double slip track
+ * The 4 routes (straight and crossing) are given by a connector to
+ * connector table so the double slip is gone through in one step.
+ */
+class DoubleslipTrack : public CrossingTrack
+{
+private:
+  Position mInPosition:3;     /* The position of on the In side  */
+  Position mOutPosition:3;    /* The position of on the Out side */
+
+  /* Connectors reachable from each connector */
+  static const uint8_t sRoutes[4];
+
+  Track * connectorTrack(const uint8_t inConnector) const;
+  uint8_t connectorOf(const Track * inTrack) const;
+
+public:
+  virtual TrackKind kind() { return DOUBLESLIP_TRACK; }
+  virtual bool allPathsTo(
+    const uint16_t inId,
+    const Direction inDir,
+    PathSet & ioPaths,
+    const Track * inFrom,
+    HeadedTrackSet & ioMarking
+  );
+  virtual uint8_t nextTracks(
+    const Direction inDir,
+    const Track * inFrom,
+    Track ** outNext
+  );
+  /* A double slip is marked as a whole */
+  virtual uint8_t entryCount() { return 1; }
+  virtual uint8_t entryOf(__attribute__((unused)) const Track * inFrom) { return 0; }
+
+  DoubleslipTrack(NAME_DECL_FIRST(inName) const uint16_t inId);
+
+  void setInPosition(const Position inPosition);
+  void setOutPosition(const Position outPosition);
+};
+
+/*
+ * Route through a scissors crossover, from a connector to another one,
+ * and the position it needs
+ */
+typedef struct {
+  uint8_t from;       /* Inlet connector  */
+  uint8_t to;         /* Outlet connector */
+  Position position;
+} ScissorsRoute;
+
+#define SCISSORS_ROUTE_COUNT 4
+
+/*
+ * Scissors crossover track
+ * Two parallel roads, the left one from LEFT_INLET to LEFT_OUTLET and
+ * the right one from RIGHT_INLET to RIGHT_OUTLET, linked by 2 crossovers
+ * from LEFT_INLET to RIGHT_OUTLET and from RIGHT_INLET to LEFT_OUTLET.
+ * It has the connectors of a crossing and, like the ways of a crossing,
+ * each road is gone through on its own: a route may take both roads.
+ * A search does not start on it since it does not know the road.
  */
-// class DoubleslipTrack : public CrossingTrack
-// {
-// private:
-//   PathSet * mPartialPath[2];
-//   Position mInPosition:3;     /* The position of on the In side  */
-//   Position mOutPosition:3;    /* The position of on the Out side */
-//
-// public:
-//   virtual bool allPathsTo(
-//     const uint16_t inId,
-//     const Direction inDir,
-//     PathSet & ioPaths,
-//     const Track * inFrom,
-//     HeadedTrackSet & ioMarking
-//   );
-//
-//   DoubleslipTrack(NAME_DECL_FIRST(inName) const uint16_t inId);
-//
-//   void setInPosition(const Position inPosition);
-//   void setOutPosition(const Position outPosition);
-// };
+class ScissorsTrack : public CrossingTrack
+{
+private:
+  Position mPosition:3; /* STRAIGHT_POSITION, LEFT_POSITION for the
+                           crossover from LEFT_INLET, RIGHT_POSITION for
+                           the one from RIGHT_INLET */
+
+  static const ScissorsRoute sRoutes[SCISSORS_ROUTE_COUNT];
+
+public:
+  virtual TrackKind kind() { return SCISSORS_TRACK; }
+  virtual bool allPathsTo(
+    const uint16_t inId,
+    const Direction inDir,
+    PathSet & ioPaths,
+    const Track * inFrom,
+    HeadedTrackSet & ioMarking
+  );
+  virtual uint8_t nextTracks(
+    const Direction inDir,
+    const Track * inFrom,
+    Track ** outNext
+  );
+  /* 0 for the left road, 1 for the right one */
+  virtual uint8_t entryOf(const Track * inFrom);
+
+  ScissorsTrack(NAME_DECL_FIRST(inName) const uint16_t inId);
+
+  /* Position to go from connector inFrom to inTo, NO_POSITION if none */
+  static Position positionFor(const Connector inFrom, const Connector inTo);
+  void setPosition(const Position inPosition);
+  Position position() const { return mPosition; }
+};
 
 #endif /* __TRACK_H__ */
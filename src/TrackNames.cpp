@@ -0,0 +1,178 @@
+/*
+ * TrackNames : names of the tracks and lookup of a track by its name.
+ */
+#include "TrackNames.h"
+
+#ifdef SWITCHMAN_TRACK_NAMES
+
+#include "Track.h"
+#include "HardwareSerial.h"
+
+#ifdef SWITCHMAN_STATIC_TRACK_TABLE
+/* Defined by TRACK_TABLE() in the sketch, after the tracks */
+extern NameOffset switchmanTrackNameTable[];
+extern const uint16_t switchmanTrackTableSize;
+NameOffset *TrackNames::sOffsets = switchmanTrackNameTable;
+#else
+NameOffset *TrackNames::sOffsets = NULL;
+#endif
+uint16_t TrackNames::sTableSize = 0;
+uint16_t *TrackNames::sIndex = NULL;
+uint16_t TrackNames::sIndexSize = 0;
+#ifndef __AVR__
+char *TrackNames::sPool = NULL;
+NameOffset TrackNames::sPoolSize = 0;
+NameOffset TrackNames::sPoolCapacity = 0;
+NameOffset TrackNames::sLastOffset = 0;
+#endif
+
+/*
+ * Compare 2 names in flash memory
+ */
+static int compareNames(const char *inA, const char *inB)
+{
+  uint8_t a, b;
+  do {
+    a = pgm_read_byte(inA++);
+    b = pgm_read_byte(inB++);
+  } while (a == b && a != '\0');
+  return (int)a - (int)b;
+}
+
+/*---------------------------------------------------------------------------*/
+void TrackNames::add(const uint16_t inId, const char *inName)
+{
+#ifdef SWITCHMAN_STATIC_TRACK_TABLE
+  if (inId >= switchmanTrackTableSize) return;
+  if (inId >= sTableSize) sTableSize = inId + 1;
+#else
+  if (inId >= sTableSize) {
+    uint16_t size = (sTableSize == 0) ? 16 : sTableSize;
+    while (size <= inId) size <<= 1;
+    sOffsets = (NameOffset *)realloc(sOffsets, size * sizeof(NameOffset));
+    sTableSize = size;
+  }
+#endif
+
+#ifdef __AVR__
+  sOffsets[inId] = (NameOffset)inName;
+#else
+  if (sPool == NULL || strcmp(inName, sPool + sLastOffset) != 0) {
+    const NameOffset length = strlen(inName) + 1;
+    if (sPoolSize + length > sPoolCapacity) {
+      NameOffset capacity = (sPoolCapacity == 0) ? 256 : sPoolCapacity;
+      while (sPoolSize + length > capacity) capacity <<= 1;
+      sPool = (char *)realloc(sPool, capacity);
+      sPoolCapacity = capacity;
+    }
+    memcpy(sPool + sPoolSize, inName, length);
+    sLastOffset = sPoolSize;
+    sPoolSize += length;
+  }
+  sOffsets[inId] = sLastOffset;
+#endif
+  /* The index is built again by finalize() */
+  if (sIndex != NULL) {
+    free(sIndex);
+    sIndex = NULL;
+    sIndexSize = 0;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+const char *TrackNames::name(const uint16_t inId)
+{
+#ifdef __AVR__
+  return (const char *)sOffsets[inId];
+#else
+  return sPool + sOffsets[inId];
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+int TrackNames::compareIndex(const void *inA, const void *inB)
+{
+  const uint16_t a = *(const uint16_t *)inA;
+  const uint16_t b = *(const uint16_t *)inB;
+  const int result = compareNames(name(a), name(b));
+  if (result != 0) return result;
+  return (a < b) ? -1 : (a > b);
+}
+
+/*---------------------------------------------------------------------------*/
+void TrackNames::buildIndex()
+{
+  /* Identifiers given to no track have no name and are not indexed */
+  const uint16_t size = Track::tableSize();
+#ifndef SWITCHMAN_STATIC_TRACK_TABLE
+  if (sTableSize > size && size > 0) {
+    sOffsets = (NameOffset *)realloc(sOffsets, size * sizeof(NameOffset));
+    sTableSize = size;
+  }
+#endif
+#ifndef __AVR__
+  if (sPoolCapacity > sPoolSize && sPoolSize > 0) {
+    sPool = (char *)realloc(sPool, sPoolSize);
+    sPoolCapacity = sPoolSize;
+  }
+#endif
+  if (sIndex != NULL) free(sIndex);
+  sIndex = NULL;
+  sIndexSize = 0;
+  const uint16_t count = Track::count();
+  if (count == 0 || size > sTableSize) return;
+  sIndex = (uint16_t *)malloc(count * sizeof(uint16_t));
+  if (sIndex == NULL) return;
+  uint16_t indexed = 0;
+  for (uint16_t id = 0; id < size && indexed < count; id++) {
+    if (Track::findTrack(id) != NULL) sIndex[indexed++] = id;
+  }
+  qsort(sIndex, indexed, sizeof(uint16_t), compareIndex);
+  sIndexSize = indexed;
+}
+
+/*---------------------------------------------------------------------------*/
+void TrackNames::print(const uint16_t inId)
+{
+#ifdef __AVR__
+  Serial.print((const __FlashStringHelper *)name(inId));
+#else
+  Serial.print(name(inId));
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+uint16_t TrackNames::idForName(const char *inName)
+{
+  const uint16_t count = Track::count();
+  if (sIndex == NULL) {
+    /* Not finalized yet */
+    for (uint16_t id = 0; id < Track::tableSize() && id < sTableSize; id++) {
+      if (Track::findTrack(id) != NULL && strcmp_P(inName, name(id)) == 0) return id;
+    }
+    return count;
+  }
+  /* First identifier whose name is not lower than inName */
+  uint16_t low = 0;
+  uint16_t high = sIndexSize;
+  while (low < high) {
+    const uint16_t middle = (low + high) >> 1;
+    if (strcmp_P(inName, name(sIndex[middle])) > 0) low = middle + 1;
+    else high = middle;
+  }
+  if (low < sIndexSize && strcmp_P(inName, name(sIndex[low])) == 0) return sIndex[low];
+  return count;
+}
+
+/*---------------------------------------------------------------------------*/
+uint32_t TrackNames::footprint()
+{
+  uint32_t bytes = (uint32_t)sIndexSize * sizeof(uint16_t);
+  bytes += (uint32_t)sTableSize * sizeof(NameOffset);
+#ifndef __AVR__
+  bytes += sPoolCapacity;
+#endif
+  return bytes;
+}
+
+#endif /* SWITCHMAN_TRACK_NAMES */
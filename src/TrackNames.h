@@ -0,0 +1,81 @@
+/*
+ * TrackNames : names of the tracks and lookup of a track by its name.
+ *
+ * The names are kept when SWITCHMAN_TRACK_NAMES is defined in the build
+ * flags, and always in DEBUG and TRACE builds that display them. TRACK()
+ * then gives the name of each track to its constructor.
+ *
+ * The names are kept out of the tracks in a table of offsets indexed by
+ * track identifier:
+ * - on AVR, the pool is the flash memory and the offset of a name is its
+ *   PROGMEM address, so the names take no RAM but the 2 bytes of their
+ *   offset;
+ * - on the host, the names are copied in one string pool. A name given
+ *   to several tracks in a row, as the generated nets do, is copied once.
+ * Track::finalize() sorts the identifiers by name, 2 bytes per track, so
+ * idForName() finds a track in O(log n) comparisons. print() streams a
+ * name to Serial from the flash memory, without copying it.
+ *
+ *   uint16_t id = TrackNames::idForName("voie1");
+ *   if (id < Track::count()) TrackNames::print(id);
+ */
+#ifndef __TRACKNAMES_H__
+#define __TRACKNAMES_H__
+
+#include "Arduino.h"
+#include "Debug.h"
+
+#if (defined(DEBUG) || defined(TRACE)) && ! defined(SWITCHMAN_TRACK_NAMES)
+#define SWITCHMAN_TRACK_NAMES
+#endif
+
+#ifdef SWITCHMAN_TRACK_NAMES
+
+#ifdef __AVR__
+typedef uint16_t NameOffset;
+#else
+typedef uint32_t NameOffset;
+#endif
+
+class TrackNames
+{
+  private:
+    static NameOffset *sOffsets;    /* Offset of the name of each track   */
+    static uint16_t sTableSize;
+    static uint16_t *sIndex;        /* Identifiers sorted by name         */
+    static uint16_t sIndexSize;
+#ifndef __AVR__
+    static char *sPool;             /* Names, NUL terminated              */
+    static NameOffset sPoolSize;
+    static NameOffset sPoolCapacity;
+    static NameOffset sLastOffset;  /* Offset of the name copied last     */
+#endif
+
+    static int compareIndex(const void *inA, const void *inB);
+
+  public:
+    /* Keep the name of track inId, called by the constructor of Track */
+    static void add(const uint16_t inId, const char *inName);
+    /* Sort the identifiers by name, called by Track::finalize() */
+    static void buildIndex();
+    static bool isIndexed() { return sIndex != NULL; }
+    /*
+     * Name of a track, in flash memory on AVR. On the host, the name
+     * moves when a track is made.
+     */
+    static const char *name(const uint16_t inId);
+    /* Print the name of a track on Serial */
+    static void print(const uint16_t inId);
+    /*
+     * Identifier of the track named inName, a string in RAM, or
+     * Track::count() if there is none. The lowest identifier is given
+     * when tracks share the name.
+     */
+    static uint16_t idForName(const char *inName);
+    /* Bytes of RAM used by the names */
+    static uint32_t footprint();
+};
+
+#endif /* SWITCHMAN_TRACK_NAMES */
+
+#endif /* __TRACKNAMES_H__ */
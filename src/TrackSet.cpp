@@ -5,15 +5,28 @@
  *  - 0 elle n'appartient pas à l'ensemble.
  */
 #include "TrackSet.h"
+#include "Profile.h"
+#include "HeapStats.h"
 
-void TrackSet::allocate()
+void TrackSet::allocate(__attribute__((unused)) const uint8_t inHeapKind)
 {
+  PROFILE_SCOPE(PROFILE_ALLOCATION);
   mSet = new uint8_t[Track::sizeForSet()];
+#ifdef SWITCHMAN_HEAP_STATS
+  mHeapKind = inHeapKind;
+  HEAP_ALLOCATED(inHeapKind, Track::sizeForSet());
+#endif
 }
 
 TrackSet::TrackSet()
 {
-  allocate();
+  allocate(HEAP_SETS);
+  clear();
+}
+
+TrackSet::TrackSet(const uint8_t inHeapKind)
+{
+  allocate(inHeapKind);
   clear();
 }
 
@@ -21,7 +34,13 @@ TrackSet::TrackSet(const TrackSet & set)
 {
 //  Serial.println("  Constructeur par recopie");
 //  delay(1000);
-  allocate();
+  allocate(HEAP_SETS);
+  operator=(set);
+}
+
+TrackSet::TrackSet(const TrackSet & set, const uint8_t inHeapKind)
+{
+  allocate(inHeapKind);
   operator=(set);
 }
 
@@ -29,7 +48,8 @@ TrackSet::~TrackSet()
 {
 //  Serial.println("  destruction d'un ensemble de voies");
 //  delay(1000);
-  delete mSet;
+  HEAP_FREED(mHeapKind, Track::sizeForSet());
+  delete [] mSet;
 //  Serial.println("  destruction terminee");
 //  delay(1000);
 }
@@ -49,17 +69,24 @@ bool TrackSet::isEmpty()
   return true;
 }
 
-void TrackSet::addTrack(const uint8_t inId)
+void TrackSet::addTrack(const uint16_t inId)
 {
   mSet[inId >> 3] |= 1 << (inId & 7);
 }
 
-void TrackSet::removeTrack(const uint8_t inId)
+void TrackSet::addTrackSet(const TrackSet & inSet)
+{
+  for (uint8_t i = 0; i < Track::sizeForSet(); i++) {
+    mSet[i] |= inSet.mSet[i];
+  }
+}
+
+void TrackSet::removeTrack(const uint16_t inId)
 {
   mSet[inId >> 3] &= ~(1 << (inId & 7));
 }
 
-bool TrackSet::containsTrack(const uint8_t inId)
+bool TrackSet::containsTrack(const uint16_t inId)
 {
   return (mSet[inId >> 3] & 1 << (inId & 7)) != 0;
 }
@@ -89,7 +116,7 @@ void TrackSet::print()
   for (uint8_t i = 0; i < Track::sizeForSet(); i++) {
     uint8_t subVec = mSet[i];
     for (uint8_t j = 0; j < 8; j++) {
-      uint8_t id = (i << 3) + j;
+      uint16_t id = (i << 3) + j;
       if (subVec & (1 << j)) {
         emptySet = false;
         Track::trackForId(id).print();
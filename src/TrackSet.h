@@ -14,10 +14,17 @@
 class TrackSet
 {
   private:
-    void allocate();
+    void allocate(const uint8_t inHeapKind);
 
   protected:
     uint8_t *mSet;
+#ifdef SWITCHMAN_HEAP_STATS
+    uint8_t mHeapKind; /* Subsystem of the set in HeapStats */
+#endif
+
+    /* Set counted in another subsystem of HeapStats */
+    TrackSet(const uint8_t inHeapKind);
+    TrackSet(const TrackSet & set, const uint8_t inHeapKind);
 
   public:
     TrackSet(); /* Construit un ensemble vide */
@@ -25,15 +32,19 @@ class TrackSet
     ~TrackSet();
     void clear();
     bool isEmpty();
-    void addTrack(const uint8_t inId);
+    void addTrack(const uint16_t inId);
     void addTrack(const Track & inTrack) { addTrack(inTrack.identifier()); }
     void addTrack(const Track * inTrack) { addTrack(inTrack->identifier()); }
-    void removeTrack(const uint8_t inId);
+    void addTrackSet(const TrackSet & inSet);
+    void removeTrack(const uint16_t inId);
     void removeTrack(const Track & inTrack) { removeTrack(inTrack.identifier()); }
     void removeTrack(const Track * inTrack) { removeTrack(inTrack->identifier()); }
-    bool containsTrack(const uint8_t inId);
+    bool containsTrack(const uint16_t inId);
     bool containsTrack(const Track * inTrack) { return containsTrack(inTrack->identifier()); }
     bool containsTrack(const Track & inTrack) { return containsTrack(inTrack.identifier()); }
+    /* Byte of the bit vector, Track::sizeForSet() bytes */
+    uint8_t byteAt(const uint8_t inIndex) const { return mSet[inIndex]; }
+    void setByteAt(const uint8_t inIndex, const uint8_t inByte) { mSet[inIndex] = inByte; }
     TrackSet & operator=(const TrackSet & set);
     bool operator==(TrackSet & set);
 
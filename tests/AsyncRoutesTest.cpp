@@ -0,0 +1,93 @@
+/*
+ * Test of the asynchronous route queries on the layout of examples/dom:
+ * the awaits find the routes of a PathSearch run at once and take their
+ * searches from the pool of the router, which does not grow once it
+ * holds a search per await at once.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SwitchMan.h"
+#include "Specifs.h"
+#include "AsyncRoutes.h"
+#include "Check.h"
+
+#define ARENA_SIZE 8192
+
+static EventLoop eventLoop;
+static AsyncRouter router(eventLoop, 1);
+static uint16_t finished = 0;
+
+/* Number of routes found by a PathSearch run at once */
+static uint16_t routeCount(const uint16_t inFrom, const uint16_t inTo, const Direction inDir)
+{
+  PathSet paths;
+  PathSearch search;
+  if (search.start(Track::trackForId(inFrom), inTo, inDir, paths)) {
+    while (! search.step(0xFFFF));
+  }
+  uint16_t count = 0;
+  for (Path *path = paths.firstPath(); path != NULL; path = path->next()) {
+    if (! path->isEmpty()) count++;
+  }
+  return count;
+}
+
+/* Every pair from inFrom, one await after the other */
+AsyncTask queries(const uint16_t inFrom, const Direction inDir)
+{
+  uint8_t buffer[ARENA_SIZE];
+  RouteArena routes(buffer, sizeof(buffer));
+  for (uint16_t to = 0; to < Track::count(); to++) {
+    const bool found = co_await router.pathsTo(Track::trackForId(inFrom), to, inDir, routes);
+    const uint16_t count = routeCount(inFrom, to, inDir);
+    CHECK(! routes.overflow());
+    CHECK(routes.count() == count);
+    CHECK(found == (count > 0));
+  }
+  finished++;
+}
+
+void setup()
+{
+  export_setup();
+  Track::finalize();
+  if (! Track::trackNetIsOk()) {
+    fprintf(stderr, "async: the track net is not ok\n");
+    exit(1);
+  }
+
+  /* One await at a time, a single search is made */
+  queries(voie23_id, FORWARD_DIRECTION);
+  CHECK(eventLoop.searchCount() == 1);
+  eventLoop.run();
+  CHECK(finished == 1);
+  CHECK(router.searchCount() == 1);
+
+  /* Three at once, each one its own search, then reused */
+  for (uint8_t round = 0; round < 2; round++) {
+    queries(voie1_id, FORWARD_DIRECTION);
+    queries(voie5_id, BACKWARD_DIRECTION);
+    queries(voie29_id, FORWARD_DIRECTION);
+    CHECK(eventLoop.searchCount() == 3);
+    eventLoop.run();
+  }
+  CHECK(finished == 7);
+  CHECK(router.searchCount() == 3);
+
+  /* Searches made ahead */
+  router.reserve(4);
+  CHECK(router.searchCount() == 4);
+  const uint16_t origins[] = { voie2_id, voie3_id, voie4_id, voie6_id };
+  for (uint8_t q = 0; q < 4; q++) queries(origins[q], FORWARD_DIRECTION);
+  eventLoop.run();
+  CHECK(finished == 11);
+  CHECK(router.searchCount() == 4);
+
+  fprintf(stderr, "%u checks, %u failed\n", (unsigned)checks, (unsigned)failures);
+  exit(failures == 0 ? 0 : 1);
+}
+
+void loop()
+{
+}
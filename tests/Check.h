@@ -0,0 +1,26 @@
+/*
+ * Checks of the tests. CHECK counts the condition and, when it is false,
+ * writes its file, line and text on stderr and counts the failure. Each
+ * test is a program of its own, with its own counters.
+ */
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+static uint32_t checks = 0;
+static uint32_t failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+static inline void check(const bool inOk, const char *inText, const char *inFile, const int inLine)
+{
+  checks++;
+  if (! inOk) {
+    failures++;
+    fprintf(stderr, "%s:%d: check failed: %s\n", inFile, inLine, inText);
+  }
+}
+
+#endif /* __CHECK_H__ */
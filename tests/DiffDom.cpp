@@ -0,0 +1,33 @@
+/*
+ * Differential test of the route searches on the layout of examples/dom:
+ * the routes of every engine are compared with the ones of RouteOracle,
+ * without then with the ReachabilityIndex.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "RouteOracle.h"
+#include "Specifs.h"
+
+void setup()
+{
+  export_setup();
+  Track::finalize();
+  if (! Track::trackNetIsOk()) {
+    fprintf(stderr, "dom: the track net is not ok\n");
+    exit(1);
+  }
+
+  /* Without the index built by finalize() first */
+  ReachabilityIndex::clear();
+  uint32_t differences = RouteOracle::checkAllPairs("dom", 20);
+  ReachabilityIndex::build();
+  differences += RouteOracle::checkAllPairs("dom indexed", 20);
+
+  fprintf(stderr, "%u differences with the oracle\n", (unsigned)differences);
+  exit(differences == 0 ? 0 : 1);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,155 @@
+/*
+ * Differential test of the route searches on a layout with a reversing
+ * loop and a wye, made at run time: DirectionSolver puts a joint in
+ * each, and the routes of every engine are compared with the ones of
+ * RouteOracle, without then with the ReachabilityIndex.
+ *
+ *   d0 -- b1 -- t2 -left-- b3 --+        balloon, back to t2 right
+ *                 \-right- b4 --+        by the outlet of b4
+ *
+ *   d5 -- b6 -- t7 -left-- b8 ----- t10 left    wye of t7, t10, t11
+ *                 \-right- b9 ---- t11 right   t10 right -- b12 --
+ *                                               t11 left, tails b13
+ *                                               -- d14 and b15 -- d16
+ *
+ *   d17 -- b18 -- b19 -- d20   b19 connected by its inlet, turned
+ *
+ *   d21 -- b22 -- s23 left road -- b24 -- b27 --+   oval by both roads
+ *                 s23 right road ---------------+   of the scissors s23,
+ *                                                   right outlet to b25
+ *                 b25 -- d26
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "RouteOracle.h"
+#include "Check.h"
+
+static void buildLayout()
+{
+  DeadendTrack *d0 = new DeadendTrack(NAME_ARG_FIRST("d0") 0);
+  BlockTrack *b1 = new BlockTrack(NAME_ARG_FIRST("b1") 1);
+  TurnoutTrack *t2 = new TurnoutTrack(NAME_ARG_FIRST("t2") 2);
+  BlockTrack *b3 = new BlockTrack(NAME_ARG_FIRST("b3") 3);
+  BlockTrack *b4 = new BlockTrack(NAME_ARG_FIRST("b4") 4);
+  d0->connect(OUTLET, *b1, INLET);
+  b1->connect(OUTLET, *t2, INLET);
+  t2->connect(LEFT_OUTLET, *b3, INLET);
+  b3->connect(OUTLET, *b4, INLET);
+  b4->connect(OUTLET, *t2, RIGHT_OUTLET);
+
+  DeadendTrack *d5 = new DeadendTrack(NAME_ARG_FIRST("d5") 5);
+  BlockTrack *b6 = new BlockTrack(NAME_ARG_FIRST("b6") 6);
+  TurnoutTrack *t7 = new TurnoutTrack(NAME_ARG_FIRST("t7") 7);
+  BlockTrack *b8 = new BlockTrack(NAME_ARG_FIRST("b8") 8);
+  BlockTrack *b9 = new BlockTrack(NAME_ARG_FIRST("b9") 9);
+  TurnoutTrack *t10 = new TurnoutTrack(NAME_ARG_FIRST("t10") 10);
+  TurnoutTrack *t11 = new TurnoutTrack(NAME_ARG_FIRST("t11") 11);
+  BlockTrack *b12 = new BlockTrack(NAME_ARG_FIRST("b12") 12);
+  BlockTrack *b13 = new BlockTrack(NAME_ARG_FIRST("b13") 13);
+  DeadendTrack *d14 = new DeadendTrack(NAME_ARG_FIRST("d14") 14);
+  BlockTrack *b15 = new BlockTrack(NAME_ARG_FIRST("b15") 15);
+  DeadendTrack *d16 = new DeadendTrack(NAME_ARG_FIRST("d16") 16);
+  d5->connect(OUTLET, *b6, INLET);
+  b6->connect(OUTLET, *t7, INLET);
+  t7->connect(LEFT_OUTLET, *b8, INLET);
+  t7->connect(RIGHT_OUTLET, *b9, INLET);
+  b8->connect(OUTLET, *t10, LEFT_OUTLET);
+  b9->connect(OUTLET, *t11, RIGHT_OUTLET);
+  t10->connect(RIGHT_OUTLET, *b12, INLET);
+  b12->connect(OUTLET, *t11, LEFT_OUTLET);
+  t10->connect(INLET, *b13, INLET);
+  b13->connect(OUTLET, *d14, OUTLET);
+  t11->connect(INLET, *b15, INLET);
+  b15->connect(OUTLET, *d16, OUTLET);
+
+  DeadendTrack *d17 = new DeadendTrack(NAME_ARG_FIRST("d17") 17);
+  BlockTrack *b18 = new BlockTrack(NAME_ARG_FIRST("b18") 18);
+  BlockTrack *b19 = new BlockTrack(NAME_ARG_FIRST("b19") 19);
+  DeadendTrack *d20 = new DeadendTrack(NAME_ARG_FIRST("d20") 20);
+  d17->connect(OUTLET, *b18, INLET);
+  /* Connected from its inlet, b19 is given the backward direction */
+  b19->connect(INLET, *b18, OUTLET);
+  b19->connect(OUTLET, *d20, OUTLET);
+
+  DeadendTrack *d21 = new DeadendTrack(NAME_ARG_FIRST("d21") 21);
+  BlockTrack *b22 = new BlockTrack(NAME_ARG_FIRST("b22") 22);
+  ScissorsTrack *s23 = new ScissorsTrack(NAME_ARG_FIRST("s23") 23);
+  BlockTrack *b24 = new BlockTrack(NAME_ARG_FIRST("b24") 24);
+  BlockTrack *b25 = new BlockTrack(NAME_ARG_FIRST("b25") 25);
+  DeadendTrack *d26 = new DeadendTrack(NAME_ARG_FIRST("d26") 26);
+  d21->connect(OUTLET, *b22, INLET);
+  b22->connect(OUTLET, *s23, LEFT_INLET);
+  s23->connect(LEFT_OUTLET, *b24, INLET);
+  BlockTrack *b27 = new BlockTrack(NAME_ARG_FIRST("b27") 27);
+  b24->connect(OUTLET, *b27, INLET);
+  b27->connect(OUTLET, *s23, RIGHT_INLET);
+  s23->connect(RIGHT_OUTLET, *b25, INLET);
+  b25->connect(OUTLET, *d26, OUTLET);
+}
+
+void setup()
+{
+  buildLayout();
+  Track::finalize();
+  if (! Track::trackNetIsOk()) {
+    fprintf(stderr, "loops: the track net is not ok\n");
+    exit(1);
+  }
+
+  CHECK(DirectionSolver::jointCount() == 2);
+  CHECK(DirectionSolver::changedCount() > 0);
+  CHECK(Track::trackForId(19).direction() == Track::trackForId(18).direction());
+  LayoutReport report;
+  report.build();
+  CHECK(report.isOk());
+  CHECK(report.count(REVERSING_JOINT) == 2);
+
+  /* Without the index built by finalize() first */
+  CHECK(ReachabilityIndex::isBuilt());
+  ReachabilityIndex::clear();
+
+  /* Around the balloon and back to the dead end it starts from */
+  PathSet routes;
+  CHECK(Track::trackForId(1).pathsTo(0, FORWARD_DIRECTION, routes));
+  /* The search of pathsTo is taken from the pool, it counts its visits */
+  std::vector<TrackExploration> exploration(Track::count(), TrackExploration());
+  PathSearch *pooled = PathSearch::acquire();
+  pooled->setExploration(exploration.data());
+  PathSearch::release(pooled);
+  PathSet again;
+  CHECK(Track::trackForId(1).pathsTo(0, FORWARD_DIRECTION, again));
+  CHECK(exploration[0].visits > 0);
+  pooled = PathSearch::acquire();
+  pooled->setExploration(NULL);
+  PathSearch::release(pooled);
+  ReversingSearch search(0);
+  LegRouteSet legRoutes;
+  CHECK(search.routesTo(Track::trackForId(1), 0, FORWARD_DIRECTION, legRoutes));
+  CHECK(legRoutes.count() > 0);
+  if (legRoutes.count() > 0) CHECK(legRoutes.firstRoute()->legCount() == 1);
+
+  /* By the crossover, or along the left road, around and the right one */
+  PathSet bothRoads;
+  CHECK(Track::trackForId(22).pathsTo(25, FORWARD_DIRECTION, bothRoads));
+  CHECK(bothRoads.count() == 2);
+  /* Found again, though not added again to the same set */
+  CHECK(Track::trackForId(22).pathsTo(25, FORWARD_DIRECTION, bothRoads));
+  CHECK(bothRoads.count() == 2);
+  CHECK(ScissorsTrack::positionFor(LEFT_INLET, RIGHT_OUTLET) == LEFT_POSITION);
+  CHECK(ScissorsTrack::positionFor(RIGHT_OUTLET, RIGHT_INLET) == STRAIGHT_POSITION);
+  CHECK(ScissorsTrack::positionFor(LEFT_INLET, RIGHT_INLET) == NO_POSITION);
+
+  uint32_t differences = RouteOracle::checkAllPairs("loops", 20);
+  ReachabilityIndex::build();
+  CHECK(ReachabilityIndex::reaches(1, 0, FORWARD_DIRECTION));
+  differences += RouteOracle::checkAllPairs("loops indexed", 20);
+
+  fprintf(stderr, "%u differences with the oracle, %u failures\n",
+          (unsigned)differences, (unsigned)failures);
+  exit(differences == 0 && failures == 0 ? 0 : 1);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,314 @@
+/*
+ * Differential test of the route searches on random layouts: the routes
+ * of every engine are compared with the ones of RouteOracle.
+ *
+ * Each layout is built from a seed in a child process since the tracks
+ * are registered in a static table that cannot be emptied. A failing
+ * layout is reported by its seed and may be run again alone:
+ *
+ *   SWITCHMAN_DIFF_SEED=1234 SWITCHMAN_DIFF_LAYOUTS=1 switchman_diff_random
+ *
+ * SWITCHMAN_DIFF_SEED is the first seed (1 by default) and
+ * SWITCHMAN_DIFF_LAYOUTS the number of layouts (2000 by default).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "RouteOracle.h"
+
+/* Tracks of a layout, the dead ends closing the free connectors apart */
+#define MIN_TRACKS 4
+#define MAX_TRACKS 28
+
+/* Seconds given to a layout before it is counted as failed */
+#define LAYOUT_TIMEOUT 30
+
+static const char PROGMEM randomTrackName[] = "random";
+
+/* The layout written as in a sketch, printed when it fails */
+static std::string sLayout;
+
+static const char *kindName(const uint8_t inKind)
+{
+  static const char *names[] = {
+    "DeadendTrack", "BlockTrack", "TurnoutTrack", "ThreeWayTrack",
+    "CrossingTrack", "DoubleslipTrack", "ScissorsTrack"
+  };
+  return names[inKind];
+}
+
+static const char *connectorName(const Connector inConnector)
+{
+  static const char *names[] = {
+    "INLET", "LEFT_INLET", "RIGHT_INLET", "OUTLET", "LEFT_OUTLET", "RIGHT_OUTLET"
+  };
+  return names[inConnector];
+}
+
+/*
+ * xorshift32, the same sequence on every host
+ */
+static uint32_t sRandom;
+
+static uint32_t randomNumber(const uint32_t inBound)
+{
+  sRandom ^= sRandom << 13;
+  sRandom ^= sRandom >> 17;
+  sRandom ^= sRandom << 5;
+  return sRandom % inBound;
+}
+
+/*
+ * A connector of a track of the layout not connected yet. The forward
+ * travel direction of each track is drawn when the track is made, the
+ * connections are then chosen to agree with it.
+ */
+struct FreeConnector {
+  Track *track;
+  TrackKind kind;
+  Connector connector;
+  bool forward;
+};
+
+static bool isInlet(const Connector inConnector)
+{
+  return inConnector == INLET || inConnector == LEFT_INLET || inConnector == RIGHT_INLET;
+}
+
+static TrackKind randomKind()
+{
+  const uint32_t draw = randomNumber(100);
+  if (draw < 40) return BLOCK_TRACK;
+  if (draw < 65) return TURNOUT_TRACK;
+  if (draw < 72) return THREEWAY_TRACK;
+  if (draw < 80) return CROSSING_TRACK;
+  if (draw < 88) return DOUBLESLIP_TRACK;
+  if (draw < 94) return SCISSORS_TRACK;
+  return DEADEND_TRACK;
+}
+
+static Track *newTrack(
+  const TrackKind inKind,
+  const uint16_t inId,
+  const bool inForward,
+  std::vector<FreeConnector> & ioFree)
+{
+  static const Connector deadendConnectors[] = { OUTLET };
+  static const Connector blockConnectors[] = { INLET, OUTLET };
+  static const Connector turnoutConnectors[] = { INLET, LEFT_OUTLET, RIGHT_OUTLET };
+  static const Connector threeWayConnectors[] = { INLET, LEFT_OUTLET, OUTLET, RIGHT_OUTLET };
+  static const Connector crossingConnectors[] = { LEFT_INLET, RIGHT_INLET, LEFT_OUTLET, RIGHT_OUTLET };
+
+  Track *track = NULL;
+  const Connector *connectors = crossingConnectors;
+  uint8_t count = 4;
+  switch (inKind) {
+    case DEADEND_TRACK:
+      track = new DeadendTrack(NAME_ARG_FIRST(randomTrackName) inId);
+      connectors = deadendConnectors;
+      count = 1;
+      break;
+    case BLOCK_TRACK:
+      track = new BlockTrack(NAME_ARG_FIRST(randomTrackName) inId);
+      connectors = blockConnectors;
+      count = 2;
+      break;
+    case TURNOUT_TRACK:
+      track = new TurnoutTrack(NAME_ARG_FIRST(randomTrackName) inId);
+      connectors = turnoutConnectors;
+      count = 3;
+      break;
+    case THREEWAY_TRACK:
+      track = new ThreeWayTrack(NAME_ARG_FIRST(randomTrackName) inId);
+      connectors = threeWayConnectors;
+      break;
+    case CROSSING_TRACK:
+      track = new CrossingTrack(NAME_ARG_FIRST(randomTrackName) inId);
+      break;
+    case DOUBLESLIP_TRACK:
+      track = new DoubleslipTrack(NAME_ARG_FIRST(randomTrackName) inId);
+      break;
+    case SCISSORS_TRACK:
+      track = new ScissorsTrack(NAME_ARG_FIRST(randomTrackName) inId);
+      break;
+  }
+  char line[64];
+  snprintf(line, sizeof(line), "TRACK(%s, t%u)\n", kindName(inKind), inId);
+  sLayout += line;
+  for (uint8_t i = 0; i < count; i++) {
+    FreeConnector free = { track, inKind, connectors[i], inForward };
+    ioFree.push_back(free);
+  }
+  return track;
+}
+
+/*
+ * The track of the connector travels in its forward direction when it is
+ * left by this connector. A connect call sets the direction of the calling
+ * track to forward when it is left by an outlet, and the direction of the
+ * other track to forward when it is entered by an inlet.
+ */
+static bool leavesForward(const FreeConnector & inConnector)
+{
+  return isInlet(inConnector.connector) != inConnector.forward;
+}
+
+/* Pairs of tracks already connected */
+static std::set<std::pair<Track *, Track *> > sConnected;
+
+/* Crossings and scissors are gone through by ways and are not marked */
+static bool hasWays(const uint8_t inKind)
+{
+  return inKind == CROSSING_TRACK || inKind == SCISSORS_TRACK;
+}
+
+/*
+ * Two connectors may be connected if they are on different tracks not
+ * connected yet, since a track is entered by the track it comes from, not
+ * on 2 tracks with ways, since a loop made of them only has no direction,
+ * and if the travel directions of their tracks agree.
+ */
+static bool mayConnect(const FreeConnector & inA, const FreeConnector & inB)
+{
+  return inA.track != inB.track &&
+         sConnected.count(std::make_pair(inA.track, inB.track)) == 0 &&
+         ! (hasWays(inA.kind) && hasWays(inB.kind)) &&
+         leavesForward(inA) != leavesForward(inB);
+}
+
+static void connect(const FreeConnector & inA, const FreeConnector & inB)
+{
+  char line[64];
+  snprintf(line, sizeof(line), "t%u.connect(%s, t%u, %s);\n",
+           inA.track->identifier(), connectorName(inA.connector),
+           inB.track->identifier(), connectorName(inB.connector));
+  sLayout += line;
+  sConnected.insert(std::make_pair(inA.track, inB.track));
+  sConnected.insert(std::make_pair(inB.track, inA.track));
+  inA.track->connect(inA.connector, *inB.track, inB.connector);
+}
+
+/*
+ * Build the layout of a seed. The free connectors are paired at random
+ * and the connectors left are closed by dead ends.
+ */
+static void buildLayout(const uint32_t inSeed)
+{
+  sRandom = inSeed * 2654435761u + 1;
+  std::vector<FreeConnector> free;
+  const uint16_t trackCount = MIN_TRACKS + randomNumber(MAX_TRACKS - MIN_TRACKS + 1);
+  uint16_t id = 0;
+  while (id < trackCount) {
+    newTrack(randomKind(), id, randomNumber(2) == 0, free);
+    id++;
+  }
+
+  while (! free.empty()) {
+    const FreeConnector a = free[randomNumber(free.size())];
+    std::vector<size_t> candidates;
+    for (size_t i = 0; i < free.size(); i++) {
+      if (mayConnect(a, free[i])) candidates.push_back(i);
+    }
+
+    FreeConnector b;
+    if (candidates.empty()) {
+      /* The dead end is entered by its outlet when a is left forward */
+      std::vector<FreeConnector> deadend;
+      newTrack(DEADEND_TRACK, id++, ! leavesForward(a), deadend);
+      b = deadend[0];
+    }
+    else {
+      b = free[candidates[randomNumber(candidates.size())]];
+    }
+
+    /* The track left forward calls connect */
+    if (leavesForward(a)) connect(a, b);
+    else connect(b, a);
+
+    for (size_t i = 0; i < free.size(); ) {
+      if ((free[i].track == a.track && free[i].connector == a.connector) ||
+          (free[i].track == b.track && free[i].connector == b.connector)) {
+        free.erase(free.begin() + i);
+      }
+      else i++;
+    }
+  }
+}
+
+/*
+ * Run in the child process: build the layout and check it
+ */
+static int checkLayout(const uint32_t inSeed)
+{
+  /* The layouts may set a direction twice, the message is not wanted */
+  if (freopen("/dev/null", "w", stdout) == NULL) return 2;
+  alarm(LAYOUT_TIMEOUT);
+
+  buildLayout(inSeed);
+  Track::finalize();
+  if (! Track::trackNetIsOk()) {
+    fprintf(stderr, "seed %u: the track net is not ok\n%s", (unsigned)inSeed, sLayout.c_str());
+    return 1;
+  }
+
+  /* Without the index built by finalize() first */
+  ReachabilityIndex::clear();
+  char tag[32];
+  snprintf(tag, sizeof(tag), "seed %u", (unsigned)inSeed);
+  uint32_t differences = RouteOracle::checkAllPairs(tag, 5);
+  if (differences == 0) {
+    ReachabilityIndex::build();
+    snprintf(tag, sizeof(tag), "seed %u indexed", (unsigned)inSeed);
+    differences = RouteOracle::checkAllPairs(tag, 5);
+  }
+  if (differences == 0) return 0;
+  fprintf(stderr, "seed %u layout:\n%s", (unsigned)inSeed, sLayout.c_str());
+  return 1;
+}
+
+static uint32_t environmentValue(const char *inName, const uint32_t inDefault)
+{
+  const char *value = getenv(inName);
+  return value == NULL ? inDefault : (uint32_t)strtoul(value, NULL, 10);
+}
+
+void setup()
+{
+  const uint32_t firstSeed = environmentValue("SWITCHMAN_DIFF_SEED", 1);
+  const uint32_t layouts = environmentValue("SWITCHMAN_DIFF_LAYOUTS", 2000);
+  uint32_t failures = 0;
+
+  for (uint32_t seed = firstSeed; seed < firstSeed + layouts; seed++) {
+    fflush(stderr);
+    const pid_t child = fork();
+    if (child < 0) {
+      perror("fork");
+      exit(1);
+    }
+    if (child == 0) _exit(checkLayout(seed));
+
+    int status;
+    if (waitpid(child, &status, 0) < 0) {
+      perror("waitpid");
+      exit(1);
+    }
+    if (! WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      failures++;
+      if (WIFSIGNALED(status)) {
+        fprintf(stderr, "seed %u: killed by signal %d\n", (unsigned)seed, WTERMSIG(status));
+      }
+    }
+  }
+
+  fprintf(stderr, "%u layouts, %u failed\n", (unsigned)layouts, (unsigned)failures);
+  exit(failures == 0 ? 0 : 1);
+}
+
+void loop()
+{
+}
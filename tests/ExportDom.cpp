@@ -0,0 +1,130 @@
+/*
+ * Test of LayoutExport on the layout of examples/dom: every track and
+ * every connection is written once, and the heatmap agrees with the
+ * routes found by pathsTo.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "SwitchMan.h"
+#include "Specifs.h"
+#include "LayoutExport.h"
+#include "Check.h"
+
+/* Text written by a LayoutExport */
+static std::string written(const LayoutExport & inExport, const bool inJson)
+{
+  FILE *file = tmpfile();
+  if (file == NULL) return "";
+  bool ok = inJson ? inExport.writeJson(file) : inExport.writeDot(file);
+  std::string text;
+  rewind(file);
+  for (int c = fgetc(file); c != EOF; c = fgetc(file)) text += (char)c;
+  fclose(file);
+  return ok ? text : "";
+}
+
+static uint32_t occurrences(const std::string & inText, const char *inPattern)
+{
+  uint32_t count = 0;
+  for (size_t at = inText.find(inPattern); at != std::string::npos; at = inText.find(inPattern, at + 1)) {
+    count++;
+  }
+  return count;
+}
+
+static void testLayout()
+{
+  uint32_t connectors = 0;
+  for (uint16_t id = 0; id < Track::count(); id++) {
+    Track & track = Track::trackForId(id);
+    for (uint8_t c = 0; c < CONNECTOR_COUNT; c++) {
+      Track * other = track.connectedTrack((Connector)c);
+      if (other == NULL) continue;
+      connectors++;
+      const int8_t back = other->connectorBack(track, (Connector)c);
+      CHECK(back >= 0);
+      if (back >= 0) CHECK(other->connectedTrack((Connector)back) == &track);
+    }
+  }
+  CHECK(Track::trackForId(voie1_id).kind() == BLOCK_TRACK);
+  CHECK(Track::trackForId(voieGarage10_id).kind() == DEADEND_TRACK);
+  CHECK(Track::trackForId(voieGarage10_id).connectedTrack(INLET) == NULL);
+
+  LayoutExport carte;
+  const std::string dot = written(carte, false);
+  CHECK(occurrences(dot, " [shape=") == Track::count());
+  CHECK(occurrences(dot, " -- ") == connectors / 2);
+  CHECK(occurrences(dot, "\\nv") == 0);
+
+  const std::string json = written(carte, true);
+  CHECK(occurrences(json, "\"kind\"") == Track::count());
+  CHECK(occurrences(json, "\"fromConnector\"") == connectors / 2);
+  CHECK(occurrences(json, "\"query\"") == 0);
+  CHECK(occurrences(json, "{") == occurrences(json, "}"));
+}
+
+static void testHeatmap()
+{
+  PathSet routes;
+  Track::trackForId(voie23_id).pathsTo(voie1_id, FORWARD_DIRECTION, routes);
+
+  LayoutExport carte;
+  CHECK(carte.explore(voie23_id, voie1_id, FORWARD_DIRECTION, 1));
+  CHECK(carte.routeCount() == routes.count());
+  CHECK(carte.visitCount() > 0);
+  CHECK(carte.exploration(voie23_id).visits == 1);
+  CHECK(carte.exploration(voie1_id).visits == routes.count());
+
+  uint32_t visits = 0;
+  for (uint16_t id = 0; id < Track::count(); id++) visits += carte.exploration(id).visits;
+  CHECK(visits == carte.visitCount());
+
+  const std::string dot = written(carte, false);
+  CHECK(occurrences(dot, "\\nv") == Track::count());
+  CHECK(occurrences(dot, "peripheries=2") == 2);
+
+  const std::string json = written(carte, true);
+  CHECK(occurrences(json, "\"visits\"") == Track::count() + 1u);
+  CHECK(occurrences(json, "\"truncated\": true") == (routes.count() > 1 ? 1u : 0u));
+  CHECK(occurrences(json, "[") == occurrences(json, "]"));
+
+  /* A batch query with the index prunes the tracks leading to no target */
+  TrackSet quais;
+  quais.addTrack(voie1_id);
+  quais.addTrack(voie2_id);
+  PathSet versVoie2;
+  Track::trackForId(voie23_id).pathsTo(voie2_id, FORWARD_DIRECTION, versVoie2);
+  ReachabilityIndex::build();
+  CHECK(carte.explore(voie23_id, quais, FORWARD_DIRECTION));
+  CHECK(carte.routeCount() == routes.count() + versVoie2.count());
+  uint32_t pruned = 0;
+  for (uint16_t id = 0; id < Track::count(); id++) pruned += carte.exploration(id).pruned;
+  CHECK(pruned > 0);
+  CHECK(occurrences(written(carte, false), "peripheries=2") == 3);
+  ReachabilityIndex::clear();
+
+  CHECK(! carte.explore(Track::count(), voie1_id, FORWARD_DIRECTION));
+  CHECK(! carte.hasQuery());
+}
+
+void setup()
+{
+  export_setup();
+  Track::finalize();
+  if (! Track::trackNetIsOk()) {
+    fprintf(stderr, "dom: the track net is not ok\n");
+    exit(1);
+  }
+
+  testLayout();
+  testHeatmap();
+
+  fprintf(stderr, "%u checks, %u failures\n", (unsigned)checks, (unsigned)failures);
+  exit(failures == 0 ? 0 : 1);
+}
+
+void loop()
+{
+}
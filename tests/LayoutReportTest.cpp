@@ -0,0 +1,116 @@
+/*
+ * Test of LayoutReport on a small layout made wrong on purpose. Every
+ * kind of issue but the duplicate tracks is there once or more. The
+ * direction conflict of b6 is a reversing joint once finalized.
+ *
+ *   b0 -- t2 -left-- b1 -- d3        b5 -- t8 -left--- b6
+ *          \-right- (free)  ^                \-right- b6 (outlet)
+ *                     b9 ---/ (b1 inlet already used)
+ *
+ * Identifiers 4 and 7 are given to no track.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SwitchMan.h"
+#include "Check.h"
+
+/* Whether the report keeps an issue */
+static bool hasIssue(
+  const LayoutReport & inReport,
+  const uint8_t inKind,
+  const uint16_t inTrack,
+  const uint8_t inConnector,
+  const uint16_t inOther)
+{
+  for (uint16_t i = 0; i < inReport.issueCount(); i++) {
+    const LayoutIssue & issue = inReport.issue(i);
+    if (issue.kind == inKind && issue.track == inTrack &&
+        issue.connector == inConnector && issue.other == inOther) return true;
+  }
+  return false;
+}
+
+static void buildLayout()
+{
+  BlockTrack *b0 = new BlockTrack(NAME_ARG_FIRST("b0") 0);
+  BlockTrack *b1 = new BlockTrack(NAME_ARG_FIRST("b1") 1);
+  TurnoutTrack *t2 = new TurnoutTrack(NAME_ARG_FIRST("t2") 2);
+  DeadendTrack *d3 = new DeadendTrack(NAME_ARG_FIRST("d3") 3);
+  BlockTrack *b5 = new BlockTrack(NAME_ARG_FIRST("b5") 5);
+  BlockTrack *b6 = new BlockTrack(NAME_ARG_FIRST("b6") 6);
+  BlockTrack *b9 = new BlockTrack(NAME_ARG_FIRST("b9") 9);
+  TurnoutTrack *t8 = new TurnoutTrack(NAME_ARG_FIRST("t8") 8);
+
+  b0->connect(OUTLET, *t2, INLET);
+  t2->connect(LEFT_OUTLET, *b1, INLET);
+  b1->connect(OUTLET, *d3, OUTLET);
+  b5->connect(OUTLET, *t8, INLET);
+  t8->connect(LEFT_OUTLET, *b6, INLET);
+  /* b6 goes forward from t8 left, backward from t8 right */
+  t8->connect(RIGHT_OUTLET, *b6, OUTLET);
+  /* The inlet of b1 is used, b1 is not connected back */
+  b9->connect(OUTLET, *b1, INLET);
+}
+
+static void checkReport(const LayoutReport & inReport, const bool inFinalized)
+{
+  CHECK(! inReport.isOk());
+  CHECK(inReport.count(DANGLING_CONNECTOR) == 4);
+  CHECK(hasIssue(inReport, DANGLING_CONNECTOR, 0, INLET, 0));
+  CHECK(hasIssue(inReport, DANGLING_CONNECTOR, 2, RIGHT_OUTLET, 0));
+  CHECK(hasIssue(inReport, DANGLING_CONNECTOR, 5, INLET, 0));
+  CHECK(hasIssue(inReport, DANGLING_CONNECTOR, 9, INLET, 0));
+  CHECK(inReport.count(ONE_WAY_CONNECTION) == 1);
+  CHECK(hasIssue(inReport, ONE_WAY_CONNECTION, 9, OUTLET, 1));
+  const uint8_t conflict = inFinalized ? REVERSING_JOINT : DIRECTION_CONFLICT;
+  CHECK(inReport.count(conflict) == 1);
+  CHECK(hasIssue(inReport, conflict, 6, OUTLET, 8));
+  CHECK(inReport.count(MISSING_TRACK) == 2);
+  CHECK(hasIssue(inReport, MISSING_TRACK, 4, NO_ISSUE_CONNECTOR, 0));
+  CHECK(hasIssue(inReport, MISSING_TRACK, 7, NO_ISSUE_CONNECTOR, 0));
+  CHECK(inReport.count(DUPLICATE_TRACKS) == 0);
+  CHECK(inReport.errorCount() == (inFinalized ? 7 : 8));
+  CHECK(inReport.issueCount() == 9);
+
+  CHECK(inReport.partCount() == 2);
+  CHECK(inReport.largestPart() == 5);
+  CHECK(inReport.warningCount() == (inFinalized ? 2 : 1));
+  CHECK(hasIssue(inReport, SEPARATE_PART, 5, NO_ISSUE_CONNECTOR, 3));
+  CHECK(inReport.recordedErrors() > 0);
+}
+
+void setup()
+{
+  buildLayout();
+
+  LayoutReport before;
+  before.build();
+  checkReport(before, false);
+
+  Track::finalize();
+  CHECK(! Track::trackNetIsOk());
+  CHECK(Track::tableSize() == 10);
+  CHECK(Track::findTrack(4) == NULL);
+  CHECK(Track::findTrack(10) == NULL);
+  CHECK(Track::findTrack(9) == &Track::trackForId(9));
+#ifdef SWITCHMAN_TRACK_NAMES
+  CHECK(TrackNames::idForName("b9") == 9);
+  CHECK(TrackNames::idForName("b4") == Track::count());
+#endif
+
+  LayoutReport after;
+  after.build();
+  checkReport(after, true);
+  CHECK(DirectionSolver::jointCount() == 1);
+  CHECK(DirectionSolver::changedCount() == 0);
+  CHECK(after.recordedErrors() == Track::errorCount());
+  after.print();
+
+  fprintf(stderr, "%u checks, %u failed\n", (unsigned)checks, (unsigned)failures);
+  exit(failures == 0 ? 0 : 1);
+}
+
+void loop()
+{
+}
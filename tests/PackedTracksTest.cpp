@@ -0,0 +1,58 @@
+/*
+ * Test of the tracks linked by identifier (SWITCHMAN_PACKED_TRACKS) on a
+ * loop of 300 blocks made at run time. On 1 byte, the identifiers from
+ * 255 do not fit in the links: the net is not ok and nothing crashes.
+ * With SWITCHMAN_WIDE_TRACK_IDS, the routes go around the loop.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SwitchMan.h"
+#include "Check.h"
+
+#define BLOCK_COUNT 300
+
+static void buildLayout()
+{
+  BlockTrack *first = new BlockTrack(NAME_ARG_FIRST("b") 0);
+  BlockTrack *previous = first;
+  for (uint16_t id = 1; id < BLOCK_COUNT; id++) {
+    BlockTrack *block = new BlockTrack(NAME_ARG_FIRST("b") id);
+    previous->connect(OUTLET, *block, INLET);
+    previous = block;
+  }
+  previous->connect(OUTLET, *first, INLET);
+}
+
+void setup()
+{
+  buildLayout();
+  Track::finalize();
+  CHECK(Track::count() == BLOCK_COUNT);
+
+#ifdef SWITCHMAN_WIDE_TRACK_IDS
+  CHECK(sizeof(TrackIndex) == 2);
+  CHECK(Track::trackNetIsOk());
+  PathSet paths;
+  CHECK(Track::trackForId(10).pathsTo(BLOCK_COUNT - 10, FORWARD_DIRECTION, paths));
+  CHECK(paths.count() == 1);
+  CHECK(ReachabilityIndex::build());
+  CHECK(ReachabilityIndex::reaches(BLOCK_COUNT - 1, 0, FORWARD_DIRECTION));
+#else
+  CHECK(sizeof(TrackIndex) == 1);
+  /* 45 blocks do not fit, some connections too */
+  CHECK(! Track::trackNetIsOk());
+  CHECK(Track::errorCount() >= BLOCK_COUNT - NO_TRACK_INDEX);
+  PathSet paths;
+  CHECK(! Track::trackForId(10).pathsTo(BLOCK_COUNT - 10, FORWARD_DIRECTION, paths));
+  CHECK(paths.count() == 0);
+  CHECK(! ReachabilityIndex::build());
+#endif
+
+  fprintf(stderr, "%u checks, %u failed\n", (unsigned)checks, (unsigned)failures);
+  exit(failures == 0 ? 0 : 1);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,157 @@
+/*
+ * Test of ReversingSearch on a siding and on a run-around loop, made at
+ * run time. A train reversing on a track leaves it the way it came in.
+ *
+ *   d0 -- a1 -- t2 -left-- b3 -- d4        siding b3, s5 with headshunt a1
+ *                 \-right- s5 -- d6
+ *
+ *   d7 -- a8 -- t9 -left-- m10 --+- t11 -- c13 -- d14   run-around loop
+ *                 \-right- l12 --+         by l12, headshunt c13
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SwitchMan.h"
+#include "Check.h"
+
+static void buildLayout()
+{
+  DeadendTrack *d0 = new DeadendTrack(NAME_ARG_FIRST("d0") 0);
+  BlockTrack *a1 = new BlockTrack(NAME_ARG_FIRST("a1") 1);
+  TurnoutTrack *t2 = new TurnoutTrack(NAME_ARG_FIRST("t2") 2);
+  BlockTrack *b3 = new BlockTrack(NAME_ARG_FIRST("b3") 3);
+  DeadendTrack *d4 = new DeadendTrack(NAME_ARG_FIRST("d4") 4);
+  BlockTrack *s5 = new BlockTrack(NAME_ARG_FIRST("s5") 5);
+  DeadendTrack *d6 = new DeadendTrack(NAME_ARG_FIRST("d6") 6);
+  d0->connect(OUTLET, *a1, INLET);
+  a1->connect(OUTLET, *t2, INLET);
+  t2->connect(LEFT_OUTLET, *b3, INLET);
+  b3->connect(OUTLET, *d4, OUTLET);
+  t2->connect(RIGHT_OUTLET, *s5, INLET);
+  s5->connect(OUTLET, *d6, OUTLET);
+
+  DeadendTrack *d7 = new DeadendTrack(NAME_ARG_FIRST("d7") 7);
+  BlockTrack *a8 = new BlockTrack(NAME_ARG_FIRST("a8") 8);
+  TurnoutTrack *t9 = new TurnoutTrack(NAME_ARG_FIRST("t9") 9);
+  BlockTrack *m10 = new BlockTrack(NAME_ARG_FIRST("m10") 10);
+  TurnoutTrack *t11 = new TurnoutTrack(NAME_ARG_FIRST("t11") 11);
+  BlockTrack *l12 = new BlockTrack(NAME_ARG_FIRST("l12") 12);
+  BlockTrack *c13 = new BlockTrack(NAME_ARG_FIRST("c13") 13);
+  DeadendTrack *d14 = new DeadendTrack(NAME_ARG_FIRST("d14") 14);
+  d7->connect(OUTLET, *a8, INLET);
+  a8->connect(OUTLET, *t9, INLET);
+  t9->connect(LEFT_OUTLET, *m10, INLET);
+  m10->connect(OUTLET, *t11, LEFT_OUTLET);
+  t9->connect(RIGHT_OUTLET, *l12, INLET);
+  l12->connect(OUTLET, *t11, RIGHT_OUTLET);
+  t11->connect(INLET, *c13, INLET);
+  c13->connect(OUTLET, *d14, OUTLET);
+}
+
+/* Whether a leg of inRoute goes through track inId */
+static bool usesTrack(const LegRoute & inRoute, const uint16_t inId)
+{
+  for (Leg * leg = inRoute.firstLeg(); leg != NULL; leg = leg->next()) {
+    if (leg->containsTrack(inId)) return true;
+  }
+  return false;
+}
+
+static void testSiding()
+{
+  Track & b3 = Track::trackForId(3);
+
+  /* Reversing on the turnout does not lead to the other branch */
+  ReversingSearch onTurnout(1);
+  onTurnout.allowReversalAt(2);
+  LegRouteSet none;
+  CHECK(! onTurnout.routesTo(b3, 5, BACKWARD_DIRECTION, none));
+  CHECK(none.count() == 0);
+
+  /* Out of b3 to the headshunt a1 and into s5 */
+  ReversingSearch onHeadshunt(1);
+  onHeadshunt.allowReversalAt(1);
+  LegRouteSet routes;
+  CHECK(onHeadshunt.routesTo(b3, 5, BACKWARD_DIRECTION, routes));
+  CHECK(routes.count() == 1);
+  if (routes.count() == 1) {
+    LegRoute & route = *routes.firstRoute();
+    CHECK(route.legCount() == 2);
+    Leg & out = *route.firstLeg();
+    CHECK(out.direction() == BACKWARD_DIRECTION);
+    CHECK(out.containsTrack(3) && out.containsTrack(2) && out.containsTrack(1));
+    CHECK(! out.containsTrack(5));
+    Leg & in = *out.next();
+    CHECK(in.direction() == FORWARD_DIRECTION);
+    CHECK(in.containsTrack(1) && in.containsTrack(2) && in.containsTrack(5));
+    CHECK(! in.containsTrack(3));
+  }
+
+  /* Without reversal, there is no route */
+  onHeadshunt.setMaxReversals(0);
+  LegRouteSet direct;
+  CHECK(! onHeadshunt.routesTo(b3, 5, BACKWARD_DIRECTION, direct));
+}
+
+static void testRunAround()
+{
+  Track & m10 = Track::trackForId(10);
+
+  /* To the headshunt c13 and back to a8 by either side of the loop */
+  ReversingSearch runAround(1);
+  runAround.allowReversalAt(13);
+  LegRouteSet routes;
+  CHECK(runAround.routesTo(m10, 8, FORWARD_DIRECTION, routes));
+  CHECK(routes.count() == 2);
+  uint8_t byLoop = 0;
+  for (LegRoute * r = routes.firstRoute(); r != NULL; r = routes.nextRoute(r)) {
+    CHECK(r->legCount() == 2);
+    Leg & out = *r->firstLeg();
+    CHECK(out.direction() == FORWARD_DIRECTION);
+    CHECK(out.containsTrack(10) && out.containsTrack(11) && out.containsTrack(13));
+    Leg & back = *out.next();
+    CHECK(back.direction() == BACKWARD_DIRECTION);
+    CHECK(back.containsTrack(13) && back.containsTrack(9) && back.containsTrack(8));
+    if (back.containsTrack(12)) byLoop++;
+  }
+  CHECK(byLoop == 1);
+
+  /* Reversing on t11 backs out on m10, not into the loop */
+  ReversingSearch onTurnout(1);
+  onTurnout.allowReversalAt(11);
+  LegRouteSet back;
+  CHECK(onTurnout.routesTo(m10, 8, FORWARD_DIRECTION, back));
+  CHECK(back.count() == 1);
+  if (back.count() == 1) {
+    CHECK(back.firstRoute()->legCount() == 2);
+    CHECK(! usesTrack(*back.firstRoute(), 12));
+  }
+
+  /* A second reversal on c13 is not allowed on the way back */
+  ReversingSearch twice(2);
+  twice.allowReversalAt(13);
+  LegRouteSet more;
+  CHECK(twice.routesTo(m10, 8, FORWARD_DIRECTION, more));
+  CHECK(more.count() == 2);
+}
+
+void setup()
+{
+  buildLayout();
+  Track::finalize();
+  if (! Track::trackNetIsOk()) {
+    fprintf(stderr, "reversing: the track net is not ok\n");
+    exit(1);
+  }
+  CHECK(DirectionSolver::jointCount() == 0);
+
+  testSiding();
+  testRunAround();
+
+  fprintf(stderr, "%u checks, %u failed\n", (unsigned)checks, (unsigned)failures);
+  exit(failures == 0 ? 0 : 1);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,153 @@
+/*
+ * Test of RouteImage on a layout made at run time: the image holds the
+ * routes of pathsTo, each one once, and the tracks as they were linked
+ * and oriented by finalize. Around the balloon one way or the other
+ * goes through the same tracks, the search finds that route twice.
+ *
+ *   d0 -- b1 -- t2 -left-- b3 --+        balloon, back to t2 right
+ *                 \-right- b4 --+        by the outlet of b4
+ *
+ *   d5 -- b6 -- x7 left -- b8 -- d9      crossing x7
+ *   d10 -- b11 -- x7 right -- b12 -- d13
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "SwitchMan.h"
+#include "RouteImage.h"
+#include "Check.h"
+
+static void buildLayout()
+{
+  DeadendTrack *d0 = new DeadendTrack(NAME_ARG_FIRST("d0") 0);
+  BlockTrack *b1 = new BlockTrack(NAME_ARG_FIRST("b1") 1);
+  TurnoutTrack *t2 = new TurnoutTrack(NAME_ARG_FIRST("t2") 2);
+  BlockTrack *b3 = new BlockTrack(NAME_ARG_FIRST("b3") 3);
+  BlockTrack *b4 = new BlockTrack(NAME_ARG_FIRST("b4") 4);
+  d0->connect(OUTLET, *b1, INLET);
+  b1->connect(OUTLET, *t2, INLET);
+  t2->connect(LEFT_OUTLET, *b3, INLET);
+  b3->connect(OUTLET, *b4, INLET);
+  b4->connect(OUTLET, *t2, RIGHT_OUTLET);
+
+  DeadendTrack *d5 = new DeadendTrack(NAME_ARG_FIRST("d5") 5);
+  BlockTrack *b6 = new BlockTrack(NAME_ARG_FIRST("b6") 6);
+  CrossingTrack *x7 = new CrossingTrack(NAME_ARG_FIRST("x7") 7);
+  BlockTrack *b8 = new BlockTrack(NAME_ARG_FIRST("b8") 8);
+  DeadendTrack *d9 = new DeadendTrack(NAME_ARG_FIRST("d9") 9);
+  DeadendTrack *d10 = new DeadendTrack(NAME_ARG_FIRST("d10") 10);
+  BlockTrack *b11 = new BlockTrack(NAME_ARG_FIRST("b11") 11);
+  BlockTrack *b12 = new BlockTrack(NAME_ARG_FIRST("b12") 12);
+  DeadendTrack *d13 = new DeadendTrack(NAME_ARG_FIRST("d13") 13);
+  d5->connect(OUTLET, *b6, INLET);
+  b6->connect(OUTLET, *x7, LEFT_INLET);
+  x7->connect(LEFT_OUTLET, *b8, INLET);
+  b8->connect(OUTLET, *d9, OUTLET);
+  d10->connect(OUTLET, *b11, INLET);
+  b11->connect(OUTLET, *x7, RIGHT_INLET);
+  x7->connect(RIGHT_OUTLET, *b12, INLET);
+  b12->connect(OUTLET, *d13, OUTLET);
+}
+
+/* Routes found by the search, duplicates included */
+class RouteCounter : public RouteVisitor
+{
+  public:
+    uint16_t mCount;
+    RouteCounter() : mCount(0) {}
+    virtual bool visitRoute(const TrackSet &) { mCount++; return true; }
+};
+
+/* Whether a route of the image is in inPaths */
+static bool isIn(const uint8_t *inRoute, PathSet & inPaths)
+{
+  for (Path *path = inPaths.firstPath(); path != NULL; path = path->next()) {
+    uint8_t i = 0;
+    while (i < Track::sizeForSet() && path->byteAt(i) == inRoute[i]) i++;
+    if (i == Track::sizeForSet()) return true;
+  }
+  return false;
+}
+
+static void testRoutes(const RouteImage & inImage)
+{
+  const uint8_t size = inImage.routeSize();
+  for (uint8_t dir = FORWARD_DIRECTION; dir <= BACKWARD_DIRECTION; dir++) {
+    for (uint16_t from = 0; from < Track::count(); from++) {
+      for (uint16_t to = 0; to < Track::count(); to++) {
+        PathSet paths;
+        Track::trackForId(from).pathsTo(to, (Direction)dir, paths);
+        const uint32_t count = inImage.routeCount(from, to, (Direction)dir);
+        CHECK(count == paths.count());
+        for (uint32_t r = 0; r < count; r++) {
+          const uint8_t *route = inImage.route(from, to, (Direction)dir, r);
+          CHECK(isIn(route, paths));
+          for (uint32_t other = 0; other < r; other++) {
+            CHECK(memcmp(route, inImage.route(from, to, (Direction)dir, other), size) != 0);
+          }
+        }
+      }
+    }
+  }
+}
+
+static void testTracks(const RouteImage & inImage)
+{
+  for (uint16_t id = 0; id < Track::count(); id++) {
+    Track & track = Track::trackForId(id);
+    CHECK(inImage.isBlock(id) == track.isBlock());
+    CHECK(inImage.kind(id) == track.kind());
+    CHECK(inImage.direction(id) == track.direction());
+    for (uint8_t c = 0; c < CONNECTOR_COUNT; c++) {
+      Track *connected = track.connectedTrack((Connector)c);
+      const uint16_t expected = (connected == NULL) ? inImage.trackCount() : connected->identifier();
+      CHECK(inImage.connectedTrack(id, (Connector)c) == expected);
+    }
+  }
+  CHECK(inImage.direction(Track::count()) == NO_DIRECTION);
+  CHECK(inImage.connectedTrack(Track::count(), INLET) == inImage.trackCount());
+}
+
+void setup()
+{
+  buildLayout();
+  Track::finalize();
+  if (! Track::trackNetIsOk()) {
+    fprintf(stderr, "image: the track net is not ok\n");
+    exit(1);
+  }
+
+  std::vector<uint8_t> memory;
+  CHECK(RouteImage::build(memory));
+  RouteImage image;
+  CHECK(image.attach(memory.data(), memory.size()));
+  CHECK(image.trackCount() == Track::count());
+  CHECK(image.routeSize() == Track::sizeForSet());
+
+  /* Around the balloon and back to the dead end */
+  const Direction toLoop = Track::trackForId(1).direction();
+  RouteCounter found;
+  PathSearch search;
+  search.visit(Track::trackForId(1), 0, toLoop, found);
+  CHECK(found.mCount == 2);
+  CHECK(image.routeCount(1, 0, toLoop) == 1);
+
+  testRoutes(image);
+  testTracks(image);
+
+  /* The pairs the index rejects are not searched, the image is the same */
+  CHECK(ReachabilityIndex::isBuilt());
+  ReachabilityIndex::clear();
+  std::vector<uint8_t> searched;
+  CHECK(RouteImage::build(searched));
+  CHECK(searched == memory);
+
+  fprintf(stderr, "%u checks, %u failed\n", (unsigned)checks, (unsigned)failures);
+  exit(failures == 0 ? 0 : 1);
+}
+
+void loop()
+{
+}
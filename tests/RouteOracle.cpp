@@ -0,0 +1,241 @@
+/*
+ * RouteOracle : reference enumeration of the routes for the tests.
+ */
+#include "RouteOracle.h"
+
+/*---------------------------------------------------------------------------*/
+RouteOracle::RouteOracle() :
+  mRoutes(NULL),
+  mTarget(0)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+bool RouteOracle::onPath(Track *inTrack, const uint8_t inWay, const Direction inDir) const
+{
+  for (size_t i = 0; i < mPath.size(); i++) {
+    if (mPath[i] == inTrack && mWays[i] == inWay && mDirs[i] == inDir) return true;
+  }
+  return false;
+}
+
+/*
+ * Direction of travel on a track entered from inFrom: the one of the
+ * track when entered by an inlet, the other one by an outlet. The first
+ * connector to inFrom is taken.
+ */
+static Direction entryDirection(Track *inTrack, const Track *inFrom)
+{
+  for (uint8_t c = 0; c < CONNECTOR_COUNT; c++) {
+    if (inTrack->connectedTrack((Connector)c) != inFrom) continue;
+    const bool inlet = (c == INLET || c == LEFT_INLET || c == RIGHT_INLET);
+    if (inlet) return inTrack->direction();
+    return (inTrack->direction() == FORWARD_DIRECTION) ? BACKWARD_DIRECTION : FORWARD_DIRECTION;
+  }
+  return inTrack->direction();
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteOracle::walk(Track *inTrack, const Track *inFrom, const Direction inDir)
+{
+  const uint8_t way = inTrack->entryOf(inFrom);
+  if (onPath(inTrack, way, inDir)) return;
+  mPath.push_back(inTrack);
+  mWays.push_back(way);
+  mDirs.push_back(inDir);
+  if (inTrack->identifier() == mTarget) {
+    TrackSet route;
+    for (size_t i = 0; i < mPath.size(); i++) route.addTrack(mPath[i]);
+    mRoutes->insert(normalize(route));
+  }
+  else {
+    Track *next[MAX_NEXT_TRACKS];
+    const uint8_t count = inTrack->nextTracks(inDir, inFrom, next);
+    for (uint8_t i = 0; i < count; i++) {
+      walk(next[i], inTrack, entryDirection(next[i], inTrack));
+    }
+  }
+  mPath.pop_back();
+  mWays.pop_back();
+  mDirs.pop_back();
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteOracle::routes(
+  const uint16_t inFrom,
+  const uint16_t inTo,
+  const Direction inDir,
+  OracleRouteList & outRoutes)
+{
+  outRoutes.clear();
+  mRoutes = &outRoutes;
+  mTarget = inTo;
+  walk(&Track::trackForId(inFrom), NULL, inDir);
+}
+
+/*---------------------------------------------------------------------------*/
+OracleRoute RouteOracle::normalize(const TrackSet & inRoute)
+{
+  OracleRoute route(Track::sizeForSet());
+  for (uint8_t i = 0; i < Track::sizeForSet(); i++) route[i] = inRoute.byteAt(i);
+  return route;
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteOracle::normalize(PathSet & inPaths, OracleRouteList & outRoutes)
+{
+  outRoutes.clear();
+  for (Path *path = inPaths.firstPath(); path != NULL; path = path->next()) {
+    if (! path->isEmpty()) outRoutes.insert(normalize(*path));
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+void RouteOracle::print(FILE *inFile, const OracleRoute & inRoute)
+{
+  fprintf(inFile, "{");
+  const char *separator = "";
+  for (size_t i = 0; i < inRoute.size(); i++) {
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      if (inRoute[i] & (1 << bit)) {
+        fprintf(inFile, "%s%u", separator, (unsigned)((i << 3) + bit));
+        separator = " ";
+      }
+    }
+  }
+  fprintf(inFile, "}");
+}
+
+/*
+ * Routes given one by one by Track::visitPathsTo
+ */
+class RouteCollector : public RouteVisitor
+{
+  public:
+    OracleRouteList mRoutes;
+    virtual bool visitRoute(const TrackSet & inRoute)
+    {
+      mRoutes.insert(RouteOracle::normalize(inRoute));
+      return true;
+    }
+};
+
+/*
+ * Count a difference and report it while under the limit
+ */
+static uint32_t differences;
+
+static const char *directionName(const Direction inDir)
+{
+  return inDir == FORWARD_DIRECTION ? "forward" : "backward";
+}
+
+static void compare(
+  const char *inTag,
+  const uint16_t inReportLimit,
+  const char *inEngine,
+  const uint16_t inFrom,
+  const uint16_t inTo,
+  const Direction inDir,
+  const OracleRouteList & inExpected,
+  const OracleRouteList & inFound)
+{
+  if (inExpected == inFound) return;
+  if (differences++ >= inReportLimit) return;
+  fprintf(stderr, "%s: %s from %u to %u %s: %u routes instead of %u\n",
+          inTag, inEngine, inFrom, inTo,
+          directionName(inDir),
+          (unsigned)inFound.size(), (unsigned)inExpected.size());
+  OracleRouteList::const_iterator it;
+  for (it = inExpected.begin(); it != inExpected.end(); ++it) {
+    if (inFound.count(*it) == 0) {
+      fprintf(stderr, "  missing ");
+      RouteOracle::print(stderr, *it);
+      fprintf(stderr, "\n");
+    }
+  }
+  for (it = inFound.begin(); it != inFound.end(); ++it) {
+    if (inExpected.count(*it) == 0) {
+      fprintf(stderr, "  extra   ");
+      RouteOracle::print(stderr, *it);
+      fprintf(stderr, "\n");
+    }
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+uint32_t RouteOracle::checkAllPairs(const char *inTag, const uint16_t inReportLimit)
+{
+  differences = 0;
+  const uint16_t count = Track::count();
+  TrackSet all;
+  for (uint16_t id = 0; id < count; id++) all.addTrack(id);
+
+  RouteOracle oracle;
+  /* expected[from * count + to] */
+  std::vector<OracleRouteList> expected(count * count);
+
+  for (uint8_t d = FORWARD_DIRECTION; d <= BACKWARD_DIRECTION; d++) {
+    const Direction dir = (Direction)d;
+    for (uint16_t from = 0; from < count; from++) {
+      for (uint16_t to = 0; to < count; to++) {
+        oracle.routes(from, to, dir, expected[from * count + to]);
+      }
+    }
+
+    for (uint16_t from = 0; from < count; from++) {
+      Track & fromTrack = Track::trackForId(from);
+      for (uint16_t to = 0; to < count; to++) {
+        const OracleRouteList & routes = expected[from * count + to];
+        OracleRouteList found;
+
+        PathSet paths;
+        fromTrack.pathsTo(to, dir, paths);
+        normalize(paths, found);
+        compare(inTag, inReportLimit, "pathsTo", from, to, dir, routes, found);
+
+        PathSet searched;
+        PathSearch search;
+        search.start(fromTrack, to, dir, searched);
+        while (! search.step(100));
+        normalize(searched, found);
+        compare(inTag, inReportLimit, "PathSearch", from, to, dir, routes, found);
+
+        RouteCollector collector;
+        fromTrack.visitPathsTo(to, dir, collector);
+        compare(inTag, inReportLimit, "visitPathsTo", from, to, dir, routes, collector.mRoutes);
+
+        if (ReachabilityIndex::isBuilt() &&
+            ReachabilityIndex::reaches(from, to, dir) == routes.empty() &&
+            differences++ < inReportLimit) {
+          fprintf(stderr, "%s: reaches from %u to %u %s: %s instead of %s\n",
+                  inTag, from, to, directionName(dir),
+                  routes.empty() ? "true" : "false", routes.empty() ? "false" : "true");
+        }
+      }
+
+      PathSetMap map;
+      BatchSearch batch;
+      batch.pathsToAll(fromTrack, all, dir, map);
+      for (uint16_t to = 0; to < count; to++) {
+        OracleRouteList found;
+        normalize(*map.pathsFor(to), found);
+        compare(inTag, inReportLimit, "pathsToAll", from, to, dir,
+                expected[from * count + to], found);
+      }
+    }
+
+    for (uint16_t to = 0; to < count; to++) {
+      PathSetMap map;
+      BatchSearch batch;
+      batch.pathsFromAll(all, to, dir, map);
+      for (uint16_t from = 0; from < count; from++) {
+        OracleRouteList found;
+        normalize(*map.pathsFor(from), found);
+        compare(inTag, inReportLimit, "pathsFromAll", from, to, dir,
+                expected[from * count + to], found);
+      }
+    }
+  }
+  return differences;
+}
@@ -0,0 +1,58 @@
+/*
+ * RouteOracle : reference enumeration of the routes for the tests.
+ *
+ * The oracle follows every walk from the departure track with
+ * Track::nextTracks, a track (a way of a crossing) appearing at most
+ * once per direction on a walk, and keeps the walks ending at the
+ * target. The direction on a track is found from the connector it is
+ * entered by, so the reversing joints need no DirectionSolver. It is
+ * slow and shares nothing with the search engines but nextTracks, so
+ * the routes of the engines are checked against it.
+ */
+#ifndef __ROUTEORACLE_H__
+#define __ROUTEORACLE_H__
+
+#include <stdio.h>
+#include <set>
+#include <vector>
+
+#include "SwitchMan.h"
+
+/* A route is the bit vector of its tracks, a route list is sorted */
+typedef std::vector<uint8_t> OracleRoute;
+typedef std::set<OracleRoute> OracleRouteList;
+
+class RouteOracle
+{
+  private:
+    std::vector<Track *> mPath;
+    std::vector<uint8_t> mWays;
+    std::vector<uint8_t> mDirs;
+    OracleRouteList *mRoutes;
+    uint16_t mTarget;
+
+    bool onPath(Track *inTrack, const uint8_t inWay, const Direction inDir) const;
+    void walk(Track *inTrack, const Track *inFrom, const Direction inDir);
+
+  public:
+    RouteOracle();
+    /* Routes from inFrom to inTo travelling in inDir */
+    void routes(const uint16_t inFrom, const uint16_t inTo, const Direction inDir, OracleRouteList & outRoutes);
+
+    static OracleRoute normalize(const TrackSet & inRoute);
+    /* Routes of a PathSet, its empty initial path apart */
+    static void normalize(PathSet & inPaths, OracleRouteList & outRoutes);
+    static void print(FILE *inFile, const OracleRoute & inRoute);
+
+    /*
+     * Compare the routes of every engine with the ones of the oracle for
+     * every pair of tracks and both directions: Track::pathsTo,
+     * Track::visitPathsTo, PathSearch, BatchSearch in both ways and
+     * ReachabilityIndex::reaches when the index is built. The first
+     * inReportLimit differences are written on stderr, prefixed by inTag.
+     * Return the number of differences.
+     */
+    static uint32_t checkAllPairs(const char *inTag, const uint16_t inReportLimit);
+};
+
+#endif /* __ROUTEORACLE_H__ */
@@ -0,0 +1,194 @@
+/*
+ * Test of the route protocol on the layout of examples/dom: query frames
+ * are fed to RouteProtocol::receive() and the answers written on Serial,
+ * std::cout on unix, are checked with their length and crc.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+#include <string>
+
+#include "SwitchMan.h"
+#include "Specifs.h"
+#include "Check.h"
+
+/* Number of routes of a PathSet, its empty initial path apart */
+static uint16_t routeCount(PathSet & inPaths)
+{
+  uint16_t count = 0;
+  for (Path *path = inPaths.firstPath(); path != NULL; path = path->next()) {
+    if (! path->isEmpty()) count++;
+  }
+  return count;
+}
+
+static void testCrc()
+{
+  const char *text = "123456789";
+  uint16_t crc = 0xFFFF;
+  while (*text != '\0') crc = RouteProtocol::crc(crc, *text++);
+  CHECK(crc == 0x29B1);
+}
+
+/* Query frame of 12 bytes */
+static void queryFrame(
+  uint8_t *outFrame,
+  const uint8_t inSeq,
+  const uint16_t inOrigin,
+  const uint16_t inTarget,
+  const uint8_t inDir)
+{
+  outFrame[0] = ROUTE_PROTOCOL_SYNC;
+  outFrame[1] = ROUTE_QUERY_FRAME;
+  outFrame[2] = inSeq;
+  outFrame[3] = 5;
+  outFrame[4] = 0;
+  outFrame[5] = inOrigin & 0xFF;
+  outFrame[6] = inOrigin >> 8;
+  outFrame[7] = inTarget & 0xFF;
+  outFrame[8] = inTarget >> 8;
+  outFrame[9] = inDir;
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 1; i < 10; i++) crc = RouteProtocol::crc(crc, outFrame[i]);
+  outFrame[10] = crc & 0xFF;
+  outFrame[11] = crc >> 8;
+}
+
+/* What the protocol writes on Serial, std::cout on unix, while it lives */
+class SerialCapture
+{
+  private:
+    std::ostringstream mOut;
+    std::streambuf *mSaved;
+
+  public:
+    SerialCapture() : mSaved(std::cout.rdbuf(mOut.rdbuf())) {}
+    ~SerialCapture() { std::cout.rdbuf(mSaved); }
+    std::string bytes() const { return mOut.str(); }
+};
+
+/*
+ * Whether inBytes, from ioNext, is an answer to inSeq with inStatus and
+ * inCount routes, with a good length and crc. Return the byte after it
+ * in ioNext.
+ */
+static bool isAnswer(
+  const std::string & inBytes,
+  size_t & ioNext,
+  const uint8_t inSeq,
+  const RouteStatus inStatus,
+  const uint16_t inCount)
+{
+  const uint8_t *b = (const uint8_t *)inBytes.data() + ioNext;
+  if (inBytes.size() < ioNext + 11) return false;
+  const uint16_t length = b[3] | (b[4] << 8);
+  if (inBytes.size() < ioNext + 7 + length) return false;
+  uint16_t crc = 0xFFFF;
+  for (uint16_t i = 1; i < 5 + length; i++) crc = RouteProtocol::crc(crc, b[i]);
+  ioNext += 7 + length;
+  return b[0] == ROUTE_PROTOCOL_SYNC && b[1] == ROUTE_ANSWER_FRAME && b[2] == inSeq &&
+         b[5] == inStatus && (b[6] | (b[7] << 8)) == inCount &&
+         b[8] == Track::sizeForSet() &&
+         length == 4 + (uint32_t)inCount * Track::sizeForSet() &&
+         (b[5 + length] | (b[6 + length] << 8)) == crc;
+}
+
+static void testProtocol()
+{
+  PathSet paths;
+  Track::trackForId(voie1_id).pathsTo(voie2_id, FORWARD_DIRECTION, paths);
+  const uint16_t count = routeCount(paths);
+  CHECK(count > 0);
+  uint8_t frame[12];
+  size_t next = 0;
+
+  /* A valid query */
+  {
+    SerialCapture serial;
+    RouteProtocol protocol(Serial);
+    queryFrame(frame, 3, voie1_id, voie2_id, FORWARD_DIRECTION);
+    CHECK(protocol.receive(frame, sizeof(frame)) == 1);
+    CHECK(protocol.pendingCount() == 1);
+    CHECK(serial.bytes().empty());
+    CHECK(protocol.answerNext());
+    CHECK(! protocol.answerNext());
+    next = 0;
+    CHECK(isAnswer(serial.bytes(), next, 3, ROUTE_OK, count));
+    CHECK(next == serial.bytes().size());
+  }
+
+  /* A bad crc, the query is dropped without an answer */
+  {
+    SerialCapture serial;
+    RouteProtocol protocol(Serial);
+    queryFrame(frame, 4, voie1_id, voie2_id, FORWARD_DIRECTION);
+    frame[10] ^= 0x01;
+    CHECK(protocol.receive(frame, sizeof(frame)) == 0);
+    CHECK(protocol.pendingCount() == 0);
+    CHECK(! protocol.answerNext());
+    CHECK(serial.bytes().empty());
+  }
+
+  /* A sync byte where a type or a length is expected starts a frame */
+  {
+    SerialCapture serial;
+    RouteProtocol protocol(Serial);
+    const uint8_t noise[] = { 0x55, ROUTE_PROTOCOL_SYNC, ROUTE_PROTOCOL_SYNC, ROUTE_QUERY_FRAME, 9 };
+    CHECK(protocol.receive(noise, sizeof(noise)) == 0);
+    queryFrame(frame, 5, voie1_id, voie2_id, FORWARD_DIRECTION);
+    CHECK(protocol.receive(frame, sizeof(frame)) == 1);
+    CHECK(protocol.answerNext());
+    next = 0;
+    CHECK(isAnswer(serial.bytes(), next, 5, ROUTE_OK, count));
+  }
+
+  /* The queries beyond the queue are answered busy at once */
+  {
+    SerialCapture serial;
+    RouteProtocol protocol(Serial);
+    for (uint8_t q = 0; q <= ROUTE_PROTOCOL_QUEUE_SIZE; q++) {
+      queryFrame(frame, 10 + q, voie1_id, voie2_id, FORWARD_DIRECTION);
+      protocol.receive(frame, sizeof(frame));
+    }
+    CHECK(protocol.pendingCount() == ROUTE_PROTOCOL_QUEUE_SIZE);
+    next = 0;
+    CHECK(isAnswer(serial.bytes(), next, 10 + ROUTE_PROTOCOL_QUEUE_SIZE, ROUTE_BUSY, 0));
+    CHECK(next == serial.bytes().size());
+    for (uint8_t q = 0; q < ROUTE_PROTOCOL_QUEUE_SIZE; q++) {
+      CHECK(protocol.answerNext());
+      CHECK(isAnswer(serial.bytes(), next, 10 + q, ROUTE_OK, count));
+    }
+    CHECK(protocol.pendingCount() == 0);
+  }
+
+  /* An unknown track */
+  {
+    SerialCapture serial;
+    RouteProtocol protocol(Serial);
+    queryFrame(frame, 6, Track::count(), voie2_id, FORWARD_DIRECTION);
+    CHECK(protocol.receive(frame, sizeof(frame)) == 1);
+    CHECK(protocol.answerNext());
+    next = 0;
+    CHECK(isAnswer(serial.bytes(), next, 6, ROUTE_BAD_TRACK, 0));
+  }
+}
+
+void setup()
+{
+  export_setup();
+  Track::finalize();
+  if (! Track::trackNetIsOk()) {
+    fprintf(stderr, "protocol: the track net is not ok\n");
+    exit(1);
+  }
+
+  testCrc();
+  testProtocol();
+
+  fprintf(stderr, "%u checks, %u failed\n", (unsigned)checks, (unsigned)failures);
+  exit(failures == 0 ? 0 : 1);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,333 @@
+/*
+ * Test of RouteServer through its socket and its ring, on a layout made
+ * at run time: six passing loops in a row give 64 routes from b1 to b26.
+ *
+ *   d0 -- b1 -- t2 -left-- p3 --+- t5 -- ... -- t25 -- b26 -- d27
+ *                 \-right- p4 --+
+ *
+ * A batch of 255 queries of these routes is larger than a frame when
+ * every answer is inline, the last ones have to go in the ring.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+#include "SwitchMan.h"
+#include "RouteServer.h"
+#include "Check.h"
+
+#define STAGE_COUNT 6
+#define FIRST_BLOCK 1
+#define LAST_BLOCK  (2 + STAGE_COUNT * 4)
+#define ROUTE_COUNT (1 << STAGE_COUNT)
+
+static EventLoop eventLoop;
+static char socketPath[64];
+static char ringName[64];
+
+static void buildLayout()
+{
+  DeadendTrack *start = new DeadendTrack(NAME_ARG_FIRST("d0") 0);
+  BlockTrack *previous = new BlockTrack(NAME_ARG_FIRST("b1") FIRST_BLOCK);
+  start->connect(OUTLET, *previous, INLET);
+  Track *end = previous;
+  Connector endConnector = OUTLET;
+  uint16_t id = 2;
+  for (uint8_t s = 0; s < STAGE_COUNT; s++) {
+    TurnoutTrack *split = new TurnoutTrack(NAME_ARG_FIRST("split") id);
+    BlockTrack *left = new BlockTrack(NAME_ARG_FIRST("left") id + 1);
+    BlockTrack *right = new BlockTrack(NAME_ARG_FIRST("right") id + 2);
+    TurnoutTrack *merge = new TurnoutTrack(NAME_ARG_FIRST("merge") id + 3);
+    end->connect(endConnector, *split, INLET);
+    split->connect(LEFT_OUTLET, *left, INLET);
+    split->connect(RIGHT_OUTLET, *right, INLET);
+    left->connect(OUTLET, *merge, LEFT_OUTLET);
+    right->connect(OUTLET, *merge, RIGHT_OUTLET);
+    end = merge;
+    endConnector = INLET;
+    id += 4;
+  }
+  BlockTrack *last = new BlockTrack(NAME_ARG_FIRST("b26") LAST_BLOCK);
+  DeadendTrack *stop = new DeadendTrack(NAME_ARG_FIRST("d27") LAST_BLOCK + 1);
+  end->connect(endConnector, *last, INLET);
+  last->connect(OUTLET, *stop, OUTLET);
+}
+
+/*
+ * Batch request
+ */
+typedef struct {
+  uint8_t op;
+  uint16_t origin;
+  uint16_t target;
+  uint8_t direction;
+} Item;
+
+static void putWord(std::vector<uint8_t> & ioFrame, const uint16_t inWord)
+{
+  ioFrame.push_back(inWord & 0xFF);
+  ioFrame.push_back(inWord >> 8);
+}
+
+static std::vector<uint8_t> batch(const uint8_t inSeq, const std::vector<Item> & inItems)
+{
+  std::vector<uint8_t> frame;
+  frame.push_back(ROUTE_PROTOCOL_SYNC);
+  frame.push_back(ROUTE_BATCH_FRAME);
+  frame.push_back(inSeq);
+  putWord(frame, 1 + inItems.size() * 6);
+  frame.push_back(inItems.size());
+  for (size_t i = 0; i < inItems.size(); i++) {
+    frame.push_back(inItems[i].op);
+    putWord(frame, inItems[i].origin);
+    putWord(frame, inItems[i].target);
+    frame.push_back(inItems[i].direction);
+  }
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 1; i < frame.size(); i++) crc = RouteProtocol::crc(crc, frame[i]);
+  putWord(frame, crc);
+  return frame;
+}
+
+static Item item(const uint8_t inOp, const uint16_t inOrigin, const uint16_t inTarget)
+{
+  Item query = { inOp, inOrigin, inTarget, FORWARD_DIRECTION };
+  return query;
+}
+
+/*
+ * Write a request and read the answer frame, while the server runs. The
+ * request is copied in the coroutine frame.
+ */
+AsyncTask exchange(
+  const int inFd,
+  const std::vector<uint8_t> inRequest,
+  std::vector<uint8_t> & outAnswer,
+  bool & outDone)
+{
+  size_t sent = 0;
+  while (sent < inRequest.size()) {
+    co_await eventLoop.writable(inFd);
+    ssize_t written = write(inFd, inRequest.data() + sent, inRequest.size() - sent);
+    if (written <= 0) break;
+    sent += written;
+  }
+  outAnswer.clear();
+  uint8_t buffer[4096];
+  while (outAnswer.size() < 5 ||
+         outAnswer.size() < 7 + (size_t)(outAnswer[3] | (outAnswer[4] << 8))) {
+    co_await eventLoop.readable(inFd);
+    ssize_t received = read(inFd, buffer, sizeof(buffer));
+    if (received <= 0) break;
+    outAnswer.insert(outAnswer.end(), buffer, buffer + received);
+  }
+  outDone = true;
+}
+
+/* Answer frame of a batch, payload only, empty if it is not a good frame */
+static std::vector<uint8_t> roundTrip(
+  const int inFd,
+  const uint8_t inSeq,
+  const std::vector<Item> & inItems)
+{
+  std::vector<uint8_t> answer;
+  bool done = false;
+  exchange(inFd, batch(inSeq, inItems), answer, done);
+  while (! done && eventLoop.runOnce());
+
+  std::vector<uint8_t> payload;
+  if (answer.size() < 7) return payload;
+  const uint16_t length = answer[3] | (answer[4] << 8);
+  if (answer.size() != 7 + (size_t)length) return payload;
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 1; i < 5 + (size_t)length; i++) crc = RouteProtocol::crc(crc, answer[i]);
+  if (answer[0] != ROUTE_PROTOCOL_SYNC || answer[1] != ROUTE_BATCH_ANSWER_FRAME ||
+      answer[2] != inSeq || (answer[5 + length] | (answer[6 + length] << 8)) != crc) {
+    return payload;
+  }
+  payload.assign(answer.begin() + 5, answer.begin() + 5 + length);
+  return payload;
+}
+
+static int connectClient()
+{
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, socketPath);
+  if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) return -1;
+  /* Let the server accept it */
+  eventLoop.runOnce();
+  return fd;
+}
+
+static void testBigBatch(const int inFd)
+{
+  std::vector<Item> items(255, item(SERVER_ROUTES, FIRST_BLOCK, LAST_BLOCK));
+  std::vector<uint8_t> answer = roundTrip(inFd, 1, items);
+  CHECK(! answer.empty());
+  if (answer.empty()) return;
+  CHECK(answer[0] == 255);
+
+  RouteRing ring;
+  CHECK(ring.attach(ringName));
+  const uint8_t size = Track::sizeForSet();
+  std::vector<uint8_t> inlined;
+  std::vector<uint8_t> fromRing(ROUTE_COUNT * size);
+  uint16_t inlineCount = 0;
+  uint16_t ringCount = 0;
+  size_t a = 1;
+  for (uint16_t i = 0; i < 255 && a + 5 <= answer.size(); i++) {
+    const uint8_t status = answer[a];
+    const uint16_t count = answer[a + 1] | (answer[a + 2] << 8);
+    const uint8_t place = answer[a + 4];
+    CHECK(status == ROUTE_OK && count == ROUTE_COUNT && answer[a + 3] == size);
+    if (status != ROUTE_OK) break;
+    a += 5;
+    const uint32_t length = (uint32_t)count * size;
+    if (place == ROUTES_INLINE) {
+      if (inlineCount++ == 0) inlined.assign(answer.begin() + a, answer.begin() + a + length);
+      else CHECK(memcmp(&answer[a], inlined.data(), length) == 0);
+      a += length;
+    }
+    else {
+      uint64_t position = 0;
+      uint32_t ringLength = 0;
+      for (uint8_t b = 0; b < 8; b++) position |= (uint64_t)answer[a + b] << (b * 8);
+      for (uint8_t b = 0; b < 4; b++) ringLength |= (uint32_t)answer[a + 8 + b] << (b * 8);
+      CHECK(ringLength == length);
+      CHECK(ring.read(position, ringLength, fromRing.data()));
+      CHECK(fromRing == inlined);
+      ringCount++;
+      a += 12;
+    }
+  }
+  CHECK(a == answer.size());
+  CHECK(inlineCount > 0);
+  CHECK(ringCount > 0);
+  CHECK(inlineCount + ringCount == 255);
+  ring.close();
+}
+
+static void testQueries(const int inFd)
+{
+  std::vector<Item> items;
+  items.push_back(item(SERVER_ROUTES, Track::count(), LAST_BLOCK));
+  items.push_back(item(SERVER_REACHES, FIRST_BLOCK, LAST_BLOCK));
+  items.push_back(item(SERVER_REACHES, LAST_BLOCK, FIRST_BLOCK));
+  items.push_back(item(9, FIRST_BLOCK, LAST_BLOCK));
+  std::vector<uint8_t> answer = roundTrip(inFd, 2, items);
+  const uint8_t expected[] = { 4, ROUTE_BAD_TRACK, ROUTE_OK, 1, ROUTE_OK, 0, ROUTE_BAD_QUERY };
+  CHECK(answer.size() == sizeof(expected));
+  CHECK(answer.size() == sizeof(expected) && memcmp(answer.data(), expected, sizeof(expected)) == 0);
+}
+
+/* Reservation of a client, 0 if refused */
+static uint16_t reserve(const int inFd, uint8_t & outStatus)
+{
+  std::vector<uint8_t> answer =
+    roundTrip(inFd, 3, std::vector<Item>(1, item(SERVER_RESERVE, FIRST_BLOCK, LAST_BLOCK)));
+  outStatus = answer.size() > 1 ? answer[1] : 0xFF;
+  if (outStatus != ROUTE_OK || answer.size() != 5 + (size_t)Track::sizeForSet()) return 0;
+  return answer[2] | (answer[3] << 8);
+}
+
+static uint8_t release(const int inFd, const uint16_t inId)
+{
+  std::vector<uint8_t> answer =
+    roundTrip(inFd, 4, std::vector<Item>(1, item(SERVER_RELEASE, inId, 0)));
+  return answer.size() == 2 ? answer[1] : 0xFF;
+}
+
+static void testReservations(RouteServer & ioServer, const int inFd)
+{
+  const int other = connectClient();
+  CHECK(other >= 0);
+  CHECK(ioServer.clientCount() == 2);
+
+  /* Every route goes through b1 and b26 */
+  uint8_t status;
+  const uint16_t id = reserve(inFd, status);
+  CHECK(status == ROUTE_OK && id != 0);
+  CHECK(reserve(other, status) == 0 && status == ROUTE_BUSY);
+  CHECK(release(inFd, id + 1) == ROUTE_BAD_QUERY);
+  CHECK(release(other, id) == ROUTE_BAD_QUERY);
+  CHECK(release(inFd, id) == ROUTE_OK);
+  CHECK(release(inFd, id) == ROUTE_BAD_QUERY);
+
+  /* Released when its client goes */
+  CHECK(reserve(other, status) != 0 && status == ROUTE_OK);
+  CHECK(reserve(inFd, status) == 0 && status == ROUTE_BUSY);
+  close(other);
+  while (ioServer.clientCount() > 1 && eventLoop.runOnce());
+  CHECK(ioServer.clientCount() == 1);
+  CHECK(reserve(inFd, status) != 0 && status == ROUTE_OK);
+}
+
+/* The clients of a closed server are closed, a server opened again serves its own */
+static void testReopen(RouteServer & ioServer, const int inFd)
+{
+  ioServer.close();
+  CHECK(ioServer.clientCount() == 0);
+  uint8_t byte;
+  CHECK(read(inFd, &byte, 1) == 0);
+  close(inFd);
+
+  CHECK(ioServer.open(socketPath, ringName, 1024 * 1024));
+  const int fd = connectClient();
+  CHECK(fd >= 0);
+  /* The coroutines of the closed server end without taking the new client */
+  uint8_t status;
+  CHECK(reserve(fd, status) != 0 && status == ROUTE_OK);
+  testQueries(fd);
+  CHECK(ioServer.clientCount() == 1);
+  close(fd);
+  while (ioServer.clientCount() > 0 && eventLoop.runOnce());
+  CHECK(ioServer.clientCount() == 0);
+}
+
+void setup()
+{
+  buildLayout();
+  Track::finalize();
+  if (! Track::trackNetIsOk()) {
+    fprintf(stderr, "route server: the track net is not ok\n");
+    exit(1);
+  }
+  ReachabilityIndex::build();
+  PathSet paths;
+  Track::trackForId(FIRST_BLOCK).pathsTo(LAST_BLOCK, FORWARD_DIRECTION, paths);
+  CHECK(paths.count() == ROUTE_COUNT);
+  /* A batch of inline answers would be larger than a frame */
+  CHECK(255UL * (5 + ROUTE_COUNT * Track::sizeForSet()) > 0xFFFF);
+  CHECK(ROUTE_COUNT * Track::sizeForSet() <= ROUTE_SERVER_INLINE_BYTES);
+
+  snprintf(socketPath, sizeof(socketPath), "/tmp/switchman-test-%d.sock", (int)getpid());
+  snprintf(ringName, sizeof(ringName), "/switchman-test-%d", (int)getpid());
+  RouteServer server(eventLoop);
+  if (! server.open(socketPath, ringName, 1024 * 1024)) {
+    fprintf(stderr, "route server: cannot open %s\n", socketPath);
+    exit(1);
+  }
+  const int fd = connectClient();
+  CHECK(fd >= 0);
+  CHECK(server.clientCount() == 1);
+
+  testBigBatch(fd);
+  testQueries(fd);
+  testReservations(server, fd);
+  testReopen(server, fd);
+
+  server.close();
+  fprintf(stderr, "%u checks, %u failed\n", (unsigned)checks, (unsigned)failures);
+  exit(failures == 0 ? 0 : 1);
+}
+
+void loop()
+{
+}
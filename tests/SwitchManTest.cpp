@@ -0,0 +1,310 @@
+/*
+ * Tests of SwitchMan on the layout of examples/dom.
+ * Run by ctest. The exit status is the number of failed checks.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SwitchMan.h"
+#include "Specifs.h"
+#include "Check.h"
+
+/* Number of routes of a PathSet, its empty initial path apart */
+static uint16_t routeCount(PathSet & inPaths)
+{
+  uint16_t count = 0;
+  for (Path *path = inPaths.firstPath(); path != NULL; path = path->next()) {
+    if (! path->isEmpty()) count++;
+  }
+  return count;
+}
+
+static uint16_t searchCount(const uint16_t inFrom, const uint16_t inTo, const Direction inDir)
+{
+  PathSet paths;
+  PathSearch search;
+  search.start(Track::trackForId(inFrom), inTo, inDir, paths);
+  while (! search.step(100));
+  return routeCount(paths);
+}
+
+class FirstRoute : public RouteVisitor
+{
+  public:
+    uint16_t mCount;
+    FirstRoute() : mCount(0) {}
+    virtual bool visitRoute(const TrackSet &) { mCount++; return false; }
+};
+
+static void testTrackSet()
+{
+  TrackSet set;
+  CHECK(set.isEmpty());
+  set.addTrack(voie1_id);
+  set.addTrack(aiguille20_id);
+  CHECK(set.containsTrack(voie1_id));
+  CHECK(set.containsTrack(aiguille20_id));
+  CHECK(! set.containsTrack(voie2_id));
+  set.removeTrack(voie1_id);
+  CHECK(! set.containsTrack(voie1_id));
+}
+
+static void testHeadedTrackSet()
+{
+  HeadedTrackSet set;
+  set.addTrack(voie3_id, FORWARD_DIRECTION);
+  CHECK(set.containsTrack(voie3_id, FORWARD_DIRECTION));
+  CHECK(! set.containsTrack(voie3_id, BACKWARD_DIRECTION));
+  set.clear();
+  CHECK(set.isEmpty());
+  /* Wrapping around of the epoch */
+  for (uint16_t i = 0; i < 600; i++) {
+    set.addTrack(voie3_id, BACKWARD_DIRECTION);
+    set.clear();
+  }
+  CHECK(set.isEmpty());
+
+  HeadedTrackSet *pooled = HeadedTrackSet::acquire();
+  pooled->addTrack(voie4_id, FORWARD_DIRECTION);
+  HeadedTrackSet::release(pooled);
+  pooled = HeadedTrackSet::acquire();
+  CHECK(pooled->isEmpty());
+  HeadedTrackSet::release(pooled);
+}
+
+static void testRoutes()
+{
+  TrackSet all;
+  for (uint16_t id = 0; id < Track::count(); id++) all.addTrack(id);
+
+  for (uint8_t dir = FORWARD_DIRECTION; dir <= BACKWARD_DIRECTION; dir++) {
+    for (uint16_t from = 0; from < Track::count(); from++) {
+      PathSetMap batch;
+      BatchSearch search;
+      CHECK(search.pathsToAll(Track::trackForId(from), all, (Direction)dir, batch));
+      for (uint16_t to = 0; to < Track::count(); to++) {
+        const uint16_t count = searchCount(from, to, (Direction)dir);
+        CHECK(routeCount(*batch.pathsFor(to)) == count);
+        CHECK(ReachabilityIndex::reaches(from, to, (Direction)dir) == (count > 0));
+
+        FirstRoute first;
+        bool stopped = Track::trackForId(from).visitPathsTo(to, (Direction)dir, first);
+        CHECK(stopped == (count > 0));
+        CHECK(first.mCount == (count > 0 ? 1 : 0));
+
+        /* The recursive search finds the same routes */
+        PathSet paths;
+        Track::trackForId(from).pathsTo(to, (Direction)dir, paths);
+        CHECK(routeCount(paths) == count);
+      }
+    }
+  }
+}
+
+#ifdef SWITCHMAN_PROFILE
+static void testProfile()
+{
+  Profile::begin();
+  PathSet paths;
+  Track::trackForId(voie23_id).pathsTo(voie1_id, FORWARD_DIRECTION, paths);
+  CHECK(Profile::count(PROFILE_QUERY) == 1);
+  CHECK(Profile::count(PROFILE_BLOCK) > 0);
+  CHECK(Profile::count(PROFILE_ALLOCATION) > 0);
+  /* The own time of the tracks is part of the time of the query */
+  CHECK(Profile::total(PROFILE_BLOCK) + Profile::total(PROFILE_TURNOUT) <= Profile::total(PROFILE_QUERY));
+  uint32_t counted = 0;
+  for (uint8_t b = 0; b < PROFILE_BUCKETS; b++) counted += Profile::bucket(PROFILE_BLOCK, b);
+  CHECK(counted == Profile::count(PROFILE_BLOCK));
+  Profile::reset();
+  CHECK(Profile::count(PROFILE_QUERY) == 0);
+}
+#endif
+
+static void testLayoutReport()
+{
+  LayoutReport report;
+  report.build();
+  CHECK(report.isOk());
+  CHECK(report.issueCount() == 0);
+  CHECK(report.partCount() == 1);
+  CHECK(report.largestPart() == Track::count());
+  CHECK(report.recordedErrors() == 0);
+  CHECK(Track::tableSize() == Track::count());
+  CHECK(Track::findTrack(Track::count()) == NULL);
+}
+
+/* Whether every route of inSet is in inRoutes */
+static bool routesIn(PathSet & inSet, PathSet & inRoutes)
+{
+  for (Path * p = inSet.firstPath(); p != NULL; p = p->next()) {
+    if (! p->isEmpty() && ! inRoutes.containsPath(*p)) return false;
+  }
+  return true;
+}
+
+static void testRouteCache()
+{
+  Track & from = Track::trackForId(voie23_id);
+  PathSet direct;
+  const bool found = from.pathsTo(voie1_id, FORWARD_DIRECTION, direct);
+  CHECK(found);
+
+  RouteCache cache(4096);
+  PathSet missed;
+  CHECK(cache.pathsTo(from, voie1_id, FORWARD_DIRECTION, missed) == found);
+  PathSet hit;
+  CHECK(cache.pathsTo(from, voie1_id, FORWARD_DIRECTION, hit) == found);
+  CHECK(cache.misses() == 1 && cache.hits() == 1);
+  CHECK(cache.entryCount() == 1);
+  CHECK(hit.count() == direct.count());
+  CHECK(routesIn(hit, direct) && routesIn(direct, hit));
+  CHECK(cache.bytes() <= cache.capacity());
+
+  /* A track of the first route is avoided, the other routes are kept */
+  Path & first = *direct.firstPath();
+  uint16_t avoidedId = 0;
+  while (avoidedId == voie23_id || avoidedId == voie1_id ||
+         ! first.containsTrack(avoidedId)) avoidedId++;
+  TrackSet avoided;
+  avoided.addTrack(avoidedId);
+  PathSet kept;
+  cache.pathsAvoiding(from, voie1_id, FORWARD_DIRECTION, avoided, kept);
+  CHECK(kept.count() < direct.count());
+  CHECK(routesIn(kept, direct));
+  for (Path * p = kept.firstPath(); p != NULL; p = p->next()) {
+    CHECK(! p->containsTrack(avoidedId));
+  }
+  PathSet keptAgain;
+  cache.pathsAvoiding(from, voie1_id, FORWARD_DIRECTION, avoided, keptAgain);
+  CHECK(keptAgain.count() == kept.count());
+  CHECK(cache.hits() == 2 && cache.entryCount() == 2);
+
+  /* Routes of the caller under a state of its own */
+  PathSet stored;
+  CHECK(! cache.find(voie23_id, voie1_id, FORWARD_DIRECTION, 0x5A, stored));
+  cache.store(voie23_id, voie1_id, FORWARD_DIRECTION, 0x5A, kept);
+  CHECK(cache.find(voie23_id, voie1_id, FORWARD_DIRECTION, 0x5A, stored));
+  CHECK(stored.count() == kept.count());
+
+  /* Under state 0 they are apart from the searched routes */
+  PathSet none;
+  CHECK(! cache.find(voie23_id, voie1_id, FORWARD_DIRECTION, 0, none));
+  cache.store(voie23_id, voie1_id, FORWARD_DIRECTION, 0, none);
+  PathSet searched;
+  CHECK(cache.pathsTo(from, voie1_id, FORWARD_DIRECTION, searched) == found);
+  CHECK(routesIn(searched, direct) && routesIn(direct, searched));
+  CHECK(cache.find(voie23_id, voie1_id, FORWARD_DIRECTION, 0, none));
+  CHECK(none.count() == 0);
+
+  /* Only the routes of the query are kept, not those already in ioPaths */
+  RouteCache fresh(4096);
+  PathSet other;
+  Track::trackForId(voie1_id).pathsTo(voie2_id, FORWARD_DIRECTION, other);
+  PathSet both = other;
+  fresh.pathsTo(from, voie1_id, FORWARD_DIRECTION, both);
+  CHECK(routesIn(direct, both) && routesIn(other, both));
+  PathSet alone;
+  fresh.pathsTo(from, voie1_id, FORWARD_DIRECTION, alone);
+  CHECK(fresh.hits() == 1);
+  CHECK(routesIn(alone, direct) && routesIn(direct, alone));
+
+  /* A small cache evicts the oldest queries and stays in its capacity */
+  RouteCache small(256);
+  for (uint16_t to = 0; to < Track::count(); to++) {
+    PathSet paths;
+    small.pathsTo(from, to, FORWARD_DIRECTION, paths);
+    CHECK(small.bytes() <= small.capacity());
+  }
+  CHECK(small.evictions() > 0);
+  CHECK(small.entryCount() > 0);
+  PathSet last;
+  small.pathsTo(from, Track::count() - 1, FORWARD_DIRECTION, last);
+  CHECK(small.hits() == 1);
+  small.clear();
+  CHECK(small.entryCount() == 0);
+  CHECK(small.bytes() < small.capacity());
+}
+
+#ifdef SWITCHMAN_TRACK_NAMES
+static void testTrackNames()
+{
+  CHECK(TrackNames::isIndexed());
+  CHECK(strcmp(Track::trackForId(voie1_id).name(), "voie1") == 0);
+  CHECK(TrackNames::idForName("voie1") == voie1_id);
+  CHECK(TrackNames::idForName("voie23") == voie23_id);
+  CHECK(TrackNames::idForName("voieGarage10") == voieGarage10_id);
+  CHECK(TrackNames::idForName("voie") == Track::count());
+  CHECK(TrackNames::idForName("zzz") == Track::count());
+  CHECK(TrackNames::idForName("") == Track::count());
+  for (uint16_t id = 0; id < Track::count(); id++) {
+    CHECK(TrackNames::idForName(Track::trackForId(id).name()) == id);
+  }
+  CHECK(TrackNames::footprint() > 0);
+}
+#endif
+
+#ifdef SWITCHMAN_HEAP_STATS
+static void testHeapStats()
+{
+  const uint32_t inUse = HeapStats::inUse();
+  const uint32_t paths = HeapStats::allocations(HEAP_PATHS);
+  {
+    PathSet routes;
+    Track::trackForId(voie23_id).pathsTo(voie1_id, FORWARD_DIRECTION, routes);
+    CHECK(HeapStats::allocations(HEAP_PATHS) > paths);
+    CHECK(HeapStats::allocations(HEAP_MARKING) > 0);
+    CHECK(HeapStats::lastQueryPeak() > 0);
+    CHECK(HeapStats::queryPeak() >= HeapStats::lastQueryPeak());
+    CHECK(HeapStats::highWater() >= HeapStats::inUse());
+  }
+  /* The paths are given back, the marking stays in the pool */
+  CHECK(HeapStats::bytes(HEAP_PATHS) <= inUse);
+  CHECK(HeapStats::frees(HEAP_PATHS) > 0);
+  HeapSnapshot state;
+  HeapStats::snapshot(state);
+  CHECK(state.inUse == HeapStats::inUse());
+  CHECK(state.bytes[HEAP_INDEX] > 0);
+  {
+    RouteCache cache(1024);
+    PathSet routes;
+    cache.pathsTo(Track::trackForId(voie23_id), voie1_id, FORWARD_DIRECTION, routes);
+    CHECK(HeapStats::bytes(HEAP_CACHE) == cache.bytes());
+  }
+  CHECK(HeapStats::bytes(HEAP_CACHE) == 0);
+  HeapStats::reset();
+  CHECK(HeapStats::allocations(HEAP_PATHS) == 0);
+  CHECK(HeapStats::highWater() == HeapStats::inUse());
+}
+#endif
+
+void setup()
+{
+  export_setup();
+  Track::finalize();
+  CHECK(Track::trackNetIsOk());
+  CHECK(Track::count() == 52);
+  /* finalize() has built the index */
+  CHECK(ReachabilityIndex::isBuilt());
+
+  testTrackSet();
+  testHeadedTrackSet();
+  testRoutes();
+  testLayoutReport();
+  testRouteCache();
+#ifdef SWITCHMAN_PROFILE
+  testProfile();
+#endif
+#ifdef SWITCHMAN_TRACK_NAMES
+  testTrackNames();
+#endif
+#ifdef SWITCHMAN_HEAP_STATS
+  testHeapStats();
+#endif
+
+  fprintf(stderr, "%u checks, %u failed\n", (unsigned)checks, (unsigned)failures);
+  exit(failures == 0 ? 0 : 1);
+}
+
+void loop()
+{
+}
@@ -3,7 +3,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
-#include "String.h"
+#include <string.h>
 
 #define F(str) str
 #define PROGMEM
@@ -19,7 +19,9 @@ extern uint32_t millis();
 extern uint32_t micros();
 
 #define pgm_read_word(str) str
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
 #define strcpy_P sm_strcpy
+#define strcmp_P strcmp
 
 char * sm_strcpy(char * dst, const char * src);
 
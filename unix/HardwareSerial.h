@@ -25,6 +25,9 @@ class HardwareSerial
     void println(const char *str)         { std::cout << str << std::endl; }
     void println()                        { std::cout << std::endl; }
     void begin(const int speed)           {}
+    size_t write(const uint8_t val)       { std::cout.put(val); return 1; }
+    int available()                       { return std::cin.rdbuf()->in_avail(); }
+    int read()                            { return std::cin.get(); }
 };
 
 extern HardwareSerial Serial;
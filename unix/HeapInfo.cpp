@@ -0,0 +1,30 @@
+/*
+ * Heap of the unix emulation, read from mallinfo of the GNU C library.
+ * See src/HeapStats.h.
+ */
+#include "Arduino.h"
+#include "HeapStats.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+void heapPlatformInfo(HeapInfo & outInfo)
+{
+  outInfo.heapSize = 0;
+  outInfo.heapHighWater = 0;
+  outInfo.freeBytes = 0;
+  outInfo.largestFreeBlock = 0;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 info = mallinfo2();
+  outInfo.heapSize = info.arena + info.hblkhd;
+  outInfo.freeBytes = info.fordblks;
+  /* Releasable space at the top of the heap */
+  outInfo.largestFreeBlock = info.keepcost;
+#elif defined(__GLIBC__)
+  struct mallinfo info = mallinfo();
+  outInfo.heapSize = info.arena + info.hblkhd;
+  outInfo.freeBytes = info.fordblks;
+  outInfo.largestFreeBlock = info.keepcost;
+#endif
+}
@@ -0,0 +1,57 @@
+/*
+ * Profile clock of the unix emulation: the time stamp counter of x86
+ * processors, calibrated against clock_gettime, or clock_gettime in
+ * nanoseconds on the other processors. See src/Profile.h.
+ */
+#include "Arduino.h"
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static uint16_t sTicksPerMicrosecond = 1000;
+
+static uint64_t nanoseconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+void profileClockBegin()
+{
+  /* Ticks of the counter during 10 ms */
+  const uint64_t startTime = nanoseconds();
+  const uint64_t startTicks = __rdtsc();
+  while (nanoseconds() - startTime < 10000000ULL);
+  const uint64_t ticks = __rdtsc() - startTicks;
+  const uint64_t elapsed = nanoseconds() - startTime;
+  sTicksPerMicrosecond = (uint16_t)((ticks * 1000 + elapsed / 2) / elapsed);
+  if (sTicksPerMicrosecond == 0) sTicksPerMicrosecond = 1;
+}
+
+uint32_t profileTicks()
+{
+  return (uint32_t)__rdtsc();
+}
+
+#else
+
+void profileClockBegin()
+{
+}
+
+uint32_t profileTicks()
+{
+  return (uint32_t)nanoseconds();
+}
+
+#endif
+
+uint16_t profileTicksPerMicrosecond()
+{
+  return sTicksPerMicrosecond;
+}